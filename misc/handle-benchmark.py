@@ -0,0 +1,206 @@
+#!/usr/bin/env python3
+
+'''
+Time the kernels a generated verifier uses to copy and compare handles.
+
+Record and array assignment, comparison of complex values, scalarset schedule
+copying and symmetry reduction all move bit blocks around with handle_copy() and
+handle_eq(). This generates a verifier for a trivial model, then times these
+functions over a range of block widths and bit offsets. For comparison, it also
+times a copy and comparison that move one bit at a time. Before timing, it
+checks that each kernel agrees with the bit-at-a-time version.
+'''
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+MODEL = '''
+var x: boolean;
+startstate begin x := false; end;
+rule begin x := !x; end;
+'''
+
+HARNESS = r'''
+/* include the verifier, but do not run it */
+#define main checker_main
+#include "checker.c"
+#undef main
+
+#include <time.h>
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/* reference versions that work one bit at a time */
+
+static void bitwise_copy(struct handle a, struct handle b) {
+  for (size_t i = 0; i < a.width; i++) {
+    uint8_t *dst = a.base + (a.offset + i) / 8;
+    size_t dst_off = (a.offset + i) % 8;
+    const uint8_t *src = b.base + (b.offset + i) / 8;
+    size_t src_off = (b.offset + i) % 8;
+    uint8_t or_mask = ((*src >> src_off) & UINT8_C(1)) << dst_off;
+    uint8_t and_mask = ~(UINT8_C(1) << dst_off);
+    *dst = (*dst & and_mask) | or_mask;
+  }
+}
+
+static bool bitwise_eq(struct handle a, struct handle b) {
+  for (size_t i = 0; i < a.width; i++) {
+    bool x = (a.base[(a.offset + i) / 8] >> ((a.offset + i) % 8)) & 1;
+    bool y = (b.base[(b.offset + i) / 8] >> ((b.offset + i) % 8)) & 1;
+    if (x != y) {
+      return false;
+    }
+  }
+  return true;
+}
+
+enum { MAX_WIDTH = 4096 };
+enum { BUFFER = MAX_WIDTH / 8 + 2 };
+
+static uint8_t src[BUFFER];
+static uint8_t dst[BUFFER];
+static uint8_t expected[BUFFER];
+
+static void fill(uint8_t *p, size_t seed) {
+  for (size_t i = 0; i < BUFFER; i++) {
+    p[i] = (uint8_t)((i + seed) * 0x9d);
+  }
+}
+
+/* check handle_copy() and handle_eq() against the reference versions */
+static bool check(size_t width, size_t dst_offset, size_t src_offset) {
+  struct handle a = {.base = dst, .offset = dst_offset, .width = width};
+  struct handle b = {.base = src, .offset = src_offset, .width = width};
+  struct handle e = {.base = expected, .offset = dst_offset, .width = width};
+
+  fill(src, 1);
+  fill(dst, 2);
+  fill(expected, 2);
+  if (handle_eq(a, b) != bitwise_eq(a, b)) {
+    return false;
+  }
+  bitwise_copy(e, b);
+  handle_copy(a, b);
+  if (memcmp(dst, expected, sizeof(dst)) != 0) {
+    return false;
+  }
+  if (!handle_eq(a, b)) {
+    return false;
+  }
+  if (width > 0) {
+    /* flip the last bit and make sure this is noticed */
+    size_t last = dst_offset + width - 1;
+    dst[last / 8] ^= (uint8_t)(1 << (last % 8));
+    if (handle_eq(a, b) || handle_eq(b, a)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* time one kernel, returning nanoseconds per call */
+#define TIME(call)                                                             \
+  ({                                                                           \
+    size_t rounds = 0;                                                         \
+    double start = now();                                                      \
+    double elapsed;                                                            \
+    do {                                                                       \
+      for (size_t i = 0; i < 1024; i++) {                                      \
+        call;                                                                  \
+        __asm__ volatile("" : : : "memory");                                   \
+      }                                                                        \
+      rounds++;                                                                \
+      elapsed = now() - start;                                                 \
+    } while (elapsed < 0.1);                                                   \
+    elapsed * 1e9 / (double)(rounds * 1024);                                   \
+  })
+
+int main(void) {
+
+  static const size_t widths[] = {3, 8, 24, 64, 100, 256, 1000, 4096};
+  static const size_t offsets[][2] = {{0, 0}, {3, 3}, {0, 5}, {6, 1}};
+
+  /* first check correctness over every small combination */
+  for (size_t width = 0; width <= 300; width++) {
+    for (size_t d = 0; d < 8; d++) {
+      for (size_t s = 0; s < 8; s++) {
+        if (!check(width, d, s)) {
+          fprintf(stderr, "mismatch with width %zu, offsets %zu and %zu\n",
+                  width, d, s);
+          return EXIT_FAILURE;
+        }
+      }
+    }
+  }
+
+  printf("%6s %7s %10s %10s %10s %10s\n", "width", "offsets", "copy ns",
+         "bitwise", "eq ns", "bitwise");
+
+  fill(src, 1);
+  for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+    for (size_t j = 0; j < sizeof(offsets) / sizeof(offsets[0]); j++) {
+      struct handle a = {
+          .base = dst, .offset = offsets[j][0], .width = widths[i]};
+      struct handle b = {
+          .base = src, .offset = offsets[j][1], .width = widths[i]};
+
+      double copy = TIME(handle_copy(a, b));
+      double bit_copy = TIME(bitwise_copy(a, b));
+
+      /* the blocks are equal now, so comparisons run to the end */
+      bool sink = false;
+      double eq = TIME(sink |= handle_eq(a, b));
+      double bit_eq = TIME(sink |= bitwise_eq(a, b));
+      __asm__ volatile("" : : "r"(sink));
+
+      printf("%6zu %3zu,%-3zu %10.1f %10.1f %10.1f %10.1f\n", widths[i],
+             offsets[j][0], offsets[j][1], copy, bit_copy, eq, bit_eq);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+'''
+
+def main(args):
+
+  # parse command line arguments
+  parser = argparse.ArgumentParser(
+    description='time the handle copy and comparison kernels')
+  parser.add_argument('--rumur', default='rumur', help='Rumur binary to use')
+  parser.add_argument('--cc', default=os.environ.get('CC', 'cc'),
+    help='C compiler to use')
+  parser.add_argument('--cflags', default='-O3',
+    help='flags to compile with, e.g. "-O3 -march=native"')
+  options = parser.parse_args(args[1:])
+
+  with tempfile.TemporaryDirectory() as tmp:
+
+    model = os.path.join(tmp, 'model.m')
+    checker_c = os.path.join(tmp, 'checker.c')
+    harness_c = os.path.join(tmp, 'harness.c')
+    harness = os.path.join(tmp, 'harness')
+
+    with open(model, 'wt') as f:
+      f.write(MODEL)
+
+    subprocess.check_call([options.rumur, '--output', checker_c, model])
+
+    with open(harness_c, 'wt') as f:
+      f.write(HARNESS)
+
+    subprocess.check_call([options.cc, '-std=c11', '-mcx16'] +
+      options.cflags.split() + [harness_c, '-o', harness, '-lpthread'])
+
+    return subprocess.call([harness])
+
+if __name__ == '__main__':
+  sys.exit(main(sys.argv))
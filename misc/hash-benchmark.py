@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+
+'''
+Compare the state hash kernels available to a generated verifier.
+
+For each kernel that can be selected with --hash, this generates a verifier for
+the given model with that kernel, runs it, then hashes every state it found.
+It reports the time taken to hash a state that is already in cache, and how
+long the probe sequences would be if the states were inserted into the
+verifier's final seen set with that kernel's hashes. The aim is to find the
+fastest kernel that still spreads the states of real models well.
+
+The verifier's own seen set is used to find the states, so it must be the kind
+that stores pointers to states. That is, Rumur options like --hash-compaction
+or --counterexample-trace off cannot be passed to this script.
+'''
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+HARNESS = r'''
+/* run the verifier as normal, but under a different name */
+#define main checker_main
+#include "checker.c"
+#undef main
+
+#include <time.h>
+
+#if INLINE_SET || HASH_COMPACTION_BITS > 0 || BITSTATE_HASHES > 0 ||          \
+    EXTERNAL_MEMORY
+#error "the seen set must store pointers to states"
+#endif
+
+static uint8_t *state_data;
+static size_t state_count;
+
+/* number of states to time hashing over, few enough to stay in cache */
+static size_t timed_count;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/* Time the kernel the verifier was generated with, which is called with a
+ * constant length as it is in the verifier.
+ */
+static double time_kernel(void) {
+  uint64_t sink = 0;
+  size_t rounds = 0;
+  double start = now();
+  double elapsed;
+  do {
+    for (size_t i = 0; i < timed_count; i++) {
+      sink += hash_kernel(&state_data[i * STATE_SIZE_BYTES], 0);
+    }
+    rounds++;
+    elapsed = now() - start;
+  } while (elapsed < 0.5);
+  __asm__ volatile("" : : "r"(sink));
+  return elapsed * 1e9 / (double)(rounds * timed_count);
+}
+
+static void hashes_kernel(uint64_t *hashes) {
+  for (size_t i = 0; i < state_count; i++) {
+    hashes[i] = hash_kernel(&state_data[i * STATE_SIZE_BYTES], 0);
+  }
+}
+
+static int compare_hashes(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+/* Report on one kernel, given the time it takes per state and the hashes it
+ * produced for every state.
+ */
+static void report(const char *name, double ns, uint64_t *hashes) {
+
+  /* insert into a simulated seen set of the same size as the real one, using
+   * the same linear probing
+   */
+  size_t size = set_size(global_seen);
+  bool *occupied = calloc(size, sizeof(occupied[0]));
+  enum { MAX_PROBE = 1024 };
+  size_t *lengths = calloc(MAX_PROBE + 1, sizeof(lengths[0]));
+  if (occupied == NULL || lengths == NULL) {
+    oom();
+  }
+  size_t total = 0;
+  size_t longest = 0;
+  for (size_t i = 0; i < state_count; i++) {
+    size_t length = 1;
+    size_t j = (size_t)hashes[i] & (size - 1);
+    while (occupied[j]) {
+      j = (j + 1) & (size - 1);
+      length++;
+    }
+    occupied[j] = true;
+    total += length;
+    if (length > longest) {
+      longest = length;
+    }
+    lengths[length < MAX_PROBE ? length : MAX_PROBE]++;
+  }
+  size_t p99 = 0;
+  for (size_t seen = 0; seen * 100 < state_count * 99;) {
+    p99++;
+    seen += lengths[p99];
+  }
+  free(lengths);
+  free(occupied);
+
+  /* distinct states with identical 64-bit hashes */
+  qsort(hashes, state_count, sizeof(hashes[0]), compare_hashes);
+  size_t collisions = 0;
+  for (size_t i = 1; i < state_count; i++) {
+    if (hashes[i] == hashes[i - 1]) {
+      collisions++;
+    }
+  }
+
+  fprintf(stderr, "%-9s %10.2f %10.0f %10.3f %10zu %10zu %10zu\n", name, ns,
+          (double)STATE_SIZE_BYTES / ns * 1e9 / (1024 * 1024),
+          (double)total / (double)state_count, p99, longest, collisions);
+}
+
+static void benchmark(void) {
+
+  /* copy the states out of the seen set, so they can be hashed without
+   * chasing pointers
+   */
+  size_t size = set_size(global_seen);
+  state_data = malloc(seen_count() * STATE_SIZE_BYTES + 1);
+  if (state_data == NULL) {
+    oom();
+  }
+  for (size_t i = 0; i < size; i++) {
+    slot_t slot = global_seen->bucket[i];
+    if (slot_is_empty(slot) || slot_is_tombstone(slot)) {
+      continue;
+    }
+    memcpy(&state_data[state_count * STATE_SIZE_BYTES],
+           slot_to_state(slot)->data, STATE_SIZE_BYTES);
+    state_count++;
+  }
+  if (state_count == 0) {
+    return;
+  }
+  timed_count = 256 * 1024 / STATE_SIZE_BYTES;
+  if (timed_count == 0) {
+    timed_count = 1;
+  } else if (timed_count > state_count) {
+    timed_count = state_count;
+  }
+
+  uint64_t *hashes = malloc(state_count * sizeof(hashes[0]));
+  if (hashes == NULL) {
+    oom();
+  }
+
+#if PRINT_HEADER
+  fprintf(stderr, "\n%zu states of %zu bytes, seen set of %zu slots\n\n",
+          state_count, (size_t)STATE_SIZE_BYTES, size);
+  fprintf(stderr, "%-9s %10s %10s %10s %10s %10s %10s\n", "kernel",
+          "ns/state", "MB/s", "mean probe", "p99 probe", "max probe",
+          "collisions");
+#endif
+
+  double ns = time_kernel();
+  hashes_kernel(hashes);
+  bool fallback = hash_function_used() != HASH_FUNCTION;
+  char name[16];
+  snprintf(name, sizeof(name), "%s%s", KERNEL, fallback ? "*" : "");
+  report(name, ns, hashes);
+
+  if (fallback) {
+    fprintf(stderr, "* CRC32C instructions are unavailable, so this kernel "
+                    "fell back to MurmurHash\n");
+  }
+
+  free(hashes);
+}
+
+int main(void) {
+  atexit(benchmark);
+  return checker_main();
+}
+'''
+
+# values of --hash to compare
+KERNELS = ('additive', 'crc32c', 'murmur', 'xxh')
+
+def main(args):
+
+  # parse command line arguments
+  parser = argparse.ArgumentParser(
+    description='compare state hash kernels on the states of a model')
+  parser.add_argument('--rumur', default='rumur', help='Rumur binary to use')
+  parser.add_argument('--cc', default=os.environ.get('CC', 'cc'),
+    help='C compiler to use')
+  parser.add_argument('--cflags', default='-O3',
+    help='flags to compile with, e.g. "-O3 -march=native"')
+  parser.add_argument('model', help='model whose states to hash')
+  parser.add_argument('rumur_args', nargs='*',
+    help='extra arguments to pass to Rumur')
+  options = parser.parse_args(args[1:])
+
+  with tempfile.TemporaryDirectory() as tmp:
+
+    checker_c = os.path.join(tmp, 'checker.c')
+    harness_c = os.path.join(tmp, 'harness.c')
+    harness = os.path.join(tmp, 'harness')
+
+    with open(harness_c, 'wt') as f:
+      f.write(HARNESS)
+
+    # only the selected kernel is compiled into a verifier, so generate one per
+    # kernel
+    for i, kernel in enumerate(KERNELS):
+
+      subprocess.check_call([options.rumur, '--output', checker_c,
+        options.model] + options.rumur_args + ['--hash', kernel])
+
+      subprocess.check_call([options.cc, '-std=c11', '-mcx16'] +
+        options.cflags.split() + [f'-DKERNEL="{kernel}"',
+        f'-DPRINT_HEADER={int(i == 0)}', harness_c, '-o', harness,
+        '-lpthread'])
+
+      # the verifier's own output goes to stdout, and the report to stderr
+      p = subprocess.run([harness], stdout=subprocess.DEVNULL)
+      if p.returncode != 0:
+        return p.returncode
+
+  return 0
+
+if __name__ == '__main__':
+  sys.exit(main(sys.argv))
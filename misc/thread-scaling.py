@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+
+'''
+Measure how the throughput of a generated verifier scales with thread count.
+
+For each requested thread count, this generates a verifier for the given model,
+compiles it, runs it and reports the number of states explored per second. If
+multiple Rumur binaries are given (e.g. builds from before and after a change),
+a column is reported for each, to compare them.
+'''
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+def measure(rumur, cc, model, threads, extra):
+  '''
+  generate, compile and run a verifier, returning (states, seconds)
+  '''
+
+  with tempfile.TemporaryDirectory() as tmp:
+
+    checker_c = os.path.join(tmp, 'checker.c')
+    checker = os.path.join(tmp, 'checker')
+
+    subprocess.check_call([rumur, '--threads', str(threads), '--output',
+      checker_c, model] + extra)
+
+    subprocess.check_call([cc, '-std=c11', '-O3', '-mcx16', checker_c, '-o',
+      checker, '-lpthread'])
+
+    start = time.monotonic()
+    p = subprocess.run([checker], stdout=subprocess.PIPE,
+      universal_newlines=True)
+    duration = time.monotonic() - start
+
+    m = re.search(r'^\s*(\d+) states, ', p.stdout, re.MULTILINE)
+    if m is None:
+      raise Exception('failed to find state count in verifier output')
+
+    return int(m.group(1)), duration
+
+def main(args):
+
+  # parse command line arguments
+  parser = argparse.ArgumentParser(
+    description='measure verifier throughput against thread count')
+  parser.add_argument('--rumur', action='append',
+    help='Rumur binary to use (may be given multiple times to compare)')
+  parser.add_argument('--cc', default=os.environ.get('CC', 'cc'),
+    help='C compiler to use')
+  parser.add_argument('--threads', type=int, action='append',
+    help='thread count to measure (may be given multiple times)')
+  parser.add_argument('--repeat', type=int, default=3,
+    help='number of runs to take the best of')
+  parser.add_argument('model', help='model to check')
+  parser.add_argument('rumur_args', nargs='*',
+    help='extra arguments to pass to Rumur')
+  options = parser.parse_args(args[1:])
+
+  rumurs = options.rumur or ['rumur']
+
+  # default to powers of 2 up to the number of available CPUs
+  threads = options.threads
+  if threads is None:
+    threads = [1]
+    while threads[-1] * 2 <= (os.cpu_count() or 1):
+      threads.append(threads[-1] * 2)
+
+  print('threads  ' + '  '.join('{:>16}'.format(os.path.basename(r)[-16:])
+    for r in rumurs))
+
+  for t in threads:
+    rates = []
+    for r in rumurs:
+      best = None
+      for _ in range(options.repeat):
+        states, duration = measure(r, options.cc, options.model, t,
+          options.rumur_args)
+        rate = states / max(duration, 1e-6)
+        if best is None or rate > best:
+          best = rate
+      rates.append(best)
+    print('{:>7}  '.format(t) + '  '.join('{:>12.0f} st/s'.format(x)
+      for x in rates))
+    sys.stdout.flush()
+
+  return 0
+
+if __name__ == '__main__':
+  sys.exit(main(sys.argv))
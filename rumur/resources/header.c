@@ -42,20 +42,32 @@
 /* The size of the compressed state data in bytes. */
 enum { STATE_SIZE_BYTES = BITS_TO_BYTES(STATE_SIZE_BITS) };
 
-/* the size of auxliary members of the state struct */
-enum { BOUND_BITS = BITS_FOR(BOUND) };
-#if COUNTEREXAMPLE_TRACE != CEX_OFF || LIVENESS_COUNT > 0
+/* the number of bits of a user pointer that can be non-zero */
 #if POINTER_BITS != 0
-enum { PREVIOUS_BITS = POINTER_BITS };
+enum { RELEVANT_POINTER_BITS = POINTER_BITS };
 #elif defined(__linux__) && defined(__x86_64__) && !defined(__ILP32__)
 /* assume 5-level paging, and hence the top 2 bytes of any user pointer are
  * always 0 and not required.
  * https://www.kernel.org/doc/Documentation/x86/x86_64/mm.txt
  */
-enum { PREVIOUS_BITS = 56 };
+enum { RELEVANT_POINTER_BITS = 56 };
+#else
+enum { RELEVANT_POINTER_BITS = sizeof(void *) * 8 };
+#endif
+
+/* the number of bits needed to refer to a state, which with --max-states is an
+ * index rather than a pointer (see 'state_ref')
+ */
+#if STATE_ID_BITS > 0
+enum { STATE_REF_BITS = STATE_ID_BITS };
 #else
-enum { PREVIOUS_BITS = sizeof(void *) * 8 };
+enum { STATE_REF_BITS = RELEVANT_POINTER_BITS };
 #endif
+
+/* the size of auxliary members of the state struct */
+enum { BOUND_BITS = BITS_FOR(BOUND) };
+#if COUNTEREXAMPLE_TRACE != CEX_OFF || LIVENESS_COUNT > 0
+enum { PREVIOUS_BITS = STATE_REF_BITS };
 #else
 enum { PREVIOUS_BITS = 0 };
 #endif
@@ -70,6 +82,19 @@ enum {
                     (USE_SCALARSET_SCHEDULES ? SCHEDULE_BITS : 0))
 };
 
+/* Does the seen set keep the states inserted into it? With hash compaction it
+ * only records a fingerprint of each state, in bitstate mode only a few bits
+ * derived from each state, with tree compression a tree of nodes shared with
+ * other states, with the inline set layout its own copy of each state's data,
+ * and with external memory the states are kept on disk. In these cases a state
+ * lives only as long as it is queued and can be reclaimed once it has been
+ * expanded.
+ */
+enum {
+  SET_STORES_STATES = HASH_COMPACTION_BITS == 0 && BITSTATE_HASHES == 0 &&
+                      !TREE_COMPRESSION && !INLINE_SET && !EXTERNAL_MEMORY
+};
+
 /* Implement _Thread_local for GCC <4.9, which is missing this. */
 #if defined(__GNUC__) && defined(__GNUC_MINOR__)
 #if __GNUC__ < 4 || (__GNUC__ == 4 && __GNUC_MINOR__ < 9)
@@ -277,9 +302,11 @@ static void sandbox(void) {
                  THREADS > 1 ? SECCOMP_RET_ALLOW : SECCOMP_RET_TRAP),
 #endif
 #ifdef __NR_madvise
+        /* also used to request transparent huge pages */
         BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_madvise, 0, 1),
-        BPF_STMT(BPF_RET | BPF_K,
-                 THREADS > 1 ? SECCOMP_RET_ALLOW : SECCOMP_RET_TRAP),
+        BPF_STMT(BPF_RET | BPF_K, THREADS > 1 || HUGE_PAGES
+                                      ? SECCOMP_RET_ALLOW
+                                      : SECCOMP_RET_TRAP),
 #endif
 #ifdef __NR_mprotect
         BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_mprotect, 0, 1),
@@ -305,6 +332,22 @@ static void sandbox(void) {
                  THREADS > 1 ? SECCOMP_RET_ALLOW : SECCOMP_RET_TRAP),
 #endif
 
+    /* If we're using NUMA placement, enable syscalls used to pin threads and
+     * place memory.
+     */
+#ifdef __NR_mbind
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_mbind, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, NUMA ? SECCOMP_RET_ALLOW : SECCOMP_RET_TRAP),
+#endif
+#ifdef __NR_sched_setaffinity
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_sched_setaffinity, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, NUMA ? SECCOMP_RET_ALLOW : SECCOMP_RET_TRAP),
+#endif
+#ifdef __NR_set_mempolicy
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_set_mempolicy, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, NUMA ? SECCOMP_RET_ALLOW : SECCOMP_RET_TRAP),
+#endif
+
     /* on platforms without vDSO support, time() makes an actual syscall, so
      * we need to allow them
      */
@@ -487,9 +530,9 @@ static __attribute__((const)) bool value_is_signed(void) {
  * More information on this at https://github.com/aappleby/smhasher/           *
  ******************************************************************************/
 
-static uint64_t MurmurHash64A(const void *NONNULL key, size_t len) {
-
-  static const uint64_t seed = 0;
+#if HASH_FUNCTION == HASH_MURMUR || HASH_FUNCTION == HASH_CRC32C
+static uint64_t MurmurHash64A(const void *NONNULL key, size_t len,
+                              uint64_t seed) {
 
   static const uint64_t m = UINT64_C(0xc6a4a7935bd1e995);
   static const unsigned r = 47;
@@ -532,6 +575,299 @@ static uint64_t MurmurHash64A(const void *NONNULL key, size_t len) {
 
   return h;
 }
+#endif
+
+/*******************************************************************************
+ * Alternative state hash functions                                            *
+ *                                                                             *
+ * The kernel used to hash states is chosen by --hash (see HASH_FUNCTION).     *
+ * Each takes the same arguments as MurmurHash64A. They are always called      *
+ * with the fixed length STATE_SIZE_BYTES, so the compiler can specialise      *
+ * them, unrolling loops and discarding the handling of lengths that never     *
+ * occur. Only the selected one is compiled in, with the helpers it needs.     *
+ ******************************************************************************/
+
+#if HASH_FUNCTION == HASH_ADDITIVE || HASH_FUNCTION == HASH_CRC32C ||          \
+    TREE_COMPRESSION
+/* The 64-bit finaliser of MurmurHash3. */
+static uint64_t hash_mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= UINT64_C(0xff51afd7ed558ccd);
+  x ^= x >> 33;
+  x *= UINT64_C(0xc4ceb9fe1a85ec53);
+  x ^= x >> 33;
+  return x;
+}
+#endif
+
+#if HASH_FUNCTION != HASH_MURMUR
+/* Read up to 8 bytes as a word, zero-padded. Short reads are assembled byte by
+ * byte, as copying them into a zeroed word and then loading it stalls on store
+ * forwarding.
+ */
+static uint64_t hash_read(const unsigned char *NONNULL p, size_t n) {
+  uint64_t k = 0;
+  if (n >= sizeof(k)) {
+    memcpy(&k, p, sizeof(k));
+    return k;
+  }
+  for (size_t i = 0; i < n; i++) {
+    k |= (uint64_t)p[i] << (i * CHAR_BIT);
+  }
+  return k;
+}
+#endif
+
+#if HASH_FUNCTION == HASH_ADDITIVE
+/* Mix one 64-bit word of data, at the given word index. */
+static uint64_t hash_word(uint64_t word, size_t index) {
+  return hash_mix(word ^ ((uint64_t)index * UINT64_C(0x9e3779b97f4a7c15)));
+}
+
+/* Hash each word independently and sum the results. This is weaker than the
+ * other kernels, but lets the hash of a state that differs from another in
+ * only a few words be derived from the other's hash (see state_hash_from()).
+ */
+static uint64_t additive_hash(const void *NONNULL key, size_t len,
+                              uint64_t seed) {
+
+  const unsigned char *data = key;
+  uint64_t h = 0;
+
+  for (size_t i = 0; i * sizeof(uint64_t) < len; i++) {
+    size_t offset = i * sizeof(uint64_t);
+    uint64_t k = hash_read(data + offset, len - offset);
+    h += hash_word(k ^ seed, i);
+  }
+
+  return h;
+}
+#endif
+
+#if HASH_FUNCTION == HASH_XXH
+/* A hash in the style of XXH3 (https://github.com/Cyan4973/xxHash). Data is
+ * consumed in 64-byte stripes, each folded into eight independent 64-bit
+ * accumulators with a 32x32-bit multiply. There are no dependencies between
+ * the accumulators, so compilers turn this into SIMD code. The accumulators
+ * are merged at the end with 128-bit multiplies. This does not produce the
+ * same values as XXH3 itself.
+ */
+static const uint64_t XXH_KEY[12] = {
+    UINT64_C(0xbe4ba423396cfeb8), UINT64_C(0x1cad21f72c81017c),
+    UINT64_C(0xdb979083e96dd4de), UINT64_C(0x1f67b3b7a4a44072),
+    UINT64_C(0x78e5c0cc4ee679cb), UINT64_C(0x2172ffcc7dd05a82),
+    UINT64_C(0x8e2443f7744608b8), UINT64_C(0x4c263a81e69035e0),
+    UINT64_C(0xcb00c391bb52283c), UINT64_C(0xa32e531b8b65d088),
+    UINT64_C(0x4ef90da297486471), UINT64_C(0xd8acdea946ef1938),
+};
+
+/* Multiply two 64-bit values and fold the 128-bit product into 64 bits. */
+static uint64_t xxh_mul_fold(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__ /* if we have the type `__int128` */
+  unsigned __int128 p = (unsigned __int128)a * b;
+  return (uint64_t)p ^ (uint64_t)(p >> 64);
+#else
+  uint64_t a_lo = a & UINT32_MAX, a_hi = a >> 32;
+  uint64_t b_lo = b & UINT32_MAX, b_hi = b >> 32;
+  uint64_t lo_lo = a_lo * b_lo;
+  uint64_t hi_lo = a_hi * b_lo;
+  uint64_t lo_hi = a_lo * b_hi;
+  uint64_t hi_hi = a_hi * b_hi;
+  uint64_t cross = (lo_lo >> 32) + (hi_lo & UINT32_MAX) + lo_hi;
+  uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+  uint64_t lower = (cross << 32) | (lo_lo & UINT32_MAX);
+  return lower ^ upper;
+#endif
+}
+
+static uint64_t xxh_avalanche(uint64_t h) {
+  h ^= h >> 37;
+  h *= UINT64_C(0x165667919e3779f9);
+  h ^= h >> 32;
+  return h;
+}
+
+/* Pairs of accumulators are held in vectors. Where the target has no vector
+ * instructions, the compiler lowers operations on these to scalar code.
+ */
+typedef uint64_t xxh_lanes __attribute__((vector_size(2 * sizeof(uint64_t))));
+
+/* Multiply the low 32 bits of each lane of `a` and `b`. */
+static xxh_lanes xxh_mul32(xxh_lanes a, xxh_lanes b) {
+#ifdef __SSE2__
+  return (xxh_lanes)_mm_mul_epu32((__m128i)a, (__m128i)b);
+#else
+  return (a & UINT32_MAX) * (b & UINT32_MAX);
+#endif
+}
+
+/* Fold the eight words of a stripe into the accumulators. */
+static void xxh_accumulate(xxh_lanes *NONNULL acc, const uint64_t *NONNULL v,
+                           uint64_t seed) {
+  for (size_t i = 0; i < 4; i++) {
+    xxh_lanes data = {v[2 * i], v[2 * i + 1]};
+    xxh_lanes key = {XXH_KEY[2 * i] + seed, XXH_KEY[2 * i + 1] + seed};
+    xxh_lanes k = data ^ key;
+    acc[i] += (xxh_lanes){data[1], data[0]};
+    acc[i] += xxh_mul32(k, k >> 32);
+  }
+}
+
+static uint64_t xxh_hash(const void *NONNULL key, size_t len, uint64_t seed) {
+
+  const unsigned char *data = key;
+
+  /* short inputs skip the accumulators, as most of their lanes would be idle
+   */
+  if (len <= 16) {
+    uint64_t lo = hash_read(data, len);
+    uint64_t hi = len > sizeof(lo) ? hash_read(data + sizeof(lo),
+                                               len - sizeof(lo))
+                                   : 0;
+    uint64_t h =
+        len + xxh_mul_fold(lo ^ (XXH_KEY[0] + seed), hi ^ (XXH_KEY[1] - seed));
+    return xxh_avalanche(h);
+  }
+
+  xxh_lanes acc[4] = {
+      {UINT64_C(0x00000000c2b2ae3d), UINT64_C(0x9e3779b185ebca87)},
+      {UINT64_C(0xc2b2ae3d27d4eb4f), UINT64_C(0x165667b19e3779f9)},
+      {UINT64_C(0x85ebca77c2b2ae63), UINT64_C(0x0000000085ebca77)},
+      {UINT64_C(0x27d4eb2f165667c5), UINT64_C(0x000000009e3779b1)},
+  };
+
+  size_t i = 0;
+  for (; i + 64 <= len; i += 64) {
+    uint64_t v[8];
+    memcpy(v, data + i, sizeof(v));
+    xxh_accumulate(acc, v, seed);
+  }
+  if (i < len) {
+    uint64_t v[8] = {0};
+    for (size_t j = 0; i + j * sizeof(v[0]) < len; j++) {
+      size_t offset = i + j * sizeof(v[0]);
+      v[j] = hash_read(data + offset, len - offset);
+    }
+    xxh_accumulate(acc, v, seed);
+  }
+
+  uint64_t h = len * UINT64_C(0x9e3779b185ebca87);
+  for (size_t j = 0; j < 4; j++) {
+    h += xxh_mul_fold(acc[j][0] ^ XXH_KEY[2 * j + 4],
+                      acc[j][1] ^ XXH_KEY[2 * j + 5]);
+  }
+  return xxh_avalanche(h);
+}
+#endif
+
+#if HASH_FUNCTION == HASH_CRC32C
+/* A hash built on the CRC32C instruction of SSE 4.2. Two CRCs are computed
+ * over alternating words, which lets consecutive instructions overlap, and
+ * joined into a 64-bit value. CRCs are linear, so the result is put through
+ * hash_mix() to spread its bits. On CPUs without the instruction, this falls
+ * back to MurmurHash64A.
+ */
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CRC32C_HW_SUPPORTED 1
+#else
+#define CRC32C_HW_SUPPORTED 0
+#endif
+
+#if CRC32C_HW_SUPPORTED
+#ifndef __SSE4_2__
+/* Whether the CPU we are running on has the CRC32C instruction. This is set by
+ * hash_init() before any state is hashed.
+ */
+static bool crc32c_available;
+#endif
+
+static __attribute__((target("sse4.2"))) uint64_t
+crc32c_hash_hw(const void *NONNULL key, size_t len, uint64_t seed) {
+
+  const unsigned char *data = key;
+  uint64_t a = seed & UINT32_MAX;
+  uint64_t b = (seed >> 32) ^ UINT32_MAX;
+
+  size_t i = 0;
+  for (; i + 2 * sizeof(uint64_t) <= len; i += 2 * sizeof(uint64_t)) {
+    uint64_t k1, k2;
+    memcpy(&k1, data + i, sizeof(k1));
+    memcpy(&k2, data + i + sizeof(k1), sizeof(k2));
+    a = __builtin_ia32_crc32di(a, k1);
+    b = __builtin_ia32_crc32di(b, k2);
+  }
+  if (i + sizeof(uint64_t) <= len) {
+    uint64_t k;
+    memcpy(&k, data + i, sizeof(k));
+    a = __builtin_ia32_crc32di(a, k);
+    i += sizeof(k);
+  }
+  if (i < len) {
+    b = __builtin_ia32_crc32di(b, hash_read(data + i, len - i));
+  }
+
+  return hash_mix(((a << 32) | b) ^ len);
+}
+#endif
+
+/* Whether the CRC32C kernel can use the instruction it is built on. */
+static bool crc32c_usable(void) {
+#if !CRC32C_HW_SUPPORTED
+  return false;
+#elif defined(__SSE4_2__)
+  return true;
+#else
+  return crc32c_available;
+#endif
+}
+
+static uint64_t crc32c_hash(const void *NONNULL key, size_t len,
+                            uint64_t seed) {
+#if CRC32C_HW_SUPPORTED
+  if (__builtin_expect(crc32c_usable(), 1)) {
+    return crc32c_hash_hw(key, len, seed);
+  }
+#endif
+  return MurmurHash64A(key, len, seed);
+}
+#endif
+
+/* Hash state-sized data with the selected kernel. */
+static uint64_t hash_kernel(const void *NONNULL key, uint64_t seed) {
+#if HASH_FUNCTION == HASH_ADDITIVE
+  return additive_hash(key, STATE_SIZE_BYTES, seed);
+#elif HASH_FUNCTION == HASH_XXH
+  return xxh_hash(key, STATE_SIZE_BYTES, seed);
+#elif HASH_FUNCTION == HASH_CRC32C
+  return crc32c_hash(key, STATE_SIZE_BYTES, seed);
+#else
+  return MurmurHash64A(key, STATE_SIZE_BYTES, seed);
+#endif
+}
+
+/* The kernel states are actually hashed with, accounting for fallbacks. This
+ * is recorded in checkpoints, whose seen set layout depends on it.
+ */
+static int hash_function_used(void) {
+#if HASH_FUNCTION == HASH_CRC32C
+  if (!crc32c_usable()) {
+    return HASH_MURMUR;
+  }
+#endif
+  return HASH_FUNCTION;
+}
+
+/* Detect the CPU features hash kernels depend on. */
+static void hash_init(void) {
+#if HASH_FUNCTION == HASH_CRC32C && CRC32C_HW_SUPPORTED && !defined(__SSE4_2__)
+  __builtin_cpu_init();
+  crc32c_available = __builtin_cpu_supports("sse4.2");
+#endif
+  if (hash_function_used() != HASH_FUNCTION) {
+    fprintf(stderr, "CRC32C instructions are unavailable on this CPU; states "
+                    "will be hashed with MurmurHash instead\n");
+  }
+}
 
 /******************************************************************************/
 
@@ -684,6 +1020,13 @@ struct state {
   uint64_t rule_taken;
   uint8_t schedules[USE_SCALARSET_SCHEDULES ? BITS_TO_BYTES(SCHEDULE_BITS) : 0];
 #endif
+
+#if INCREMENTAL_HASH
+  /* hash of `data`, stored when the state is inserted into the seen set. This
+   * is kept as bytes so as not to force padding of packed states.
+   */
+  uint8_t hash[sizeof(uint64_t)];
+#endif
 };
 
 struct handle {
@@ -1103,6 +1446,32 @@ static void state_bound_set(struct state *NONNULL s, uint64_t bound) {
 }
 #endif
 
+#if STATE_ID_BITS > 0
+/* With --max-states, all states are allocated from a single pool (see
+ * 'state_new'), so a state can be referred to by its index in this. Index 0
+ * stands for no state, so references are the index plus one.
+ */
+static struct state *state_pool;
+#endif
+
+/* Compact a state pointer into a reference of STATE_REF_BITS bits. */
+static __attribute__((unused)) uint64_t state_ref(const struct state *s) {
+#if STATE_ID_BITS > 0
+  return s == NULL ? 0 : (uint64_t)(s - state_pool) + 1;
+#else
+  return (uint64_t)(uintptr_t)s;
+#endif
+}
+
+/* Recover a state pointer from its reference. */
+static __attribute__((unused)) struct state *state_deref(uint64_t ref) {
+#if STATE_ID_BITS > 0
+  return ref == 0 ? NULL : &state_pool[ref - 1];
+#else
+  return (struct state *)(uintptr_t)ref;
+#endif
+}
+
 #if COUNTEREXAMPLE_TRACE != CEX_OFF || LIVENESS_COUNT > 0
 #if PACK_STATE
 static struct handle state_previous_handle(const struct state *NONNULL s) {
@@ -1123,7 +1492,7 @@ static __attribute__((pure)) const struct state *
 state_previous_get(const struct state *NONNULL s) {
 #if PACK_STATE
   struct handle h = state_previous_handle(s);
-  return (const struct state *)(uintptr_t)read_raw(h);
+  return state_deref(read_raw(h));
 #else
   return s->previous;
 #endif
@@ -1133,11 +1502,10 @@ static void state_previous_set(struct state *NONNULL s,
                                const struct state *previous) {
 #if PACK_STATE
   ASSERT(
-      (PREVIOUS_BITS == sizeof(void *) * 8 ||
-       ((uintptr_t)previous >> PREVIOUS_BITS) == 0) &&
+      (PREVIOUS_BITS == 64 || (state_ref(previous) >> PREVIOUS_BITS) == 0) &&
       "upper bits of pointer are non-zero (incorrect --pointer-bits setting?)");
   struct handle h = state_previous_handle(s);
-  write_raw(h, (uint64_t)(uintptr_t)previous);
+  write_raw(h, state_ref(previous));
 #else
   s->previous = previous;
 #endif
@@ -1244,104 +1612,605 @@ static __attribute__((unused)) void state_schedule_set(struct state *NONNULL s,
 }
 
 /*******************************************************************************
- * State allocator.                                                            *
+ * NUMA placement                                                              *
  *                                                                             *
- * The following implements a simple bump allocator for states. The purpose of *
- * this (rather than simply mallocing individual states) is to speed up        *
- * allocation by taking global locks less frequently and decrease allocator    *
- * metadata overhead.                                                          *
+ * With --numa on, each thread is pinned to a CPU, taking CPUs from each NUMA  *
+ * node in turn. Each thread then prefers memory from its own node, so the     *
+ * states it allocates and its pending state queue are node-local. The seen    *
+ * set, which every thread accesses uniformly, is interleaved across nodes.    *
+ * This talks to the Linux kernel directly rather than going via libnuma, to   *
+ * avoid a link-time dependency.                                               *
  ******************************************************************************/
 
-/* An initial size of thread-local allocator pools ~8MB. */
-static _Thread_local size_t arena_count =
-    (sizeof(struct state) > 8 * 1024 * 1024)
-        ? 1
-        : (8 * 1024 * 1024 / sizeof(struct state));
+#if NUMA && defined(__linux__)
+/* Largest CPU and node numbers we handle. */
+enum { NUMA_MAX_CPUS = 4096 };
+enum { NUMA_MAX_NODES = 1024 };
 
-static _Thread_local struct state *arena_base;
-static _Thread_local struct state *arena_limit;
+/* Memory policies and flags, from linux/mempolicy.h. */
+enum { NUMA_MPOL_PREFERRED = 1, NUMA_MPOL_INTERLEAVE = 3 };
+enum { NUMA_MPOL_MF_MOVE = 2 };
 
-static struct state *state_new(void) {
+enum { NUMA_WORD_BITS = sizeof(unsigned long) * CHAR_BIT };
 
-  if (arena_base == arena_limit) {
-    /* Allocation pool is empty. We need to set up a new pool. */
-    for (;;) {
-      if (arena_count == 1) {
-        arena_base = xmalloc(sizeof(*arena_base));
-      } else {
-        arena_base = calloc(arena_count, sizeof(*arena_base));
-        if (__builtin_expect(arena_base == NULL, 0)) {
-          /* Memory pressure high. Decrease our attempted allocation and try
-           * again.
-           */
-          arena_count /= 2;
-          continue;
-        }
-      }
+/* Nodes that have at least one CPU we can run on. */
+static unsigned long numa_nodes[NUMA_MAX_NODES / NUMA_WORD_BITS];
+static size_t numa_node_count;
 
-      arena_limit = arena_base + arena_count;
+/* Whether the seen set has been interleaved across nodes. */
+static bool numa_interleaved;
+#endif
+
+/* The CPU and node each thread was pinned to, or -1 if it was not. */
+static struct {
+  long cpu;
+  long node;
+} numa_placement[THREADS];
+
+#if NUMA && defined(__linux__)
+/* Read a list of the form "0-3,8,10-11" from a sysfs file, setting the
+ * corresponding bits in `mask`. Returns false if the file cannot be read.
+ */
+static bool numa_read_list(const char *NONNULL path,
+                           unsigned long *NONNULL mask, size_t max) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return false;
+  }
+
+  unsigned long first, last;
+  int c;
+  while (fscanf(f, "%lu", &first) == 1) {
+    last = first;
+    c = fgetc(f);
+    if (c == '-') {
+      if (fscanf(f, "%lu", &last) != 1) {
+        break;
+      }
+      c = fgetc(f);
+    }
+    for (unsigned long i = first; i <= last && i < max; i++) {
+      mask[i / NUMA_WORD_BITS] |= 1ul << (i % NUMA_WORD_BITS);
+    }
+    if (c != ',') {
       break;
     }
   }
 
-  assert(arena_base != NULL);
-  assert(arena_base != arena_limit);
+  (void)fclose(f);
+  return true;
+}
 
-  struct state *s = arena_base;
-  arena_base++;
-  return s;
+static bool numa_is_set(const unsigned long *NONNULL mask, size_t i) {
+  return (mask[i / NUMA_WORD_BITS] >> (i % NUMA_WORD_BITS)) & 1;
 }
+#endif
 
-static void state_free(struct state *s) {
+/* Decide which CPU each thread will run on. This needs to read from sysfs, so
+ * must be called before the sandbox is entered.
+ */
+static void numa_init(void) {
 
-  if (s == NULL) {
-    return;
+  for (size_t i = 0; i < sizeof(numa_placement) / sizeof(numa_placement[0]);
+       i++) {
+    numa_placement[i].cpu = -1;
+    numa_placement[i].node = -1;
   }
 
-  assert(s + 1 == arena_base);
-  arena_base--;
-}
+#if NUMA && defined(__linux__)
+  /* the CPUs we are allowed to run on */
+  static unsigned long allowed[NUMA_MAX_CPUS / NUMA_WORD_BITS];
+  if (syscall(SYS_sched_getaffinity, 0, sizeof(allowed), allowed) < 0) {
+    perror("sched_getaffinity");
+    return;
+  }
 
-/*******************************************************************************
- * statistics for memory usage                                                 *
- *                                                                             *
- * This functionality is only used when `--trace memory_usage` is given on the *
- * command line.                                                               *
- ******************************************************************************/
+  /* the node of each allowed CPU */
+  static long node_of[NUMA_MAX_CPUS];
+  for (size_t i = 0; i < NUMA_MAX_CPUS; i++) {
+    node_of[i] = -1;
+  }
 
-/* number of allocated state structs per depth of expansion */
-static size_t allocated[BOUND == 0 ? 1 : (BOUND + 1)];
+  static unsigned long possible[NUMA_MAX_NODES / NUMA_WORD_BITS];
+  if (numa_read_list("/sys/devices/system/node/possible", possible,
+                     NUMA_MAX_NODES)) {
+    for (size_t node = 0; node < NUMA_MAX_NODES; node++) {
+      if (!numa_is_set(possible, node)) {
+        continue;
+      }
+      char path[128];
+      snprintf(path, sizeof(path), "/sys/devices/system/node/node%zu/cpulist",
+               node);
+      unsigned long cpus[NUMA_MAX_CPUS / NUMA_WORD_BITS] = {0};
+      if (!numa_read_list(path, cpus, NUMA_MAX_CPUS)) {
+        continue;
+      }
+      for (size_t cpu = 0; cpu < NUMA_MAX_CPUS; cpu++) {
+        if (numa_is_set(cpus, cpu) && numa_is_set(allowed, cpu)) {
+          node_of[cpu] = (long)node;
+        }
+      }
+    }
+  }
 
-/* note a new allocation of a state struct at the given depth */
-static void register_allocation(size_t depth) {
+  /* If the kernel told us nothing about nodes, treat the machine as one. */
+  bool any = false;
+  for (size_t cpu = 0; cpu < NUMA_MAX_CPUS; cpu++) {
+    if (node_of[cpu] >= 0) {
+      any = true;
+      break;
+    }
+  }
+  if (!any) {
+    for (size_t cpu = 0; cpu < NUMA_MAX_CPUS; cpu++) {
+      if (numa_is_set(allowed, cpu)) {
+        node_of[cpu] = 0;
+      }
+    }
+  }
 
-  /* if we are not tracing memory usage, make this a no-op */
-  if (!(TC_MEMORY_USAGE & TRACES_ENABLED)) {
+  for (size_t cpu = 0; cpu < NUMA_MAX_CPUS; cpu++) {
+    if (node_of[cpu] >= 0 && !numa_is_set(numa_nodes, (size_t)node_of[cpu])) {
+      numa_nodes[(size_t)node_of[cpu] / NUMA_WORD_BITS] |=
+          1ul << ((size_t)node_of[cpu] % NUMA_WORD_BITS);
+      numa_node_count++;
+    }
+  }
+  if (numa_node_count == 0) {
     return;
   }
 
-  ASSERT(depth < sizeof(allocated) / sizeof(allocated[0]) &&
-         "out of range access to allocated array");
-
-  /* increment the number of known allocated states, avoiding an expensive
-   * atomic if we are single-threaded
+  /* Deal out CPUs to threads, taking the next unused CPU of each node in turn
+   * so threads are spread evenly across nodes. If there are more threads than
+   * CPUs, start again from the beginning.
    */
-  if (THREADS == 1) {
-    allocated[depth]++;
-  } else {
-    (void)__sync_add_and_fetch(&allocated[depth], 1);
+  static size_t next_cpu[NUMA_MAX_NODES];
+  size_t node = 0;
+  for (size_t i = 0; i < THREADS; i++) {
+    for (size_t attempts = 0;; attempts++) {
+      if (attempts == NUMA_MAX_NODES) {
+        /* every CPU has been used */
+        memset(next_cpu, 0, sizeof(next_cpu));
+        attempts = 0;
+      }
+      size_t n = node;
+      node = (node + 1) % NUMA_MAX_NODES;
+      if (!numa_is_set(numa_nodes, n)) {
+        continue;
+      }
+      while (next_cpu[n] < NUMA_MAX_CPUS &&
+             node_of[next_cpu[n]] != (long)n) {
+        next_cpu[n]++;
+      }
+      if (next_cpu[n] < NUMA_MAX_CPUS) {
+        numa_placement[i].cpu = (long)next_cpu[n];
+        numa_placement[i].node = (long)n;
+        next_cpu[n]++;
+        break;
+      }
+    }
   }
+#elif NUMA
+  fprintf(stderr, "NUMA placement is not supported on this platform\n");
+#endif
 }
 
-/* print a summary of the allocation results we have accrued */
-static void print_allocation_summary(void) {
+/* Pin the calling thread to its chosen CPU and prefer memory local to it. */
+static void numa_thread_init(void) {
+#if NUMA && defined(__linux__)
+  long cpu = numa_placement[thread_id].cpu;
+  if (cpu < 0) {
+    return;
+  }
 
-  /* it is assumed we are running single-threaded here and do not need atomic
-   * accesses
-   */
+  unsigned long mask[NUMA_MAX_CPUS / NUMA_WORD_BITS] = {0};
+  mask[(size_t)cpu / NUMA_WORD_BITS] = 1ul << ((size_t)cpu % NUMA_WORD_BITS);
+  if (syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) < 0) {
+    fprintf(stderr, "failed to pin thread %zu to CPU %ld: %s\n", thread_id,
+            cpu, strerror(errno));
+    numa_placement[thread_id].cpu = -1;
+    numa_placement[thread_id].node = -1;
+    return;
+  }
 
-  if (BOUND == 0) {
-    TRACE(TC_MEMORY_USAGE,
+  if (numa_node_count > 1) {
+    long node = numa_placement[thread_id].node;
+    unsigned long nodes[NUMA_MAX_NODES / NUMA_WORD_BITS] = {0};
+    nodes[(size_t)node / NUMA_WORD_BITS] = 1ul
+                                           << ((size_t)node % NUMA_WORD_BITS);
+    if (syscall(SYS_set_mempolicy, NUMA_MPOL_PREFERRED, nodes,
+                NUMA_MAX_NODES + 1) < 0) {
+      fprintf(stderr, "failed to set memory policy of thread %zu: %s\n",
+              thread_id, strerror(errno));
+    }
+  }
+#endif
+}
+
+/* Spread the pages of a newly allocated region across all nodes. */
+static void numa_interleave(void *NONNULL p __attribute__((unused)),
+                            size_t size __attribute__((unused))) {
+#if NUMA && defined(__linux__)
+  if (numa_node_count < 2) {
+    return;
+  }
+
+  /* we can only set the policy of whole pages */
+  uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  uintptr_t start = ((uintptr_t)p + page - 1) & ~(page - 1);
+  uintptr_t end = ((uintptr_t)p + size) & ~(page - 1);
+  if (start >= end) {
+    return;
+  }
+
+  if (syscall(SYS_mbind, (void *)start, (unsigned long)(end - start),
+              NUMA_MPOL_INTERLEAVE, numa_nodes, NUMA_MAX_NODES + 1,
+              NUMA_MPOL_MF_MOVE) < 0) {
+    fprintf(stderr, "failed to interleave seen set memory: %s\n",
+            strerror(errno));
+    return;
+  }
+  numa_interleaved = true;
+#endif
+}
+
+/* Report where threads were placed. */
+static void numa_print_placement(void) {
+#if NUMA
+  if (MACHINE_READABLE_OUTPUT) {
+    put("<numa_placement");
+#ifdef __linux__
+    put(" nodes=\"");
+    put_uint(numa_node_count);
+    put("\" set_interleaved=\"");
+    put(numa_interleaved ? "true" : "false");
+    put("\"");
+#endif
+    put(">\n");
+    for (size_t i = 0; i < sizeof(numa_placement) / sizeof(numa_placement[0]);
+         i++) {
+      put("<thread id=\"");
+      put_uint(i);
+      if (numa_placement[i].cpu >= 0) {
+        put("\" cpu=\"");
+        put_uint((uintmax_t)numa_placement[i].cpu);
+        put("\" node=\"");
+        put_uint((uintmax_t)numa_placement[i].node);
+      }
+      put("\"/>\n");
+    }
+    put("</numa_placement>\n");
+  } else {
+    put("\t* NUMA placement");
+#ifdef __linux__
+    put(" across ");
+    put_uint(numa_node_count);
+    put(" node(s)");
+    if (numa_interleaved) {
+      put(", with the seen set interleaved across them");
+    }
+#endif
+    put(":\n");
+    for (size_t i = 0; i < sizeof(numa_placement) / sizeof(numa_placement[0]);
+         i++) {
+      put("\t\t- thread ");
+      put_uint(i);
+      if (numa_placement[i].cpu >= 0) {
+        put(" on CPU ");
+        put_uint((uintmax_t)numa_placement[i].cpu);
+        put(" (node ");
+        put_uint((uintmax_t)numa_placement[i].node);
+        put(")\n");
+      } else {
+        put(" not pinned\n");
+      }
+    }
+  }
+#endif
+}
+
+/******************************************************************************/
+
+/*******************************************************************************
+ * Huge page support                                                           *
+ *                                                                             *
+ * With --huge-pages on, the seen set and the state arenas are mapped directly *
+ * instead of being allocated with malloc, so they can be backed by huge pages *
+ * and take fewer TLB misses. Explicit huge pages (1GB pages for regions of at *
+ * least that size, then 2MB pages) are tried first, but are only available if *
+ * the administrator has reserved some. Failing that, we map normal pages      *
+ * aligned to 2MB and ask the kernel to back them with transparent huge pages. *
+ ******************************************************************************/
+
+#if HUGE_PAGES && defined(__linux__)
+#define HUGE_PAGES_SUPPORTED 1
+#else
+#define HUGE_PAGES_SUPPORTED 0
+#endif
+
+#if HUGE_PAGES_SUPPORTED
+enum { HUGE_PAGE_SIZE = 2 * 1024 * 1024 };
+
+static size_t huge_round_up(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+/* Map a zeroed region of at least `*size` bytes, updating `*size` to the
+ * length of the mapping. Returns NULL on failure.
+ */
+static void *huge_alloc(size_t *NONNULL size) {
+
+  /* Huge pages are of no use to regions smaller than one. */
+  if (*size < HUGE_PAGE_SIZE) {
+    size_t length = huge_round_up(*size, (size_t)sysconf(_SC_PAGESIZE));
+    void *p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      return NULL;
+    }
+    *size = length;
+    return p;
+  }
+
+#ifdef MAP_HUGETLB
+  static const struct {
+    size_t size;
+    int shift;
+  } explicit_pages[] = {
+      {(size_t)1 << 30, 30},
+      {(size_t)1 << 21, 21},
+  };
+  for (size_t i = 0; i < sizeof(explicit_pages) / sizeof(explicit_pages[0]);
+       i++) {
+    if (*size < explicit_pages[i].size) {
+      continue;
+    }
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#ifdef MAP_HUGE_SHIFT
+    flags |= explicit_pages[i].shift << MAP_HUGE_SHIFT;
+#endif
+    size_t length = huge_round_up(*size, explicit_pages[i].size);
+    void *p = mmap(NULL, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (p != MAP_FAILED) {
+      TRACE(TC_MEMORY_USAGE, "mapped %zu bytes with explicit %zuMB pages",
+            length, explicit_pages[i].size >> 20);
+      *size = length;
+      return p;
+    }
+  }
+#endif
+
+  /* Over-map, so we can trim the mapping to start on a huge page boundary. */
+  size_t length = huge_round_up(*size, HUGE_PAGE_SIZE);
+  uint8_t *p = mmap(NULL, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    return NULL;
+  }
+  uint8_t *base = (uint8_t *)huge_round_up((uintptr_t)p, HUGE_PAGE_SIZE);
+  size_t head = (size_t)(base - p);
+  if (head > 0) {
+    (void)munmap(p, head);
+  }
+  if (HUGE_PAGE_SIZE - head > 0) {
+    (void)munmap(base + length, HUGE_PAGE_SIZE - head);
+  }
+
+#ifdef MADV_HUGEPAGE
+  /* If this fails, we simply get normal pages. */
+  if (madvise(base, length, MADV_HUGEPAGE) == 0) {
+    TRACE(TC_MEMORY_USAGE, "mapped %zu bytes with transparent huge pages",
+          length);
+  }
+#endif
+
+  *size = length;
+  return base;
+}
+
+static void huge_free(void *p, size_t size) {
+  if (p != NULL) {
+    (void)munmap(p, size);
+  }
+}
+#endif
+
+/******************************************************************************/
+
+/*******************************************************************************
+ * State allocator.                                                            *
+ *                                                                             *
+ * The following implements a simple bump allocator for states. The purpose of *
+ * this (rather than simply mallocing individual states) is to speed up        *
+ * allocation by taking global locks less frequently and decrease allocator    *
+ * metadata overhead.                                                          *
+ ******************************************************************************/
+
+/* An initial size of thread-local allocator pools ~8MB. */
+static _Thread_local size_t arena_count =
+    (sizeof(struct state) > 8 * 1024 * 1024)
+        ? 1
+        : (8 * 1024 * 1024 / sizeof(struct state));
+
+static _Thread_local struct state *arena_base;
+static _Thread_local struct state *arena_limit;
+
+#if STATE_ID_BITS > 0
+/* With --max-states, arenas are instead carved out of the state pool, which is
+ * reserved up front but only backed by memory as it is used. Arenas are kept
+ * small enough that few states are stranded in other threads' arenas when the
+ * pool runs out.
+ */
+enum {
+  STATE_POOL_ARENA = MAX_STATES / THREADS / 16 > 0 ? MAX_STATES / THREADS / 16
+                                                   : 1
+};
+
+static size_t state_pool_used; /* states handed out to arenas */
+
+static void state_pool_init(void) {
+  if (__builtin_expect(MAX_STATES > SIZE_MAX / sizeof(struct state), 0)) {
+    oom();
+  }
+  size_t size = MAX_STATES * sizeof(struct state);
+#if HUGE_PAGES_SUPPORTED
+  state_pool = huge_alloc(&size);
+#elif defined(__linux__)
+  /* reserve the address space without committing memory to it */
+  void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  state_pool = p == MAP_FAILED ? NULL : p;
+#else
+  state_pool = calloc(MAX_STATES, sizeof(struct state));
+#endif
+  if (__builtin_expect(state_pool == NULL, 0)) {
+    oom();
+  }
+}
+#endif
+
+/* States that have been released out of allocation order. These are reused
+ * before carving new states out of the arena.
+ */
+static _Thread_local struct state **recycled;
+static _Thread_local size_t recycled_count;
+static _Thread_local size_t recycled_capacity;
+
+static struct state *state_new(void) {
+
+  if (recycled_count > 0) {
+    recycled_count--;
+    return recycled[recycled_count];
+  }
+
+  if (arena_base == arena_limit) {
+#if STATE_ID_BITS > 0
+    size_t count = arena_count < STATE_POOL_ARENA ? arena_count
+                                                  : STATE_POOL_ARENA;
+    size_t start =
+        __atomic_fetch_add(&state_pool_used, count, __ATOMIC_SEQ_CST);
+    if (__builtin_expect(start >= MAX_STATES, 0)) {
+      fprintf(stderr,
+              "more than %llu states are in memory; rerun with a larger "
+              "--max-states\n",
+              (unsigned long long)MAX_STATES);
+      exit(EXIT_FAILURE);
+    }
+    if (count > MAX_STATES - start) {
+      count = MAX_STATES - start;
+    }
+    arena_base = &state_pool[start];
+    arena_limit = arena_base + count;
+#else
+    /* Allocation pool is empty. We need to set up a new pool. */
+    for (;;) {
+      if (arena_count == 1) {
+        arena_base = xmalloc(sizeof(*arena_base));
+      } else {
+#if HUGE_PAGES_SUPPORTED
+        size_t size = arena_count * sizeof(*arena_base);
+        arena_base = huge_alloc(&size);
+#else
+        arena_base = calloc(arena_count, sizeof(*arena_base));
+#endif
+        if (__builtin_expect(arena_base == NULL, 0)) {
+          /* Memory pressure high. Decrease our attempted allocation and try
+           * again.
+           */
+          arena_count /= 2;
+          continue;
+        }
+#if HUGE_PAGES_SUPPORTED
+        /* use any extra space the mapping was rounded up to */
+        arena_count = size / sizeof(*arena_base);
+#endif
+      }
+
+      arena_limit = arena_base + arena_count;
+      break;
+    }
+#endif
+  }
+
+  assert(arena_base != NULL);
+  assert(arena_base != arena_limit);
+
+  struct state *s = arena_base;
+  arena_base++;
+  return s;
+}
+
+static void state_free(struct state *s) {
+
+  if (s == NULL) {
+    return;
+  }
+
+  /* If the seen set does not hold on to states, states are freed in arbitrary
+   * order and possibly by a different thread to the one that allocated them.
+   * Otherwise, states are usually freed straight after allocation, but a batch
+   * of successors can contain a duplicate allocated before a state the seen
+   * set retains. So stash states that are not the most recently allocated for
+   * later reuse instead of returning them to the arena.
+   */
+  if (!SET_STORES_STATES || s + 1 != arena_base) {
+    if (recycled_count == recycled_capacity) {
+      size_t capacity = recycled_capacity == 0 ? 1024 : recycled_capacity * 2;
+      struct state **r = realloc(recycled, capacity * sizeof(recycled[0]));
+      if (__builtin_expect(r == NULL, 0)) {
+        oom();
+      }
+      recycled = r;
+      recycled_capacity = capacity;
+    }
+    recycled[recycled_count] = s;
+    recycled_count++;
+    return;
+  }
+
+  arena_base--;
+}
+
+/*******************************************************************************
+ * statistics for memory usage                                                 *
+ *                                                                             *
+ * This functionality is only used when `--trace memory_usage` is given on the *
+ * command line.                                                               *
+ ******************************************************************************/
+
+/* number of allocated state structs per depth of expansion */
+static size_t allocated[BOUND == 0 ? 1 : (BOUND + 1)];
+
+/* note a new allocation of a state struct at the given depth */
+static __attribute__((unused)) void register_allocation(size_t depth) {
+
+  /* if we are not tracing memory usage, make this a no-op */
+  if (!(TC_MEMORY_USAGE & TRACES_ENABLED)) {
+    return;
+  }
+
+  ASSERT(depth < sizeof(allocated) / sizeof(allocated[0]) &&
+         "out of range access to allocated array");
+
+  /* increment the number of known allocated states, avoiding an expensive
+   * atomic if we are single-threaded
+   */
+  if (THREADS == 1) {
+    allocated[depth]++;
+  } else {
+    (void)__sync_add_and_fetch(&allocated[depth], 1);
+  }
+}
+
+/* print a summary of the allocation results we have accrued */
+static void print_allocation_summary(void) {
+
+  /* it is assumed we are running single-threaded here and do not need atomic
+   * accesses
+   */
+
+  if (BOUND == 0) {
+    TRACE(TC_MEMORY_USAGE,
           "allocated %zu state structure(s), totaling %zu bytes",
           allocated[0], allocated[0] * sizeof(struct state));
   } else {
@@ -1538,10 +2407,74 @@ static struct state *state_dup(const struct state *NONNULL s) {
   return n;
 }
 
-static size_t state_hash(const struct state *NONNULL s) {
-  return (size_t)MurmurHash64A(s->data, sizeof(s->data));
+#if INCREMENTAL_HASH
+/* Whole 64-bit words in state data, and the bytes left over after them. */
+enum { STATE_SIZE_WORDS = STATE_SIZE_BYTES / sizeof(uint64_t) };
+enum { STATE_TAIL_BYTES = STATE_SIZE_BYTES % sizeof(uint64_t) };
+
+/* Read the given whole word of state data. */
+static uint64_t data_word(const uint8_t *NONNULL data, size_t index) {
+  uint64_t word;
+  memcpy(&word, data + index * sizeof(word), sizeof(word));
+  return word;
+}
+
+/* Read the bytes of state data after the last whole word, zero-padded. */
+static uint64_t data_tail(const uint8_t *NONNULL data) {
+  return hash_read(data + STATE_SIZE_WORDS * sizeof(uint64_t),
+                   STATE_TAIL_BYTES);
+}
+
+#endif
+
+/* Hash state data. */
+static uint64_t data_hash(const uint8_t *NONNULL data) {
+  return hash_kernel(data, 0);
+}
+
+static __attribute__((unused)) size_t
+state_hash(const struct state *NONNULL s) {
+  return (size_t)data_hash(s->data);
+}
+
+#if INCREMENTAL_HASH
+static uint64_t state_stored_hash(const struct state *NONNULL s) {
+  uint64_t h;
+  memcpy(&h, s->hash, sizeof(h));
+  return h;
+}
+
+static void state_store_hash(struct state *NONNULL s, uint64_t h) {
+  memcpy(s->hash, &h, sizeof(h));
 }
 
+/* Hash a state derived from `parent`, whose hash is already known. Rules
+ * typically change a few fields of a large state and symmetry reduction moves
+ * only some of them, so rather than mixing every word we compare the two
+ * states and adjust the parent's hash for the words that differ.
+ */
+static size_t state_hash_from(const struct state *NONNULL s,
+                              const struct state *NONNULL parent) {
+  uint64_t h = state_stored_hash(parent);
+  for (size_t i = 0; i < STATE_SIZE_WORDS; i++) {
+    uint64_t a = data_word(parent->data, i);
+    uint64_t b = data_word(s->data, i);
+    if (__builtin_expect(a != b, 0)) {
+      h += hash_word(b, i) - hash_word(a, i);
+    }
+  }
+  if (STATE_TAIL_BYTES > 0) {
+    uint64_t a = data_tail(parent->data);
+    uint64_t b = data_tail(s->data);
+    if (a != b) {
+      h += hash_word(b, STATE_SIZE_WORDS) - hash_word(a, STATE_SIZE_WORDS);
+    }
+  }
+  assert(h == data_hash(s->data) && "incorrect incremental hash");
+  return (size_t)h;
+}
+#endif
+
 #if COUNTEREXAMPLE_TRACE != CEX_OFF
 static __attribute__((unused)) size_t
 state_depth(const struct state *NONNULL s) {
@@ -1569,6 +2502,7 @@ state_drop_const(const struct state *s) {
 /* These functions are generated. */
 static void state_canonicalise_heuristic(struct state *NONNULL s);
 static void state_canonicalise_exhaustive(struct state *NONNULL s);
+static void state_canonicalise_refinement(struct state *NONNULL s);
 
 static void state_canonicalise(struct state *NONNULL s) {
 
@@ -1586,6 +2520,10 @@ static void state_canonicalise(struct state *NONNULL s) {
   case SYMMETRY_REDUCTION_EXHAUSTIVE:
     state_canonicalise_exhaustive(s);
     break;
+
+  case SYMMETRY_REDUCTION_REFINEMENT:
+    state_canonicalise_refinement(s);
+    break;
   }
 }
 
@@ -1698,6 +2636,21 @@ static value_t decode_value(value_t lb, value_t ub, raw_value_t v) {
   return dest;
 }
 
+/* Validate and decode a raw value that was read from a variable. */
+static value_t check_read(const char *NONNULL context, const char *rule_name,
+                          const char *NONNULL name,
+                          const struct state *NONNULL s, value_t lb,
+                          value_t ub, raw_value_t raw) {
+
+  if (__builtin_expect(raw == 0, 0)) {
+    error(s, "%sread of undefined value in %s%s%s", context, name,
+          rule_name == NULL ? "" : " within ",
+          rule_name == NULL ? "" : rule_name);
+  }
+
+  return decode_value(lb, ub, raw);
+}
+
 static __attribute__((unused)) value_t
 handle_read(const char *NONNULL context, const char *rule_name,
             const char *NONNULL name, const struct state *NONNULL s, value_t lb,
@@ -1713,15 +2666,8 @@ handle_read(const char *NONNULL context, const char *rule_name,
           || sizeof(s->data) * CHAR_BIT - h.width >= h.offset) /* in bounds */
          && "out of bounds read in handle_read()");
 
-  raw_value_t dest = handle_read_raw(s, h);
-
-  if (__builtin_expect(dest == 0, 0)) {
-    error(s, "%sread of undefined value in %s%s%s", context, name,
-          rule_name == NULL ? "" : " within ",
-          rule_name == NULL ? "" : rule_name);
-  }
-
-  return decode_value(lb, ub, dest);
+  return check_read(context, rule_name, name, s, lb, ub,
+                    handle_read_raw(s, h));
 }
 
 static void handle_write_raw(const struct state *NONNULL s, struct handle h,
@@ -1761,6 +2707,23 @@ static void handle_write_raw(const struct state *NONNULL s, struct handle h,
   write_raw(h, (uint64_t)value);
 }
 
+/* Validate and encode a value that is about to be written to a variable. */
+static raw_value_t check_write(const char *NONNULL context,
+                               const char *rule_name, const char *NONNULL name,
+                               const struct state *NONNULL s, value_t lb,
+                               value_t ub, value_t value) {
+
+  raw_value_t r;
+  if (__builtin_expect(
+          value < lb || value > ub || SUB(value, lb, &r) || ADD(r, 1, &r), 0)) {
+    error(s, "%swrite of out-of-range value into %s%s%s", context, name,
+          rule_name == NULL ? "" : " within ",
+          rule_name == NULL ? "" : rule_name);
+  }
+
+  return r;
+}
+
 static __attribute__((unused)) void
 handle_write(const char *NONNULL context, const char *rule_name,
              const char *NONNULL name, const struct state *NONNULL s,
@@ -1776,15 +2739,96 @@ handle_write(const char *NONNULL context, const char *rule_name,
           || sizeof(s->data) * CHAR_BIT - h.width >= h.offset) /* in bounds */
          && "out of bounds write in handle_write()");
 
-  raw_value_t r;
-  if (__builtin_expect(
-          value < lb || value > ub || SUB(value, lb, &r) || ADD(r, 1, &r), 0)) {
-    error(s, "%swrite of out-of-range value into %s%s%s", context, name,
-          rule_name == NULL ? "" : " within ",
-          rule_name == NULL ? "" : rule_name);
+  handle_write_raw(s, h,
+                   check_write(context, rule_name, name, s, lb, ub, value));
+}
+
+/* Read the raw value of `width` bits at bit `offset` in the state data. This is
+ * an alternative to handle_read_raw for variables whose location is known when
+ * the verifier is generated. Called with constant arguments, all the offset
+ * and width logic folds away, leaving a single load, shift and mask.
+ */
+static __attribute__((always_inline, unused)) inline raw_value_t
+read_const(const struct state *NONNULL s, size_t offset, size_t width) {
+
+  if (__builtin_expect(width > sizeof(raw_value_t) * 8, 0)) {
+    error(s, "read of a handle that is wider than the value type");
+  }
+
+  ASSERT(width <= MAX_SIMPLE_WIDTH &&
+         "read of a handle that is larger than "
+         "the maximum width of a simple type in this model");
+  ASSERT(sizeof(s->data) * CHAR_BIT - width >= offset &&
+         "out of bounds read in read_const()");
+
+  const uint8_t *p = s->data + offset / CHAR_BIT;
+  size_t shift = offset % CHAR_BIT;
+  size_t extent = BITS_TO_BYTES(shift + width);
+
+  uint64_t v;
+  if (extent <= sizeof(uint64_t)) {
+    /* read a whole word if it is within the state, to avoid an odd-sized load
+     */
+    if (offset / CHAR_BIT + sizeof(uint64_t) <= sizeof(s->data)) {
+      extent = sizeof(uint64_t);
+    }
+    v = copy_out64(p, extent) >> shift;
+  } else {
+    v = copy_out64(p, sizeof(uint64_t)) >> shift;
+    v |= (uint64_t)p[sizeof(uint64_t)] << (64 - shift);
   }
+  if (width < 64) {
+    v &= (UINT64_C(1) << width) - 1;
+  }
+
+  TRACE(TC_HANDLE_READS,
+        "read value %" PRIRAWVAL " from handle { %p, %zu, %zu }",
+        raw_value_to_string(v), p, shift, width);
+
+  return (raw_value_t)v;
+}
+
+/* Write counterpart of read_const. */
+static __attribute__((always_inline, unused)) inline void
+write_const(const struct state *NONNULL s, size_t offset, size_t width,
+            raw_value_t value) {
+
+  if (__builtin_expect(width > sizeof(raw_value_t) * 8, 0)) {
+    error(s, "write of a handle that is wider than the value type");
+  }
+
+  ASSERT(width <= MAX_SIMPLE_WIDTH &&
+         "write to a handle that is larger than "
+         "the maximum width of a simple type in this model");
+  ASSERT(sizeof(s->data) * CHAR_BIT - width >= offset &&
+         "out of bounds write in write_const()");
+
+  uint8_t *p = (uint8_t *)s->data + offset / CHAR_BIT;
+  size_t shift = offset % CHAR_BIT;
+  size_t extent = BITS_TO_BYTES(shift + width);
+
+  TRACE(TC_HANDLE_WRITES,
+        "writing value %" PRIRAWVAL " to handle { %p, %zu, %zu }",
+        raw_value_to_string(value), p, shift, width);
 
-  handle_write_raw(s, h, r);
+  uint64_t mask = width < 64 ? (UINT64_C(1) << width) - 1 : UINT64_MAX;
+  uint64_t v = (uint64_t)value & mask;
+
+  if (extent <= sizeof(uint64_t)) {
+    if (offset / CHAR_BIT + sizeof(uint64_t) <= sizeof(s->data)) {
+      extent = sizeof(uint64_t);
+    }
+    uint64_t word = copy_out64(p, extent);
+    word = (word & ~(mask << shift)) | (v << shift);
+    copy_in64(p, word, extent);
+  } else {
+    uint64_t word = copy_out64(p, sizeof(uint64_t));
+    word = (word & ~(mask << shift)) | (v << shift);
+    copy_in64(p, word, sizeof(uint64_t));
+    uint8_t high_mask = (uint8_t)(mask >> (64 - shift));
+    p[sizeof(uint64_t)] = (uint8_t)((p[sizeof(uint64_t)] & ~high_mask) |
+                                    (v >> (64 - shift)));
+  }
 }
 
 static __attribute__((unused)) void handle_zero(struct handle h) {
@@ -1817,27 +2861,103 @@ static __attribute__((unused)) void handle_zero(struct handle h) {
   }
 }
 
-static void handle_copy(struct handle a, struct handle b) {
+/* Move a handle's base forward so its offset is within the first byte. */
+static struct handle handle_normalise(struct handle h) {
+  return (struct handle){
+      .base = h.base + h.offset / CHAR_BIT,
+      .offset = h.offset % CHAR_BIT,
+      .width = h.width,
+  };
+}
 
-  ASSERT(a.width == b.width && "copying between handles of different sizes");
+/* Drop the first `width` bits from a handle. */
+static struct handle handle_advance(struct handle h, size_t width) {
+  ASSERT(width <= h.width && "advancing a handle beyond its end");
+  return handle_normalise((struct handle){
+      .base = h.base,
+      .offset = h.offset + width,
+      .width = h.width - width,
+  });
+}
 
-  /* FIXME: This does a bit-by-bit copy which almost certainly could be
-   * accelerated by detecting byte-boundaries and complementary alignment and
-   * then calling memcpy when possible.
-   */
+/* Read up to 8 bits starting `offset` bits into the given bytes, where offset <
+ * 8.
+ */
+static uint8_t read_bits8(const uint8_t *NONNULL p, size_t offset,
+                          size_t width) {
+  ASSERT(offset < CHAR_BIT && width <= CHAR_BIT);
+  unsigned v = (unsigned)p[0] >> offset;
+  if (offset + width > CHAR_BIT) {
+    v |= (unsigned)p[1] << (CHAR_BIT - offset);
+  }
+  return (uint8_t)(v & ((1u << width) - 1));
+}
+
+/* Write up to 8 bits into a single byte, starting `offset` bits into it. */
+static void write_bits8(uint8_t *NONNULL p, size_t offset, size_t width,
+                        uint8_t v) {
+  ASSERT(offset + width <= CHAR_BIT);
+  unsigned mask = ((1u << width) - 1) << offset;
+  *p = (uint8_t)((*p & ~mask) | (((unsigned)v << offset) & mask));
+}
+
+/* Read a 64-bit word starting `offset` bits into the given bytes, where 0 <
+ * offset < 8. That is, a funnel shift of the 9 bytes at `p`.
+ */
+static uint64_t read_shifted64(const uint8_t *NONNULL p, size_t offset) {
+  ASSERT(offset > 0 && offset < CHAR_BIT);
+  uint64_t low = copy_out64(p, sizeof(uint64_t));
+  uint64_t high = p[sizeof(uint64_t)];
+  return (low >> offset) | (high << (64 - offset));
+}
+
+/* If you are in the Rumur repository modifying handle_copy or handle_eq, they
+ * can be checked and timed with ../../misc/handle-benchmark.py.
+ */
+static void handle_copy(struct handle a, struct handle b) {
 
-  for (size_t i = 0; i < a.width; i++) {
+  ASSERT(a.width == b.width && "copying between handles of different sizes");
 
-    uint8_t *dst = a.base + (a.offset + i) / 8;
-    size_t dst_off = (a.offset + i) % 8;
+  a = handle_normalise(a);
+  b = handle_normalise(b);
 
-    const uint8_t *src = b.base + (b.offset + i) / 8;
-    size_t src_off = (b.offset + i) % 8;
+  /* Copy up to the next byte boundary of the destination. */
+  if (a.offset != 0) {
+    size_t head = CHAR_BIT - a.offset;
+    if (head > a.width) {
+      head = a.width;
+    }
+    write_bits8(a.base, a.offset, head, read_bits8(b.base, b.offset, head));
+    a = handle_advance(a, head);
+    b = handle_advance(b, head);
+  }
 
-    uint8_t or_mask = ((*src >> src_off) & UINT8_C(1)) << dst_off;
-    uint8_t and_mask = ~(UINT8_C(1) << dst_off);
+  /* The destination is now byte-aligned. If the source is too, the bulk of the
+   * copy is a plain byte copy. Otherwise, assemble each destination word from
+   * two source words. Handles never partially overlap, but may be identical,
+   * so we use memmove.
+   */
+  if (b.offset == 0) {
+    size_t bytes = a.width / CHAR_BIT;
+    if (bytes > 0) {
+      memmove(a.base, b.base, bytes);
+      a = handle_advance(a, bytes * CHAR_BIT);
+      b = handle_advance(b, bytes * CHAR_BIT);
+    }
+  } else {
+    while (a.width >= 64) {
+      copy_in64(a.base, read_shifted64(b.base, b.offset), sizeof(uint64_t));
+      a = handle_advance(a, 64);
+      b = handle_advance(b, 64);
+    }
+  }
 
-    *dst = (*dst & and_mask) | or_mask;
+  /* Copy what is left a byte at a time. */
+  while (a.width > 0) {
+    size_t width = a.width < CHAR_BIT ? a.width : CHAR_BIT;
+    write_bits8(a.base, 0, width, read_bits8(b.base, b.offset, width));
+    a = handle_advance(a, width);
+    b = handle_advance(b, width);
   }
 }
 
@@ -1846,23 +2966,54 @@ static __attribute__((unused)) bool handle_eq(struct handle a,
 
   ASSERT(a.width == b.width && "comparing handles of different sizes");
 
-  /* FIXME: as with handle_copy, we do a bit-by-bit comparison which could be
-   * made more efficient.
-   */
-
-  for (size_t i = 0; i < a.width; i++) {
+  a = handle_normalise(a);
+  b = handle_normalise(b);
 
-    uint8_t *x = a.base + (a.offset + i) / 8;
-    size_t x_off = (a.offset + i) % 8;
-    bool x_bit = (*x >> x_off) & 0x1;
+  /* Compare up to the next byte boundary of the first handle. */
+  if (a.offset != 0) {
+    size_t head = CHAR_BIT - a.offset;
+    if (head > a.width) {
+      head = a.width;
+    }
+    if (read_bits8(a.base, a.offset, head) !=
+        read_bits8(b.base, b.offset, head)) {
+      return false;
+    }
+    a = handle_advance(a, head);
+    b = handle_advance(b, head);
+  }
 
-    const uint8_t *y = b.base + (b.offset + i) / 8;
-    size_t y_off = (b.offset + i) % 8;
-    bool y_bit = (*y >> y_off) & 0x1;
+  /* As in handle_copy, compare bytes directly if both handles are now
+   * byte-aligned, or a word at a time otherwise.
+   */
+  if (b.offset == 0) {
+    size_t bytes = a.width / CHAR_BIT;
+    if (bytes > 0) {
+      if (memcmp(a.base, b.base, bytes) != 0) {
+        return false;
+      }
+      a = handle_advance(a, bytes * CHAR_BIT);
+      b = handle_advance(b, bytes * CHAR_BIT);
+    }
+  } else {
+    while (a.width >= 64) {
+      if (copy_out64(a.base, sizeof(uint64_t)) !=
+          read_shifted64(b.base, b.offset)) {
+        return false;
+      }
+      a = handle_advance(a, 64);
+      b = handle_advance(b, 64);
+    }
+  }
 
-    if (x_bit != y_bit) {
+  /* Compare what is left a byte at a time. */
+  while (a.width > 0) {
+    size_t width = a.width < CHAR_BIT ? a.width : CHAR_BIT;
+    if (read_bits8(a.base, 0, width) != read_bits8(b.base, b.offset, width)) {
       return false;
     }
+    a = handle_advance(a, width);
+    b = handle_advance(b, width);
   }
 
   return true;
@@ -2117,959 +3268,381 @@ static __attribute__((unused)) value_t bnot(value_t v) {
   return (value_t)~(raw_value_t)v;
 }
 
-/* use Heap's algorithm for generating permutations to implement a
- * permutation-to-number mapping
+/* Map a permutation to its index in lexicographic order, by reading its Lehmer
+ * code as a number in the factorial number system. This is quadratic in the
+ * number of elements, where enumerating permutations up to the given one
+ * would be factorial.
  */
 static __attribute__((unused)) size_t
-permutation_to_index(const size_t *NONNULL permutation, size_t *NONNULL stack,
-                     size_t *NONNULL working, size_t count) {
-
-  /* byte extent of the permutation arrays */
-  size_t bytes = sizeof(permutation[0]) * count;
+permutation_to_index(const size_t *NONNULL permutation,
+                     size_t *NONNULL stack __attribute__((unused)),
+                     size_t *NONNULL working __attribute__((unused)),
+                     size_t count) {
 
   size_t index = 0;
 
-  /* clear our stack */
-  memset(stack, 0, bytes);
-
-  /* initialise the first (identity) permutation */
   for (size_t i = 0; i < count; ++i) {
-    working[i] = i;
-  }
-
-  if (memcmp(permutation, working, bytes) == 0) {
-    return index;
-  }
-
-  size_t i = 0;
-  while (i < count) {
-    if (stack[i] < i) {
-      ++index;
-      if (i % 2 == 0) {
-        /* swap working[0] and working[i] */
-        size_t tmp = working[0];
-        working[0] = working[i];
-        working[i] = tmp;
-      } else {
-        /* swap working[stack[i]] and working[i] */
-        size_t tmp = working[stack[i]];
-        working[stack[i]] = working[i];
-        working[i] = tmp;
+    /* how many of the remaining elements are less than this one? */
+    size_t smaller = 0;
+    for (size_t j = i + 1; j < count; ++j) {
+      if (permutation[j] < permutation[i]) {
+        ++smaller;
       }
-      if (memcmp(permutation, working, bytes) == 0) {
-        return index;
-      }
-      ++stack[i];
-      i = 0;
-    } else {
-      stack[i] = 0;
-      ++i;
     }
+    index = index * (count - i) + smaller;
   }
 
-  /* the permutation should have been one of the possible ones */
-  ASSERT(!"invalid permutation passed to permutation_to_index");
+  return index;
 }
+
+/* Inverse of permutation_to_index(). */
 static __attribute__((unused)) void
 index_to_permutation(size_t index, size_t *NONNULL permutation,
                      size_t *NONNULL stack, size_t count) {
 
-  /* byte extent of the permutation arrays */
-  size_t bytes = sizeof(permutation[0]) * count;
-
-  size_t ind = 0;
+  /* decode the digits of the index, the last having base 1 */
+  for (size_t i = count; i > 0; --i) {
+    size_t base = count - i + 1;
+    permutation[i - 1] = index % base;
+    index /= base;
+  }
 
-  /* clear our stack */
-  memset(stack, 0, bytes);
+  /* the target permutation should have been one of the possible ones */
+  ASSERT(index == 0 && "invalid index passed to index_to_permutation");
 
-  /* initialise the first (identity) permutation */
+  /* each digit selects one of the elements not yet used */
   for (size_t i = 0; i < count; ++i) {
-    permutation[i] = i;
+    stack[i] = i;
   }
-
-  if (ind == index) {
-    return;
-  }
-
-  size_t i = 0;
-  while (i < count) {
-    if (stack[i] < i) {
-      ++ind;
-      if (i % 2 == 0) {
-        /* swap permutation[0] and permutation[i] */
-        size_t tmp = permutation[0];
-        permutation[0] = permutation[i];
-        permutation[i] = tmp;
-      } else {
-        /* swap permutation[stack[i]] and permutation[i] */
-        size_t tmp = permutation[stack[i]];
-        permutation[stack[i]] = permutation[i];
-        permutation[i] = tmp;
-      }
-      if (ind == index) {
-        return;
-      }
-      ++stack[i];
-      i = 0;
-    } else {
-      stack[i] = 0;
-      ++i;
-    }
+  for (size_t i = 0; i < count; ++i) {
+    size_t digit = permutation[i];
+    permutation[i] = stack[digit];
+    memmove(&stack[digit], &stack[digit + 1],
+            sizeof(stack[0]) * (count - i - digit - 1));
   }
-
-  /* the target permutation should have been one of the possible ones */
-  ASSERT(!"invalid index passed to index_to_permutation");
 }
 
+#if !EXTERNAL_MEMORY
 /*******************************************************************************
- * State queue node                                                            *
+ * State queue                                                                 *
+ *                                                                             *
+ * The following implements a per-thread queue for pending states. The only    *
+ * supported operations are enqueueing and dequeueing states. A property we    *
+ * maintain is that all states within all queues pass the current model's      *
+ * invariants.                                                                 *
  *                                                                             *
- * Queue nodes are 4K-sized, 4K-aligned linked-list nodes. They contain        *
- * pending states and then a pointer to the next node in the queue.            *
+ * Each queue is a growable circular array. Only a queue's owning thread       *
+ * enqueues to it, at the bottom, which needs no atomic read-modify-write      *
+ * operations. Unlike a Chase-Lev deque, the owner does not pop from the       *
+ * bottom, as that would make exploration depth-first, and break --bound and   *
+ * the shortness of counterexample traces. Instead, states are always          *
+ * dequeued from the top, both by the owner and by other threads stealing      *
+ * from it, by claiming them with a single-word CAS. To amortise this, the     *
+ * owner claims a chunk of states at a time into a buffer of its own, from     *
+ * which it then dequeues them without synchronisation. A thread whose own     *
+ * queue is empty steals a batch of states from another thread's queue.        *
+ *                                                                             *
+ * Arrays a queue has outgrown may still be read by thieves, so are only freed *
+ * while no other threads are using the queues (see 'queue_settle'), which is  *
+ * also when claimed states are returned to their queues so that checkpoints   *
+ * and state caching see every pending state.                                  *
  ******************************************************************************/
 
-struct queue_node {
-  struct state
-      *s[(4096 - sizeof(struct queue_node *)) / sizeof(struct state *)];
-  struct queue_node *next;
+/* Circular array of queued states. */
+struct queue_array {
+  size_t size;                  /* capacity, always a power of 2 */
+  struct queue_array *previous; /* array this one replaced */
+  struct state *s[];
 };
 
-_Static_assert(sizeof(struct queue_node) == 4096,
-               "incorrect queue_node size calculation");
+static struct {
+  size_t top;    /* index of the next state to dequeue */
+  size_t bottom; /* index one past the last enqueued state */
+  struct queue_array *array;
+} __attribute__((aligned(64))) q[THREADS];
 
-static struct queue_node *queue_node_new(void) {
-  struct queue_node *p = NULL;
+/* Initial capacity of each queue's array. */
+enum { QUEUE_INITIAL_SIZE = 1024 };
 
-  int r = posix_memalign((void **)&p, sizeof(*p), sizeof(*p));
+/* Maximum number of states to steal from another thread's queue at once. */
+enum { QUEUE_STEAL_BATCH = 64 };
 
-  assert((r == 0 || r == ENOMEM) && "invalid alignment to posix_memalign");
+/* Maximum number of states the owner of a queue claims from it at once. */
+enum { QUEUE_CLAIM_BATCH = 16 };
 
-  if (__builtin_expect(r != 0, 0)) {
-    oom();
-  }
+/* States each thread has claimed from the top of its own queue and not yet
+ * dequeued, in queue order. Only the owning thread uses these, other than in
+ * 'queue_settle'.
+ */
+static struct {
+  size_t next;  /* index of the next state to dequeue */
+  size_t count; /* number of states claimed */
+  struct state *s[QUEUE_CLAIM_BATCH];
+} __attribute__((aligned(64))) queue_claimed[THREADS];
 
-  memset(p, 0, sizeof(*p));
+static struct queue_array *queue_array_new(size_t size) {
+  assert(size > 0 && (size & (size - 1)) == 0 &&
+         "queue array size is not a power of 2");
 
-  return p;
+  struct queue_array *a = xmalloc(sizeof(*a) + size * sizeof(a->s[0]));
+  a->size = size;
+  a->previous = NULL;
+  return a;
 }
 
-static void queue_node_free(struct queue_node *p) { free(p); }
-
-/******************************************************************************/
-
-/*******************************************************************************
- * Queue node handles                                                          *
- *                                                                             *
- * These are pointers to a member-aligned address within a queue_node. The     *
- * idea is that you can have a queue_handle_t pointing at either one of the    *
- * elements of the `s` member or at the chained `next` pointer. Since          *
- * queue_node pointers are always 4K-aligned, you can examine the low 12 bits  *
- * of the queue node handle to determine which member you are pointing at.     *
- ******************************************************************************/
-
-typedef uintptr_t queue_handle_t;
+/* Add a batch of states to a queue, returning the resulting queue length. The
+ * states become visible to other threads together.
+ */
+static size_t queue_enqueue_batch(struct state *NONNULL *NONNULL s,
+                                  size_t count, size_t queue_id) {
+  assert(queue_id < sizeof(q) / sizeof(q[0]) && "out of bounds queue access");
 
-static queue_handle_t queue_handle_from_node_ptr(const struct queue_node *n) {
-  return (queue_handle_t)n;
-}
+  /* Only we write the bottom and array of this queue, so can read them without
+   * synchronisation.
+   */
+  size_t bottom = q[queue_id].bottom;
+  size_t top = __atomic_load_n(&q[queue_id].top, __ATOMIC_ACQUIRE);
+  struct queue_array *a = q[queue_id].array;
+
+  if (a == NULL || bottom - top + count > a->size) {
+    /* The array is full. Move to one at least twice the size. Other threads
+     * may still be reading from the current array, so it is retained until
+     * 'queue_settle' rather than freed.
+     */
+    size_t size = a == NULL ? QUEUE_INITIAL_SIZE : a->size * 2;
+    while (bottom - top + count > size) {
+      size *= 2;
+    }
+    struct queue_array *n = queue_array_new(size);
+    for (size_t i = top; i < bottom; i++) {
+      n->s[i & (n->size - 1)] =
+          __atomic_load_n(&a->s[i & (a->size - 1)], __ATOMIC_RELAXED);
+    }
+    n->previous = a;
+    __atomic_store_n(&q[queue_id].array, n, __ATOMIC_RELEASE);
+    a = n;
+  }
 
-static struct queue_node *queue_handle_base(queue_handle_t h) {
-  return (struct queue_node *)(h - h % sizeof(struct queue_node));
-}
+  for (size_t i = 0; i < count; i++) {
+    __atomic_store_n(&a->s[(bottom + i) & (a->size - 1)], s[i],
+                     __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&q[queue_id].bottom, bottom + count, __ATOMIC_RELEASE);
 
-static bool queue_handle_is_state_pptr(queue_handle_t h) {
-  return h % sizeof(struct queue_node) <
-         __builtin_offsetof(struct queue_node, next);
-}
+  size_t length = bottom + count - top;
 
-static struct state **queue_handle_to_state_pptr(queue_handle_t h) {
-  assert(queue_handle_is_state_pptr(h) &&
-         "invalid use of queue_handle_to_state_pptr");
+  TRACE(TC_QUEUE,
+        "enqueued %zu state(s) into queue %zu, queue length is now %zu", count,
+        queue_id, length);
 
-  return (struct state **)h;
+  return length;
 }
 
-static struct queue_node **queue_handle_to_node_pptr(queue_handle_t h) {
-  assert(!queue_handle_is_state_pptr(h) &&
-         "invalid use of queue_handle_to_node_pptr");
-
-  return (struct queue_node **)h;
+static size_t queue_enqueue(struct state *NONNULL s, size_t queue_id) {
+  return queue_enqueue_batch(&s, 1, queue_id);
 }
 
-static queue_handle_t queue_handle_next(queue_handle_t h) {
-  return h + sizeof(struct state *);
+#if MEMORY_LIMIT > 0
+/* Total number of states in all queues. This reads the queues without
+ * synchronisation and does not see states claimed by their owners, so is only
+ * approximate while other threads are running.
+ */
+static size_t queue_length(void) {
+  size_t length = 0;
+  for (size_t i = 0; i < sizeof(q) / sizeof(q[0]); i++) {
+    size_t top = __atomic_load_n(&q[i].top, __ATOMIC_RELAXED);
+    size_t bottom = __atomic_load_n(&q[i].bottom, __ATOMIC_RELAXED);
+    length += bottom > top ? bottom - top : 0;
+  }
+  return length;
 }
+#endif
 
-/******************************************************************************/
-
-/*******************************************************************************
- * Hazard pointers                                                             *
- *                                                                             *
- * The idea of "hazard pointers" comes from Maged Michael, "Hazard Pointers:   *
- * Safe Memory Reclamation for Lock-Free Objects" in TPDS 15(8) 2004. The      *
- * basic concept is to maintain a collection of safe-to-dereference pointers.  *
- * Before freeing a pointer, you look in this collection to see if it is in    *
- * use and you must always add a pointer to this collection before             *
- * dereferencing it. The finer details of how we keep this consistent and why  *
- * the size of this collection can be statically known ahead of time are a     *
- * little complicated, but the paper explains this in further detail.          *
- ******************************************************************************/
+/* Remove up to `limit` states from the top of a queue, returning the number
+ * taken.
+ */
+static size_t queue_take(size_t queue_id, struct state **NONNULL s,
+                         size_t limit) {
+  assert(limit > 0);
 
-/* Queue node pointers currently safe to dereference. */
-static const struct queue_node *hazarded[THREADS];
+  for (;;) {
+    size_t top = __atomic_load_n(&q[queue_id].top, __ATOMIC_ACQUIRE);
+    size_t bottom = __atomic_load_n(&q[queue_id].bottom, __ATOMIC_ACQUIRE);
 
-/* Protect a pointer that we wish to dereference. */
-static void hazard(queue_handle_t h) {
+    if (top >= bottom) {
+      /* empty */
+      return 0;
+    }
 
-  /* Find the queue node this handle lies within. */
-  const struct queue_node *p = queue_handle_base(h);
+    /* Take no more than half of what is available, rounding up. */
+    size_t count = (bottom - top + 1) / 2;
+    if (count > limit) {
+      count = limit;
+    }
 
-  /* You can't protect the null pointer because it is invalid to dereference it.
-   */
-  assert(p != NULL && "attempt to hazard an invalid pointer");
+    /* Read the states before trying to claim them. If our claim below
+     * succeeds, the owner cannot have overwritten these in the meantime, as
+     * they had not yet been dequeued. The owner only reuses their slots after
+     * an acquire load of `top` observes our claim, so releasing it orders
+     * these reads before any such write.
+     */
+    struct queue_array *a =
+        __atomic_load_n(&q[queue_id].array, __ATOMIC_ACQUIRE);
+    for (size_t i = 0; i < count; i++) {
+      s[i] =
+          __atomic_load_n(&a->s[(top + i) & (a->size - 1)], __ATOMIC_RELAXED);
+    }
 
-  /* Each thread is only allowed a single hazarded pointer at a time. */
-  assert(__atomic_load_n(&hazarded[thread_id], __ATOMIC_SEQ_CST) == NULL &&
-         "hazarding multiple pointers at once");
+    if (__atomic_compare_exchange_n(&q[queue_id].top, &top, top + count, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+      return count;
+    }
 
-  __atomic_store_n(&hazarded[thread_id], p, __ATOMIC_SEQ_CST);
+    /* Someone else dequeued from this queue at the same time. Retry. */
+  }
 }
 
-/* Drop protection on a pointer whose target we are done accessing. */
-static void unhazard(queue_handle_t h) {
+static const struct state *queue_dequeue(size_t *NONNULL queue_id) {
+  assert(queue_id != NULL && *queue_id < sizeof(q) / sizeof(q[0]) &&
+         "out of bounds queue access");
 
-  /* Find the queue node this handle lies within. */
-  const struct queue_node *p __attribute__((unused)) = queue_handle_base(h);
+  /* First try our own queue, claiming more states from it if we have used up
+   * those we claimed before.
+   */
+  if (queue_claimed[thread_id].next == queue_claimed[thread_id].count) {
+    queue_claimed[thread_id].next = 0;
+    queue_claimed[thread_id].count =
+        queue_take(thread_id, queue_claimed[thread_id].s, QUEUE_CLAIM_BATCH);
+  }
+  if (queue_claimed[thread_id].next < queue_claimed[thread_id].count) {
+    struct state *s =
+        queue_claimed[thread_id].s[queue_claimed[thread_id].next];
+    queue_claimed[thread_id].next++;
+    *queue_id = thread_id;
+    TRACE(TC_QUEUE, "dequeued state %p from queue %zu", s, *queue_id);
+    return s;
+  }
 
-  assert(p != NULL && "attempt to unhazard an invalid pointer");
+  /* Otherwise, try to steal from the other queues, starting with the last one
+   * we took from.
+   */
+  for (size_t attempts = 0; attempts < sizeof(q) / sizeof(q[0]); attempts++) {
 
-  assert(__atomic_load_n(&hazarded[thread_id], __ATOMIC_SEQ_CST) != NULL &&
-         "unhazarding a pointer when none are hazarded");
+    if (*queue_id != thread_id) {
+      struct state *batch[QUEUE_STEAL_BATCH];
+      size_t count = queue_take(*queue_id, batch, QUEUE_STEAL_BATCH);
+      if (count > 0) {
+        /* Keep the first state to return and move the rest into our queue. */
+        if (count > 1) {
+          (void)queue_enqueue_batch(&batch[1], count - 1, thread_id);
+        }
+        TRACE(TC_QUEUE, "stole %zu states from queue %zu", count, *queue_id);
+        return batch[0];
+      }
+    }
 
-  assert(__atomic_load_n(&hazarded[thread_id], __ATOMIC_SEQ_CST) == p &&
-         "unhazarding a pointer that differs from the one hazarded");
+    /* Move to the next queue to try. */
+    *queue_id = (*queue_id + 1) % (sizeof(q) / sizeof(q[0]));
+  }
 
-  __atomic_store_n(&hazarded[thread_id], NULL, __ATOMIC_SEQ_CST);
+  return NULL;
 }
 
-/* Free a pointer or, if not possible, defer this to later. */
-static void reclaim(queue_handle_t h) {
-
-  /* Find the queue node this handle lies within. */
-  struct queue_node *p = queue_handle_base(h);
-
-  assert(p != NULL && "reclaiming a null pointer");
-
-  /* The reclaimer is not allowed to be freeing something while also holding a
-   * hazarded pointer.
-   */
-  assert(__atomic_load_n(&hazarded[thread_id], __ATOMIC_SEQ_CST) == NULL &&
-         "reclaiming a pointer while holding a hazarded pointer");
-
-  /* Pointers that we failed to free initially because they were in use
-   * (hazarded) at the time they were passed to reclaim().
-   *
-   * Why are we sure we will only ever have a maximum of `THREADS - 1` pointers
-   * outstanding? Anything passed to reclaim() is expected to be
-   * now-unreachable, so the only outstanding references to such are threads
-   * racing with us. Because each thread can only have one hazarded pointer at a
-   * time, the maximum number of in use pointers right now is `THREADS - 1`
-   * (because the current thread does not have one).
-   *
-   * There is an edge case where another thread (1) held a hazarded pointer we
-   * previously tried to reclaim and thus ended up on our deferred list, then
-   * (2) in-between that time and now dropped this reference and acquired a
-   * hazarded pointer to `p`. This still will not exceed our count of
-   * `THREADS - 1` as the order in which we scan the deferred list and then add
-   * `p` to it below ensures that we will discover the originally hazarded
-   * pointer (now no longer conflicted) and clear its slot, leaving this
-   * available for `p`.
-   */
-  static _Thread_local struct queue_node *deferred[THREADS - 1];
-  static const size_t DEFERRED_SIZE = sizeof(deferred) / sizeof(deferred[0]);
-
-  /* First try to free any previously deferred pointers. */
-  for (size_t i = 0; i < DEFERRED_SIZE; i++) {
-    if (deferred[i] != NULL) {
-      bool conflict = false;
-      for (size_t j = 0; j < sizeof(hazarded) / sizeof(hazarded[0]); j++) {
-        if (j == thread_id) {
-          /* No need to check for conflicts with ourself. */
-          assert(__atomic_load_n(&hazarded[j], __ATOMIC_SEQ_CST) == NULL);
-          continue;
+/* Return states claimed but not yet dequeued to the top of their queues, in
+ * their original order, and deallocate arrays that queues have outgrown. Only
+ * safe to call when no other threads are using the queues.
+ */
+static void queue_settle(void) {
+  for (size_t i = 0; i < sizeof(q) / sizeof(q[0]); i++) {
+
+    size_t claimed = queue_claimed[i].count - queue_claimed[i].next;
+    if (claimed > 0) {
+      /* Make room for the claimed states in front of those still queued. */
+      size_t top = q[i].top;
+      size_t bottom = q[i].bottom;
+      struct queue_array *a = q[i].array;
+      if (bottom - top + claimed > a->size) {
+        size_t size = a->size * 2;
+        while (bottom - top + claimed > size) {
+          size *= 2;
         }
-        if (deferred[i] == __atomic_load_n(&hazarded[j], __ATOMIC_SEQ_CST)) {
-          /* This pointer is in use by thread j. */
-          conflict = true;
-          break;
+        struct queue_array *n = queue_array_new(size);
+        for (size_t j = top; j < bottom; j++) {
+          n->s[j & (n->size - 1)] = a->s[j & (a->size - 1)];
         }
+        n->previous = a;
+        q[i].array = a = n;
       }
-      if (!conflict) {
-        queue_node_free(deferred[i]);
-        deferred[i] = NULL;
+
+      for (size_t j = queue_claimed[i].count; j > queue_claimed[i].next; j--) {
+        top--;
+        a->s[top & (a->size - 1)] = queue_claimed[i].s[j - 1];
       }
-    }
-  }
+      q[i].top = top;
+      queue_claimed[i].next = queue_claimed[i].count = 0;
 
-  /* Now deal with the pointer we were passed. The most likely case is that no
-   * one else is using this pointer, so try this first.
-   */
-  bool conflict = false;
-  for (size_t i = 0; i < sizeof(hazarded) / sizeof(hazarded[i]); i++) {
-    if (i == thread_id) {
-      /* No need to check for conflicts with ourself. */
-      assert(__atomic_load_n(&hazarded[i], __ATOMIC_SEQ_CST) == NULL);
-      continue;
+      TRACE(TC_QUEUE, "returned %zu claimed state(s) to queue %zu", claimed,
+            i);
     }
-    if (p == __atomic_load_n(&hazarded[i], __ATOMIC_SEQ_CST)) {
-      /* Bad luck :( */
-      conflict = true;
-      break;
-    }
-  }
-
-  if (!conflict) {
-    /* We're done! */
-    queue_node_free(p);
-    return;
-  }
 
-  /* If we reached here, we need to defer this reclamation to later. */
-  for (size_t i = 0; i < DEFERRED_SIZE; i++) {
-    if (deferred[i] == NULL) {
-      deferred[i] = p;
-      return;
+    if (q[i].array != NULL) {
+      struct queue_array *a = q[i].array->previous;
+      q[i].array->previous = NULL;
+      while (a != NULL) {
+        struct queue_array *previous = a->previous;
+        free(a);
+        a = previous;
+      }
     }
   }
-
-  ASSERT(!"deferred more than `THREADS` reclamations");
 }
+#endif
 
 /******************************************************************************/
 
 /*******************************************************************************
- * Atomic operations on double word values                                     *
+ * Thread rendezvous support                                                   *
  ******************************************************************************/
 
-#if __SIZEOF_POINTER__ <= 4
-typedef uint64_t dword_t;
-#elif __SIZEOF_POINTER__ <= 8
-typedef unsigned __int128 dword_t;
-#else
-#error "unexpected pointer size; what scalar type to use for dword_t?"
-#endif
-
-static dword_t atomic_read(dword_t *p) {
+static pthread_mutex_t rendezvous_lock; /* mutual exclusion mechanism for below. */
+static pthread_cond_t rendezvous_cond;  /* sleep mechanism for below. */
+static size_t running_count = 1;        /* how many threads are opted in to rendezvous? */
+static size_t rendezvous_pending = 1;   /* how many threads are opted in and not sleeping? */
 
-  if (THREADS == 1) {
-    return *p;
+static void rendezvous_init(void) {
+  int r = pthread_mutex_init(&rendezvous_lock, NULL);
+  if (__builtin_expect(r != 0, 0)) {
+    fprintf(stderr, "pthread_mutex_init failed: %s\n", strerror(r));
+    exit(EXIT_FAILURE);
   }
 
-#if defined(__x86_64__) || defined(__i386__)
-  /* x86-64: MOV is not guaranteed to be atomic on 128-bit naturally aligned
-   *   memory. The way to work around this is apparently the following
-   *   degenerate CMPXCHG16B.
-   * i386: __atomic_load_n emits code calling a libatomic function that takes a
-   *   lock, making this no longer lock free. Force a CMPXCHG8B by using the
-   *   __sync built-in instead.
-   */
-  return __sync_val_compare_and_swap(p, 0, 0);
-#endif
-
-  return __atomic_load_n(p, __ATOMIC_SEQ_CST);
-}
-
-static void atomic_write(dword_t *p, dword_t v) {
-
-  if (THREADS == 1) {
-    *p = v;
-    return;
+  r = pthread_cond_init(&rendezvous_cond, NULL);
+  if (__builtin_expect(r != 0, 0)) {
+    fprintf(stderr, "pthread_cond_init failed: %s\n", strerror(r));
+    exit(EXIT_FAILURE);
   }
-
-#if defined(__x86_64__) || defined(__i386__)
-  /* As explained above, we need some extra gymnastics to avoid a call to
-   * libatomic on x86-64 and i386.
-   */
-  dword_t expected;
-  dword_t old = 0;
-  do {
-    expected = old;
-    old = __sync_val_compare_and_swap(p, expected, v);
-  } while (expected != old);
-  return;
-#endif
-
-  __atomic_store_n(p, v, __ATOMIC_SEQ_CST);
 }
 
-static bool atomic_cas(dword_t *p, dword_t expected, dword_t new) {
+/** call this at the start of a rendezvous point
+ *
+ * This is a low level function, not expected to be directly used outside of the
+ * context of the rendezvous implementation.
+ *
+ * \return True if the caller was the last to arrive and henceforth dubbed the
+ *   'leader'.
+ */
+static bool rendezvous_arrive(void) {
+  int r __attribute__((unused)) = pthread_mutex_lock(&rendezvous_lock);
+  assert(r == 0);
 
-  if (THREADS == 1) {
-    if (*p == expected) {
-      *p = new;
-      return true;
-    }
-    return false;
-  }
+  /* Take a token from the rendezvous down-counter. */
+  assert(rendezvous_pending > 0);
+  rendezvous_pending--;
 
-#if defined(__x86_64__) || defined(__i386__)
-  /* Make GCC >= 7.1 emit cmpxchg on x86-64 and i386. See
-   * https://gcc.gnu.org/bugzilla/show_bug.cgi?id=80878.
+  /* If we were the last to arrive then it was our arrival that dropped the
+   * counter to zero.
    */
-  return __sync_bool_compare_and_swap(p, expected, new);
-#endif
-
-  return __atomic_compare_exchange_n(p, &expected, new, false, __ATOMIC_SEQ_CST,
-                                     __ATOMIC_SEQ_CST);
-}
-
-static dword_t atomic_cas_val(dword_t *p, dword_t expected, dword_t new) {
-
-  if (THREADS == 1) {
-    dword_t old = *p;
-    if (old == expected) {
-      *p = new;
-    }
-    return old;
-  }
-
-#if defined(__x86_64__) || defined(__i386__)
-  /* Make GCC >= 7.1 emit cmpxchg on x86-64 and i386. See
-   * https://gcc.gnu.org/bugzilla/show_bug.cgi?id=80878.
-   */
-  return __sync_val_compare_and_swap(p, expected, new);
-#endif
-
-  (void)__atomic_compare_exchange_n(p, &expected, new, false, __ATOMIC_SEQ_CST,
-                                    __ATOMIC_SEQ_CST);
-  return expected;
-}
-
-/******************************************************************************/
-
-/*******************************************************************************
- * Double pointers                                                             *
- *                                                                             *
- * A scalar type that can store the value of two pointers.                     *
- ******************************************************************************/
-
-#if __SIZEOF_POINTER__ <= 4
-typedef uint64_t double_ptr_t;
-#elif __SIZEOF_POINTER__ <= 8
-typedef unsigned __int128 double_ptr_t;
-#else
-#error "unexpected pointer size; what scalar type to use for double_ptr_t?"
-#endif
-
-static uintptr_t double_ptr_extract1(double_ptr_t p) {
-
-  _Static_assert(sizeof(p) > sizeof(uintptr_t),
-                 "double_ptr_t is not big enough to fit a pointer");
-
-  uintptr_t q;
-  memcpy(&q, &p, sizeof(q));
-
-  return q;
-}
-
-static uintptr_t double_ptr_extract2(double_ptr_t p) {
-
-  _Static_assert(sizeof(p) >= 2 * sizeof(uintptr_t),
-                 "double_ptr_t is not big enough to fit two pointers");
-
-  uintptr_t q;
-  memcpy(&q, (unsigned char *)&p + sizeof(void *), sizeof(q));
-
-  return q;
-}
-
-static double_ptr_t double_ptr_make(uintptr_t q1, uintptr_t q2) {
-
-  double_ptr_t p = 0;
-
-  _Static_assert(sizeof(p) >= 2 * sizeof(uintptr_t),
-                 "double_ptr_t is not big enough to fit two pointers");
-
-  memcpy(&p, &q1, sizeof(q1));
-  memcpy((unsigned char *)&p + sizeof(q1), &q2, sizeof(q2));
-
-  return p;
-}
-
-/******************************************************************************/
-
-/*******************************************************************************
- * State queue                                                                 *
- *                                                                             *
- * The following implements a per-thread queue for pending states. The only    *
- * supported operations are enqueueing and dequeueing states. A property we    *
- * maintain is that all states within all queues pass the current model's      *
- * invariants.                                                                 *
- ******************************************************************************/
-
-static struct {
-  double_ptr_t ends;
-  size_t count;
-} q[THREADS];
-
-static size_t queue_enqueue(struct state *NONNULL s, size_t queue_id) {
-  assert(queue_id < sizeof(q) / sizeof(q[0]) && "out of bounds queue access");
-
-  /* Look up the tail of the queue. */
-
-  double_ptr_t ends = atomic_read(&q[queue_id].ends);
-
-retry:;
-  queue_handle_t tail = double_ptr_extract2(ends);
-
-  if (tail == 0) {
-    /* There's nothing currently in the queue. */
-
-    assert(double_ptr_extract1(ends) == 0 &&
-           "tail of queue 0 while head is non-0");
-
-    struct queue_node *n = queue_node_new();
-    n->s[0] = s;
-
-    double_ptr_t new = double_ptr_make(queue_handle_from_node_ptr(n),
-                                       queue_handle_from_node_ptr(n));
-
-    double_ptr_t old = atomic_cas_val(&q[queue_id].ends, ends, new);
-    if (old != ends) {
-      /* Failed. */
-      queue_node_free(n);
-      ends = old;
-      goto retry;
-    }
-
-  } else {
-    /* The queue is non-empty, so we'll need to access the last element. */
-
-    /* Try to protect our upcoming access to the tail. */
-    hazard(tail);
-    {
-      double_ptr_t ends_check = atomic_read(&q[queue_id].ends);
-      if (ends != ends_check) {
-        /* Failed. Someone else modified the queue in the meantime. */
-        unhazard(tail);
-        ends = ends_check;
-        goto retry;
-      }
-    }
-
-    /* We've now notified other threads that we're going to be accessing the
-     * tail, so we can safely dereference its pointer.
-     */
-
-    struct queue_node *new_node = NULL;
-    queue_handle_t next_tail = queue_handle_next(tail);
-
-    if (queue_handle_is_state_pptr(next_tail)) {
-      /* There's an available slot in this queue node; no need to create a new
-       * one.
-       */
-
-      {
-        struct state **target = queue_handle_to_state_pptr(next_tail);
-        struct state *null = NULL;
-        if (!__atomic_compare_exchange_n(target, &null, s, false,
-                                         __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
-          /* Failed. Someone else enqueued before we could. */
-          unhazard(tail);
-          goto retry;
-        }
-      }
-
-    } else {
-      /* There's no remaining slot in this queue node. We'll need to create a
-       * new (empty) queue node, add our state to this one and then append this
-       * node to the queue.
-       */
-
-      /* Create the new node. */
-      new_node = queue_node_new();
-      new_node->s[0] = s;
-
-      /* Try to update the chained pointer of the current tail to point to this
-       * new node.
-       */
-      struct queue_node **target = queue_handle_to_node_pptr(next_tail);
-      struct queue_node *null = NULL;
-      if (!__atomic_compare_exchange_n(target, &null, new_node, false,
-                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
-        /* Failed. Someone else enqueued before we could. */
-        queue_node_free(new_node);
-        unhazard(tail);
-        goto retry;
-      }
-
-      /* We now need the tail to point at our new node. */
-      next_tail = queue_handle_from_node_ptr(new_node);
-    }
-
-    queue_handle_t head = double_ptr_extract1(ends);
-    double_ptr_t new = double_ptr_make(head, next_tail);
-
-    /* Try to update the queue. */
-    {
-      double_ptr_t old = atomic_cas_val(&q[queue_id].ends, ends, new);
-      if (old != ends) {
-        /* Failed. Someone else dequeued before we could finish. We know the
-         * operation that beat us was a dequeue and not an enqueue, because by
-         * writing to next_tail we have prevented any other enqueue from
-         * succeeding.
-         */
-
-        /* Undo the update of next_tail. We know this is safe (non-racy) because
-         * no other enqueue can proceed and a dequeue will never look into
-         * next_tail due to the way it handles the case when head == tail.
-         */
-        next_tail = queue_handle_next(tail);
-        if (queue_handle_is_state_pptr(next_tail)) {
-          /* We previously wrote into an existing queue node. */
-          struct state **target = queue_handle_to_state_pptr(next_tail);
-          struct state *temp = s;
-          bool r __attribute__((unused)) = __atomic_compare_exchange_n(
-              target, &temp, NULL, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
-          assert(r && "undo of write to next_tail failed");
-        } else {
-          /* We previously wrote into a new queue node. */
-          struct queue_node **target = queue_handle_to_node_pptr(next_tail);
-          struct queue_node *temp = new_node;
-          bool r __attribute__((unused)) = __atomic_compare_exchange_n(
-              target, &temp, NULL, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
-          assert(r && "undo of write to next_tail failed");
-
-          queue_node_free(new_node);
-        }
-
-        unhazard(tail);
-        ends = old;
-        goto retry;
-      }
-    }
-
-    /* Success! */
-
-    unhazard(tail);
-  }
-
-  size_t count = __atomic_add_fetch(&q[queue_id].count, 1, __ATOMIC_SEQ_CST);
-
-  TRACE(TC_QUEUE, "enqueued state %p into queue %zu, queue length is now %zu",
-        s, queue_id, count);
-
-  return count;
-}
-
-static const struct state *queue_dequeue(size_t *NONNULL queue_id) {
-  assert(queue_id != NULL && *queue_id < sizeof(q) / sizeof(q[0]) &&
-         "out of bounds queue access");
-
-  const struct state *s = NULL;
-
-  for (size_t attempts = 0; attempts < sizeof(q) / sizeof(q[0]); attempts++) {
-
-    double_ptr_t ends = atomic_read(&q[*queue_id].ends);
-
-  retry:;
-    queue_handle_t head = double_ptr_extract1(ends);
-
-    if (head != 0) {
-      /* This queue is non-empty. */
-
-      /* Try to protect our upcoming accesses to the head. */
-      hazard(head);
-      {
-        double_ptr_t ends_check = atomic_read(&q[*queue_id].ends);
-        if (ends != ends_check) {
-          /* Failed. Someone else updated the queue. */
-          unhazard(head);
-          ends = ends_check;
-          goto retry;
-        }
-      }
-
-      queue_handle_t tail = double_ptr_extract2(ends);
-
-      double_ptr_t new;
-      if (head == tail) {
-        /* There is only a single element in the queue. We will need to update
-         * both head and tail.
-         */
-        new = double_ptr_make(0, 0);
-      } else if (queue_handle_is_state_pptr(head)) {
-        /* There are multiple elements in the queue; we can deal only with the
-         * head.
-         */
-        new = double_ptr_make(queue_handle_next(head), tail);
-      } else {
-        /* The head of the queue is the end of a queue node. I.e. the only thing
-         * remaining in this queue node is the chained pointer to the next queue
-         * node.
-         */
-
-        /* Load the next queue node. */
-        struct queue_node **n = queue_handle_to_node_pptr(head);
-        struct queue_node *new_head = __atomic_load_n(n, __ATOMIC_SEQ_CST);
-        new = double_ptr_make(queue_handle_from_node_ptr(new_head), tail);
-
-        /* Try to replace the current head with the next node. */
-        double_ptr_t old = atomic_cas_val(&q[*queue_id].ends, ends, new);
-        /* Either way, now we'll need to retry, but if we succeeded we also need
-         * to free the queue node we just removed.
-         */
-        unhazard(head);
-        if (old == ends) {
-          /* Succeeded. */
-          reclaim(head);
-        }
-        ends = old;
-        goto retry;
-      }
-
-      /* Try to remove the head. */
-      {
-        double_ptr_t old = atomic_cas_val(&q[*queue_id].ends, ends, new);
-        if (old != ends) {
-          /* Failed. Someone else either enqueued or dequeued. */
-          unhazard(head);
-          ends = old;
-          goto retry;
-        }
-      }
-
-      /* We now have either a pointer to a state or we've just removed an empty
-       * queue node that was the last in the queue.
-       */
-
-      if (queue_handle_is_state_pptr(head)) {
-        struct state **st = queue_handle_to_state_pptr(head);
-        s = *st;
-      }
-
-      unhazard(head);
-
-      if (head == tail || !queue_handle_is_state_pptr(head)) {
-        reclaim(head);
-      }
-
-      if (s == NULL) {
-        /* Move to the next queue to try. */
-        *queue_id = (*queue_id + 1) % (sizeof(q) / sizeof(q[0]));
-        continue;
-      }
-
-      size_t count =
-          __atomic_sub_fetch(&q[*queue_id].count, 1, __ATOMIC_SEQ_CST);
-
-      TRACE(TC_QUEUE,
-            "dequeued state %p from queue %zu, queue length is now %zu",
-            s, *queue_id, count);
-
-      return s;
-    }
-
-    /* Move to the next queue to try. */
-    *queue_id = (*queue_id + 1) % (sizeof(q) / sizeof(q[0]));
-  }
-
-  return s;
-}
-
-/******************************************************************************/
-
-/*******************************************************************************
- * Reference counted pointers                                                  *
- *                                                                             *
- * These are capable of encapsulating any generic pointer (void*). Note that   *
- * we rely on the existence of double-word atomics. On x86-64, you need to     *
- * use compiler flag '-mcx16' to get an efficient 128-bit cmpxchg.             *
- *                                                                             *
- * Of these functions, only the following are thread safe:                     *
- *                                                                             *
- *   * refcounted_ptr_get                                                      *
- *   * refcounted_ptr_peek                                                     *
- *   * refcounted_ptr_put                                                      *
- *   * refcounted_ptr_set                                                      *
- *                                                                             *
- * The caller is expected to coordinate with other threads to exclude them     *
- * operating on the relevant refcounted_ptr_t when using one of the other      *
- * functions:                                                                  *
- *                                                                             *
- *   * refcounted_ptr_shift                                                    *
- *                                                                             *
- ******************************************************************************/
-
-struct refcounted_ptr {
-  void *ptr;
-  size_t count;
-};
-
-#if __SIZEOF_POINTER__ <= 4
-typedef uint64_t refcounted_ptr_t;
-#elif __SIZEOF_POINTER__ <= 8
-typedef unsigned __int128 refcounted_ptr_t;
-#else
-#error "unexpected pointer size; what scalar type to use for refcounted_ptr_t?"
-#endif
-
-_Static_assert(sizeof(struct refcounted_ptr) <= sizeof(refcounted_ptr_t),
-               "refcounted_ptr does not fit in a refcounted_ptr_t, which we "
-               "need to operate on it atomically");
-
-static void refcounted_ptr_set(refcounted_ptr_t *NONNULL p, void *ptr) {
-
-#ifndef NDEBUG
-  /* Read the current state of the pointer. */
-  refcounted_ptr_t old = atomic_read(p);
-  struct refcounted_ptr p2;
-  memcpy(&p2, &old, sizeof(old));
-  assert(p2.count == 0 && "overwriting a pointer source while someone still "
-                          "has a reference to this pointer");
-#endif
-
-  /* Set the current source pointer with no outstanding references. */
-  struct refcounted_ptr p3;
-  p3.ptr = ptr;
-  p3.count = 0;
-
-  /* Commit the result. */
-  refcounted_ptr_t new;
-  memcpy(&new, &p3, sizeof(p3));
-  atomic_write(p, new);
-}
-
-static void *refcounted_ptr_get(refcounted_ptr_t *NONNULL p) {
-
-  refcounted_ptr_t old, new;
-  void *ret;
-  bool r;
-
-  do {
-
-    /* Read the current state of the pointer. */
-    old = atomic_read(p);
-    struct refcounted_ptr p2;
-    memcpy(&p2, &old, sizeof(old));
-
-    /* Take a reference to it. */
-    p2.count++;
-    ret = p2.ptr;
-
-    /* Try to commit our results. */
-    memcpy(&new, &p2, sizeof(new));
-    r = atomic_cas(p, old, new);
-  } while (!r);
-
-  return ret;
-}
-
-static void refcounted_ptr_put(refcounted_ptr_t *NONNULL p,
-                               void *ptr __attribute__((unused))) {
-
-  refcounted_ptr_t old, new;
-  bool r;
-
-  do {
-
-    /* Read the current state of the pointer. */
-    old = atomic_read(p);
-    struct refcounted_ptr p2;
-    memcpy(&p2, &old, sizeof(old));
-
-    /* Release our reference to it. */
-    ASSERT(p2.ptr == ptr && "releasing a reference to a pointer after someone "
-                            "has changed the pointer source");
-    ASSERT(p2.count > 0 && "releasing a reference to a pointer when it had no "
-                           "outstanding references");
-    p2.count--;
-
-    /* Try to commit our results. */
-    memcpy(&new, &p2, sizeof(new));
-    r = atomic_cas(p, old, new);
-  } while (!r);
-}
-
-static void *refcounted_ptr_peek(refcounted_ptr_t *NONNULL p) {
-
-  /* Read out the state of the pointer. This rather unpleasant expression is
-   * designed to emit an atomic load at a smaller granularity than the entire
-   * refcounted_ptr structure. Because we only need the pointer -- and not the
-   * count -- we can afford to just atomically read the first word.
-   */
-  void *ptr = __atomic_load_n(
-      (void **)((void *)p + __builtin_offsetof(struct refcounted_ptr, ptr)),
-      __ATOMIC_SEQ_CST);
-
-  return ptr;
-}
-
-static void refcounted_ptr_shift(refcounted_ptr_t *NONNULL current,
-                                 refcounted_ptr_t *NONNULL next) {
-
-  /* None of the operations in this function are performed atomically because we
-   * assume the caller has synchronised with other threads via other means.
-   */
-
-  /* The pointer we're about to overwrite should not be referenced. */
-  struct refcounted_ptr p __attribute__((unused));
-  memcpy(&p, current, sizeof(*current));
-  ASSERT(p.count == 0 && "overwriting a pointer that still has outstanding "
-                         "references");
-
-  /* Shift the next value into the current pointer. */
-  *current = *next;
-
-  /* Blank the value we just shifted over. */
-  *next = 0;
-}
-
-/******************************************************************************/
-
-/*******************************************************************************
- * Thread rendezvous support                                                   *
- ******************************************************************************/
-
-static pthread_mutex_t rendezvous_lock; /* mutual exclusion mechanism for below. */
-static pthread_cond_t rendezvous_cond;  /* sleep mechanism for below. */
-static size_t running_count = 1;        /* how many threads are opted in to rendezvous? */
-static size_t rendezvous_pending = 1;   /* how many threads are opted in and not sleeping? */
-
-static void rendezvous_init(void) {
-  int r = pthread_mutex_init(&rendezvous_lock, NULL);
-  if (__builtin_expect(r != 0, 0)) {
-    fprintf(stderr, "pthread_mutex_init failed: %s\n", strerror(r));
-    exit(EXIT_FAILURE);
-  }
-
-  r = pthread_cond_init(&rendezvous_cond, NULL);
-  if (__builtin_expect(r != 0, 0)) {
-    fprintf(stderr, "pthread_cond_init failed: %s\n", strerror(r));
-    exit(EXIT_FAILURE);
-  }
-}
-
-/** call this at the start of a rendezvous point
- *
- * This is a low level function, not expected to be directly used outside of the
- * context of the rendezvous implementation.
- *
- * \return True if the caller was the last to arrive and henceforth dubbed the
- *   'leader'.
- */
-static bool rendezvous_arrive(void) {
-  int r __attribute__((unused)) = pthread_mutex_lock(&rendezvous_lock);
-  assert(r == 0);
-
-  /* Take a token from the rendezvous down-counter. */
-  assert(rendezvous_pending > 0);
-  rendezvous_pending--;
-
-  /* If we were the last to arrive then it was our arrival that dropped the
-   * counter to zero.
-   */
-  return rendezvous_pending == 0;
+  return rendezvous_pending == 0;
 }
 
 /** call this at the end of a rendezvous point
@@ -3110,6 +3683,7 @@ static void rendezvous_depart(bool leader, void (*action)(void)) {
   assert(r == 0);
 }
 
+#if CHECKPOINT || MEMORY_LIMIT > 0
 /* Exposed friendly function for performing a rendezvous. */
 static void rendezvous(void (*action)(void)) {
   bool leader = rendezvous_arrive();
@@ -3118,6 +3692,7 @@ static void rendezvous(void (*action)(void)) {
   }
   rendezvous_depart(leader, action);
 }
+#endif
 
 /* Remove the caller from the pool of threads who participate in this
  * rendezvous.
@@ -3154,17 +3729,30 @@ retry:;
 /*******************************************************************************
  * 'Slots', an opaque wrapper around a state pointer                           *
  *                                                                             *
- * See usage of this in the state set below for its purpose.                   *
+ * See usage of this in the state set below for its purpose. With hash         *
+ * compaction, a slot instead holds a fingerprint of the state's data. In      *
+ * bitstate mode, a slot is simply a word of the bit array, and with tree      *
+ * compression a node of a tree. Slots are unused with the inline set layout.  *
  ******************************************************************************/
 
+#if HASH_COMPACTION_BITS > 0 || TREE_COMPRESSION
+typedef uint64_t slot_t;
+#elif STATE_ID_BITS > 0 && STATE_ID_BITS <= 32
+typedef uint32_t slot_t;
+#else
 typedef uintptr_t slot_t;
+#endif
 
+#if BITSTATE_HASHES == 0 && !INLINE_SET && !EXTERNAL_MEMORY
 static __attribute__((const)) slot_t slot_empty(void) { return 0; }
 
 static __attribute__((const)) bool slot_is_empty(slot_t s) {
   return s == slot_empty();
 }
+#endif
 
+#if BITSTATE_HASHES == 0 && !TREE_COMPRESSION && !INLINE_SET &&                \
+    !EXTERNAL_MEMORY
 static __attribute__((const)) slot_t slot_tombstone(void) {
   static const slot_t TOMBSTONE = ~(slot_t)0;
   return TOMBSTONE;
@@ -3174,13 +3762,134 @@ static __attribute__((const)) bool slot_is_tombstone(slot_t s) {
   return s == slot_tombstone();
 }
 
-static struct state *slot_to_state(slot_t s) {
+#if HASH_COMPACTION_BITS > 0
+/* The fingerprint of a state is the top HASH_COMPACTION_BITS of its hash. The
+ * two values reserved for empty slots and tombstones are folded into their
+ * neighbours. The fingerprint is itself a hash, so we also use it to place the
+ * state in the set.
+ */
+static size_t set_hash(const struct state *NONNULL s) {
+  slot_t f = (slot_t)data_hash(s->data) >>
+             (64 - HASH_COMPACTION_BITS);
+  if (slot_is_empty(f)) {
+    f++;
+  } else if (slot_is_tombstone(f)) {
+    f--;
+  }
+  return (size_t)f;
+}
+
+#if MEMORY_LIMIT > 0
+/* With --memory-limit, the top byte of a slot is used to choose which states to
+ * evict, leaving the fingerprint the bits below it. The top bit pins a state
+ * that is still pending, during eviction only. The remaining bits are a score
+ * that starts at SLOT_SCORE_NEW, is raised each time the state is reached
+ * again, and decays by one in each round of eviction. States with the lowest
+ * score are evicted first, so those rarely reached or not reached for a long
+ * time go before those reached often and recently.
+ */
+enum { SLOT_SCORE_SHIFT = 56 };
+enum { SLOT_SCORE_MAX = 127 };
+enum { SLOT_SCORE_NEW = 2 };
+
+_Static_assert(HASH_COMPACTION_BITS <= SLOT_SCORE_SHIFT,
+               "fingerprints overlap eviction scores");
+
+static const slot_t SLOT_PINNED = (slot_t)1 << 63;
+
+static slot_t slot_fingerprint(slot_t s) {
+  return s & (((slot_t)1 << SLOT_SCORE_SHIFT) - 1);
+}
+
+static unsigned slot_score(slot_t s) {
+  return (unsigned)(s >> SLOT_SCORE_SHIFT) & SLOT_SCORE_MAX;
+}
+
+static slot_t slot_with_score(slot_t s, unsigned score) {
+  return (s & (slot_fingerprint(~(slot_t)0) | SLOT_PINNED)) |
+         ((slot_t)score << SLOT_SCORE_SHIFT);
+}
+
+/* Note that a state already in the set has been reached again. This races
+ * with other threads doing the same or migrating the slot, in which case the
+ * visit may go unrecorded.
+ */
+static void slot_visit(slot_t *NONNULL bucket, slot_t s) {
+  if (slot_score(s) < SLOT_SCORE_MAX) {
+    (void)__atomic_compare_exchange_n(bucket, &s,
+                                      slot_with_score(s, slot_score(s) + 1),
+                                      false, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED);
+  }
+}
+#else
+static slot_t slot_fingerprint(slot_t s) { return s; }
+#endif
+
+static slot_t state_to_slot(const struct state *NONNULL s
+                            __attribute__((unused)),
+                            size_t hash) {
+#if MEMORY_LIMIT > 0
+  return slot_with_score((slot_t)hash, SLOT_SCORE_NEW);
+#else
+  return (slot_t)hash;
+#endif
+}
+
+static bool slot_eq(slot_t a, slot_t b) {
+  return slot_fingerprint(a) == slot_fingerprint(b);
+}
+
+static size_t slot_hash(slot_t s) { return (size_t)slot_fingerprint(s); }
+#else
+/* Any bits of a slot above those needed to refer to a state hold a tag, the
+ * corresponding high bits of the state's hash. Comparing tags lets us reject
+ * most non-matching slots without dereferencing the state, which is likely to
+ * be a cache miss. The tag moves with the slot value when the set is
+ * migrated, so it is never recomputed.
+ */
+enum { SLOT_TAG_BITS = sizeof(slot_t) * CHAR_BIT - STATE_REF_BITS };
+
+static __attribute__((const)) slot_t slot_pointer_mask(void) {
+  return ~(slot_t)0 >> SLOT_TAG_BITS;
+}
+
+static struct state *slot_to_state(slot_t s) {
   ASSERT(!slot_is_empty(s));
   ASSERT(!slot_is_tombstone(s));
-  return (struct state *)s;
+  return state_deref(s & slot_pointer_mask());
+}
+
+static size_t set_hash(const struct state *NONNULL s) {
+  return state_hash(s);
+}
+
+static slot_t state_to_slot(const struct state *NONNULL s, size_t hash) {
+  slot_t slot = (slot_t)state_ref(s);
+  ASSERT((slot & ~slot_pointer_mask()) == 0 &&
+         "state pointer exceeds expected pointer bits");
+  /* take the tag from the top of the hash, whose bottom picks the bucket */
+  slot_t tag = (slot_t)((uint64_t)hash >> (64 - sizeof(slot_t) * CHAR_BIT));
+  return slot | (tag & ~slot_pointer_mask());
+}
+
+static bool slot_eq(slot_t a, slot_t b) {
+  if (((a ^ b) & ~slot_pointer_mask()) != 0) {
+    /* differing tags, so these cannot be the same state */
+    return false;
+  }
+  return state_eq(slot_to_state(a), slot_to_state(b));
 }
 
-static slot_t state_to_slot(const struct state *s) { return (slot_t)s; }
+static size_t slot_hash(slot_t s) {
+#if INCREMENTAL_HASH
+  return (size_t)state_stored_hash(slot_to_state(s));
+#else
+  return state_hash(slot_to_state(s));
+#endif
+}
+#endif
+#endif
 
 /******************************************************************************/
 
@@ -3188,20 +3897,84 @@ static slot_t state_to_slot(const struct state *s) { return (slot_t)s; }
  * State set                                                                   *
  *                                                                             *
  * The following implementation provides a set for storing the seen states.    *
- * There is no support for removing elements, only thread-safe insertion of    *
- * elements.                                                                   *
+ * It supports thread-safe insertion of elements. Elements are only ever       *
+ * removed when the set has reached the limit given by --memory-limit, at      *
+ * which point some states are evicted instead of expanding it (see 'State     *
+ * caching' below).                                                            *
  ******************************************************************************/
 
+#if INLINE_SET
+/* With the inline layout, the set stores the states' data itself rather than
+ * pointers to states. Each bucket is a cache line holding as many states as
+ * fit, each with a status byte. A lookup then usually touches a single cache
+ * line and never follows a pointer. The code generator only selects this for
+ * states small enough to fit at least two to a line.
+ */
+enum { SET_LINE_SIZE = 64 };
+enum { SET_LINE_ENTRIES = SET_LINE_SIZE / (STATE_SIZE_BYTES + 1) };
+
+struct set_line {
+  uint8_t status[SET_LINE_ENTRIES];
+  uint8_t data[SET_LINE_ENTRIES][STATE_SIZE_BYTES];
+} __attribute__((aligned(SET_LINE_SIZE)));
+
+typedef struct set_line bucket_t;
+
+/* Values of an entry's status byte. Any value of at least ENTRY_FULL means the
+ * entry holds a state, with the exact value acting as a tag derived from the
+ * state's hash.
+ */
+enum {
+  ENTRY_EMPTY = 0,    /* nothing stored here */
+  ENTRY_BUSY = 1,     /* claimed by a thread that is writing the state data */
+  ENTRY_MIGRATED = 2, /* moved to the next set during expansion */
+  ENTRY_FULL = 3,
+};
+#else
+enum { SET_LINE_ENTRIES = 1 };
+
+typedef slot_t bucket_t;
+#endif
+
+/* With external memory, SET_CAPACITY bounds the in-memory batch table instead
+ * and the set itself is unused.
+ */
 enum {
   INITIAL_SET_SIZE_EXPONENT =
-      sizeof(unsigned long long) * 8 - 1 -
-      __builtin_clzll(SET_CAPACITY / sizeof(struct state *) /
-                      sizeof(struct state))
+      EXTERNAL_MEMORY
+          ? 0
+          : sizeof(unsigned long long) * 8 - 1 -
+                __builtin_clzll(SET_CAPACITY / sizeof(bucket_t) /
+                                (SET_STORES_STATES ? sizeof(struct state) : 1))
 };
 
+/* States can only be evicted from the set by dropping their fingerprints, as
+ * other states they are reachable from may still refer to full states.
+ */
+_Static_assert(MEMORY_LIMIT == 0 || HASH_COMPACTION_BITS > 0,
+               "state caching without hash compaction");
+
 struct set {
-  slot_t *bucket;
+  bucket_t *bucket;
   size_t size_exponent;
+#if INLINE_SET || HUGE_PAGES_SUPPORTED
+  void *allocation; /* base of the storage 'bucket' was carved from */
+#endif
+#if HUGE_PAGES_SUPPORTED
+  size_t allocation_size; /* length of the mapping at 'allocation' */
+#endif
+
+  /* The set this one is being expanded into, if any. */
+  struct set *next;
+
+  /* Progress of migrating this set's contents into 'next', in chunks. See
+   * 'set_migrate_step'.
+   */
+  uint8_t *migrated;         /* per-chunk CHUNK_* state */
+  size_t migration_claimed;  /* next chunk for a thread to take */
+  size_t migration_finished; /* chunks that have been fully migrated */
+
+  size_t users; /* threads whose 'local_seen' points at this set */
 };
 
 /* Some utility functions for dealing with exponents. */
@@ -3210,39 +3983,75 @@ static size_t set_size(const struct set *NONNULL set) {
   return ((size_t)1) << set->size_exponent;
 }
 
+#if BITSTATE_HASHES == 0 && !EXTERNAL_MEMORY
 static size_t set_index(const struct set *NONNULL set, size_t index) {
   return index & (set_size(set) - 1);
 }
+#endif
+
+/* Allocate zeroed buckets for a set whose size exponent is already set. */
+static void set_allocate(struct set *NONNULL set) {
+#if HUGE_PAGES_SUPPORTED
+  /* mappings are page-aligned, so need no further alignment for the inline
+   * set
+   */
+  set->allocation_size = set_size(set) * sizeof(set->bucket[0]);
+  set->allocation = huge_alloc(&set->allocation_size);
+  if (__builtin_expect(set->allocation == NULL, 0)) {
+    oom();
+  }
+  set->bucket = set->allocation;
+#elif INLINE_SET
+  /* over-allocate by a line so we can align the buckets to a cache line */
+  set->allocation = xcalloc(set_size(set) + 1, sizeof(set->bucket[0]));
+  uintptr_t base = (uintptr_t)set->allocation;
+  base = (base + SET_LINE_SIZE - 1) / SET_LINE_SIZE * SET_LINE_SIZE;
+  set->bucket = (bucket_t *)base;
+#else
+  set->bucket = xcalloc(set_size(set), sizeof(set->bucket[0]));
+#endif
+  numa_interleave(set->bucket, set_size(set) * sizeof(set->bucket[0]));
+}
+
+static void set_deallocate(struct set *NONNULL set) {
+#if HUGE_PAGES_SUPPORTED
+  huge_free(set->allocation, set->allocation_size);
+#elif INLINE_SET
+  free(set->allocation);
+#else
+  free(set->bucket);
+#endif
+}
 
 /* The states we have encountered. This collection will only ever grow while
- * checking the model. Note that we have a global reference-counted pointer and
- * a local bare pointer. See below for an explanation.
+ * checking the model. Each thread uses the set pointed to by its 'local_seen',
+ * which may lag behind the global pointer to the current set while the set is
+ * being expanded. See below for an explanation.
  */
-static refcounted_ptr_t global_seen;
+static struct set *global_seen;
 static _Thread_local struct set *local_seen;
 
-/* Number of elements in the global set (i.e. occupancy). */
-static size_t seen_count;
-
-/* The "next" 'global_seen' value. See below for an explanation. */
-static refcounted_ptr_t next_global_seen;
-
-/* Now the explanation I teased... When the set capacity exceeds a threshold
- * (see 'set_expand' related logic below) it is expanded and the reference
- * tracking within the 'refcounted_ptr_t's comes in to play. We need to allocate
- * a new seen set ('next_global_seen'), copy over all the elements (done in
- * 'set_migrate'), and then "shift" the new set to become the current set. The
- * role of the reference counts of both 'global_seen' and 'next_global_seen' in
- * all of this is to detect when the last thread releases its reference to the
- * old seen set and hence can deallocate it.
+/* The oldest set some thread may still be using. Sets from here up to
+ * 'global_seen' are linked by their 'next' pointers.
  */
-
-/* The next chunk to migrate from the old set to the new set. What exactly a
- * "chunk" is is covered in 'set_migrate'.
+static struct set *oldest_seen;
+
+/* Now the explanation I teased... When the set occupancy exceeds a threshold
+ * (see 'set_expand' related logic below) it is expanded. A new set of double
+ * the size is allocated and linked from the old set's 'next' pointer. Its
+ * contents are then migrated a chunk at a time, each thread inserting into the
+ * set migrating one chunk before doing so. Insertions carry on throughout,
+ * looking for a state in both sets and adding it to the new one (see
+ * 'set_insert_hashed'). Once the last chunk has been migrated, the new set
+ * becomes the current one. Each thread moves on to it the next time it
+ * inserts, and the last thread to move off the old set deallocates it. No
+ * thread ever waits for another, and at most two sets are ever being inserted
+ * into at once.
  */
-static size_t next_migration;
 
-/* A mechanism for synchronisation in 'set_expand'. */
+/* A mechanism for synchronisation in 'set_expand' and when threads start and
+ * stop using a set. None of these are on the hot path.
+ */
 static pthread_mutex_t set_expand_mutex;
 
 static void set_expand_lock(void) {
@@ -3259,6 +4068,120 @@ static void set_expand_unlock(void) {
   }
 }
 
+/* Number of elements in the global set (i.e. occupancy), sharded by thread so
+ * insertions do not contend on a single counter. Each thread only writes its
+ * own shard, and readers sum them.
+ */
+static struct {
+  size_t value;
+} __attribute__((aligned(64))) seen_count_shard[THREADS];
+
+/* Count an element this thread has added to the set, returning how many it
+ * has added in total.
+ */
+static size_t seen_count_add(void) {
+  size_t value = seen_count_shard[thread_id].value + 1;
+  __atomic_store_n(&seen_count_shard[thread_id].value, value,
+                   __ATOMIC_RELAXED);
+  return value;
+}
+
+/* Occupancy of the set. This is only exact if no other threads are inserting.
+ */
+static size_t seen_count(void) {
+  size_t count = 0;
+  for (size_t i = 0; i < THREADS; i++) {
+    count += __atomic_load_n(&seen_count_shard[i].value, __ATOMIC_RELAXED);
+  }
+  return count;
+}
+
+/* With --memory-limit, the number of rounds in which states have been evicted
+ * from the set and the total number of states evicted. These are only updated
+ * while all other threads are waiting (see 'eviction_poll').
+ */
+static size_t eviction_rounds;
+static size_t evicted_count;
+
+#if MEMORY_LIMIT > 0
+/* Has the set reached the memory limit, so that states need to be evicted
+ * from it?
+ */
+static bool eviction_pending;
+
+/* A bit array with a bit set for the fingerprint of every state ever evicted,
+ * allocated at the first eviction. A state inserted whose bit is clear has
+ * certainly never been seen before. Insertions of states whose bits are set
+ * are likely to be states explored again after their eviction.
+ */
+static uint8_t *evicted_filter;
+
+/* Size of 'evicted_filter' in bytes, a sixteenth of the memory limit rounded
+ * down to a power of 2. This is set aside from the start.
+ */
+static size_t evicted_filter_size(void) {
+  size_t size = (size_t)MEMORY_LIMIT / 16;
+  if (size == 0) {
+    return 1;
+  }
+  return (size_t)1 << (sizeof(unsigned long long) * CHAR_BIT - 1 -
+                       (size_t)__builtin_clzll(size));
+}
+
+/* Has a state not previously evicted been inserted since the last eviction?
+ */
+static bool eviction_progress;
+
+/* Memory taken by a pending state, the state itself and its entry in a queue,
+ * whose array can be up to twice the size needed.
+ */
+enum { PENDING_STATE_SIZE = sizeof(struct state) + 2 * sizeof(struct state *) };
+
+/* Memory counted against --memory-limit, the seen set and any set it is being
+ * expanded into, the record of evicted states, and the pending states. The
+ * latter is approximate, as the queues are read unsynchronised.
+ */
+static size_t memory_used(const struct set *NONNULL set) {
+  size_t used = set_size(set) * sizeof(set->bucket[0]);
+  const struct set *next = __atomic_load_n(&set->next, __ATOMIC_SEQ_CST);
+  if (next != NULL) {
+    used += set_size(next) * sizeof(next->bucket[0]);
+  }
+  return used + evicted_filter_size() + queue_length() * PENDING_STATE_SIZE;
+}
+
+static size_t evicted_filter_index(slot_t s) {
+  /* use the high bits of a multiplicative hash, which are independent of the
+   * low bits of the fingerprint that place the state in the set
+   */
+  return (size_t)((slot_fingerprint(s) * UINT64_C(0x9e3779b97f4a7c15)) >>
+                   (64 - __builtin_ctzll(evicted_filter_size() * CHAR_BIT)));
+}
+
+/* Note the insertion of a new state into the set. */
+static void eviction_note_insert(slot_t s) {
+  if (evicted_filter == NULL ||
+      __atomic_load_n(&eviction_progress, __ATOMIC_RELAXED)) {
+    return;
+  }
+  size_t i = evicted_filter_index(s);
+  if ((evicted_filter[i / CHAR_BIT] & (1u << (i % CHAR_BIT))) == 0) {
+    __atomic_store_n(&eviction_progress, true, __ATOMIC_RELAXED);
+  }
+}
+#endif
+
+/* Number of states the set currently holds. This differs from seen_count()
+ * once states have been evicted, after which seen_count() also counts states
+ * that were inserted again after their eviction.
+ */
+static __attribute__((unused)) size_t set_occupancy(void) {
+  size_t count = seen_count();
+  size_t evicted = __atomic_load_n(&evicted_count, __ATOMIC_SEQ_CST);
+  /* the shards are read unsynchronised, so may lag behind the evictions */
+  return count < evicted ? 0 : count - evicted;
+}
+
 static void set_init(void) {
 
   if (THREADS > 1) {
@@ -3272,190 +4195,854 @@ static void set_init(void) {
   /* Allocate the set we'll store seen states in at some conservative initial
    * size.
    */
-  struct set *set = xmalloc(sizeof(*set));
+  struct set *set = xcalloc(1, sizeof(*set));
   set->size_exponent = INITIAL_SET_SIZE_EXPONENT;
-  set->bucket = xcalloc(set_size(set), sizeof(set->bucket[0]));
+  set_allocate(set);
 
-  /* Stash this somewhere for threads to later retrieve it from. Note that we
-   * initialize its reference count to zero as we (the setup logic) are not
-   * using it beyond this function.
-   */
-  refcounted_ptr_set(&global_seen, set);
+  /* Stash this somewhere for threads to later retrieve it from. */
+  global_seen = set;
+  oldest_seen = set;
+}
+
+/* Deallocate any sets no thread is using any more. The caller must hold the
+ * expansion lock.
+ */
+static void set_reclaim(void) {
+  while (oldest_seen != global_seen && oldest_seen->users == 0) {
+    struct set *set = oldest_seen;
+    oldest_seen = set->next;
+    TRACE(TC_SET, "deallocating set of %zu slots", set_size(set));
+    set_deallocate(set);
+    free(set->migrated);
+    free(set);
+  }
 }
 
 static void set_thread_init(void) {
-  /* Take a local reference to the global seen set. */
-  local_seen = refcounted_ptr_get(&global_seen);
+  /* Start using the current set. */
+  set_expand_lock();
+  local_seen = global_seen;
+  local_seen->users++;
+  set_expand_unlock();
 }
 
-static void set_update(void) {
-  /* Guard against the case where we've been called from exit_with() and we're
-   * not finishing a migration, but just opting out of the rendezvous protocol.
-   */
-  if (refcounted_ptr_peek(&next_global_seen) != NULL) {
+static void set_thread_release(void) {
+  /* Stop using our set, deallocating it if it has been superseded. */
+  set_expand_lock();
+  ASSERT(local_seen->users > 0 && "releasing a set no one was using");
+  local_seen->users--;
+  set_reclaim();
+  set_expand_unlock();
+  local_seen = NULL;
+}
 
-    /* Clean up the old set. Note that we are using a pointer we have already
-     * given up our reference count to here, but we rely on the caller to ensure
-     * this access is safe.
-     */
-    free(local_seen->bucket);
-    free(local_seen);
+#if EXTERNAL_MEMORY
+/* set_insert_hashed() is provided by the external memory support below. */
+#elif BITSTATE_HASHES > 0
+/* In bitstate mode, the set is a fixed-size array of bits. Inserting a state
+ * sets BITSTATE_HASHES bits chosen by hashing the state, and the state is
+ * considered new if any of these were previously unset. Distinct states can
+ * map to the same bits, so some states may be wrongly considered already seen
+ * and their successors never explored. The set never expands. Rather than
+ * computing BITSTATE_HASHES independent hashes, we derive them from two (see
+ * Kirsch & Mitzenmacher, “Less Hashing, Same Performance: Building a Better
+ * Bloom Filter”).
+ *
+ * Two threads concurrently inserting the same state can both consider it new,
+ * in which case it will be expanded twice. This is harmless beyond the wasted
+ * work and a slight overcount of states.
+ */
+enum { SLOT_BITS = sizeof(slot_t) * CHAR_BIT };
 
-    /* Reset migration state for the next time we expand the set. */
-    next_migration = 0;
+static size_t set_hash(const struct state *NONNULL s) {
+  return (size_t)data_hash(s->data);
+}
 
-    /* Update the global pointer to the new set. We know all the above
-     * migrations have completed and no one needs the old set.
-     */
-    refcounted_ptr_shift(&global_seen, &next_global_seen);
+/* Start fetching the word holding the first bit a state with the given hash
+ * maps to.
+ */
+static __attribute__((unused)) void set_prefetch(size_t hash) {
+  size_t bits = set_size(local_seen) * SLOT_BITS;
+  __builtin_prefetch(&local_seen->bucket[(hash & (bits - 1)) / SLOT_BITS], 1);
+}
+
+static bool set_insert_hashed(struct state *NONNULL s, size_t hash,
+                              size_t *NONNULL count) {
+
+  size_t bits = set_size(local_seen) * SLOT_BITS;
+
+  uint64_t h1 = (uint64_t)hash;
+  uint64_t h2 = hash_kernel(s->data, 1) | 1;
+
+  bool fresh = false;
+  for (size_t i = 0; i < BITSTATE_HASHES; i++) {
+    size_t bit = (size_t)(h1 + i * h2) & (bits - 1);
+    slot_t mask = (slot_t)1 << (bit % SLOT_BITS);
+    slot_t old = __atomic_fetch_or(&local_seen->bucket[bit / SLOT_BITS], mask,
+                                   __ATOMIC_SEQ_CST);
+    if (!(old & mask)) {
+      fresh = true;
+    }
+  }
+
+  if (!fresh) {
+    TRACE(TC_SET, "skipped adding state %p that was already in set", s);
+    return false;
+  }
+
+  *count = seen_count_add();
+  TRACE(TC_SET, "added state %p, this thread has added %zu", s, *count);
+
+  size_t depth = 0;
+#if BOUND > 0
+  depth = (size_t)state_bound_get(s);
+#endif
+  register_allocation(depth);
+
+  return true;
+}
+
+/* Proportion of the bit array that is set. */
+static double bitstate_fill_ratio(void) {
+  size_t set = 0;
+  for (size_t i = 0; i < set_size(local_seen); i++) {
+    set += (size_t)__builtin_popcountll(local_seen->bucket[i]);
   }
+  return (double)set / (double)(set_size(local_seen) * sizeof(slot_t) *
+                                CHAR_BIT);
 }
 
-static void set_migrate(void) {
+/* A rough estimate of the proportion of the state space that was covered. A
+ * new state is wrongly discarded if all of its bits are already set, which
+ * happens with a probability of at most the final fill ratio raised to the
+ * power of the number of hashes. This does not account for the states only
+ * reachable through a discarded one, so it is not a lower bound on coverage.
+ */
+static double bitstate_coverage(void) {
+  double fill = bitstate_fill_ratio();
+  double omission = 1;
+  for (size_t i = 0; i < BITSTATE_HASHES; i++) {
+    omission *= fill;
+  }
+  return 1 - omission;
+}
+#elif TREE_COMPRESSION
+/* With tree compression, the set is a table of the nodes of binary trees, as
+ * described by Laarman, van de Pol and Weber in “Parallel Recursive State
+ * Compression for Free”. A state is cut into leaves at the offsets in
+ * TREE_LEAF_OFFSET, which follow the boundaries of its variables. Each pair of
+ * sibling leaves, and in turn each pair of sibling subtrees, is interned in the
+ * table and represented by its index there. The two halves of the whole state
+ * form its root, which is inserted flagged as such so it cannot be mistaken for
+ * an interior node, and the state is new if its root was not already present.
+ * States with components in common share the nodes for those components, so a
+ * state can cost little more than its root.
+ *
+ * A node's index is its position in the table, so the table can never be
+ * moved to expand it. Nodes hold two 31-bit children and a bit that marks them
+ * as occupied, which distinguishes an empty entry from a node of two zeroes.
+ */
+enum {
+  TREE_LEAVES = sizeof(TREE_LEAF_OFFSET) / sizeof(TREE_LEAF_OFFSET[0]) - 1
+};
 
-  TRACE(TC_SET, "assisting in set migration...");
+_Static_assert((size_t)INITIAL_SET_SIZE_EXPONENT <= (size_t)TREE_LEAF_BITS,
+               "tree node table too large to index in a leaf's width");
 
-  /* Size of a migration chunk. Threads in this function grab a chunk at a time
-   * to migrate.
-   */
-  enum { CHUNK_SIZE = 4096 / sizeof(local_seen->bucket[0]) /* slots */ };
+static const slot_t TREE_NODE_FULL = (slot_t)1 << 62;
+static const slot_t TREE_NODE_ROOT = (slot_t)1 << 63;
 
-  /* Take a pointer to the target set for the migration. */
-  struct set *next = refcounted_ptr_get(&next_global_seen);
+static slot_t tree_node(uint32_t left, uint32_t right) {
+  return TREE_NODE_FULL | ((slot_t)left << TREE_LEAF_BITS) | (slot_t)right;
+}
 
-  for (;;) {
+static _Noreturn void tree_full(void) {
+  fputs("tree node table is full; rerun with a larger --set-capacity\n",
+        stderr);
+  exit(EXIT_FAILURE);
+}
 
-    size_t chunk = __atomic_fetch_add(&next_migration, 1, __ATOMIC_SEQ_CST);
-    size_t start = chunk * CHUNK_SIZE;
-    size_t end = start + CHUNK_SIZE;
+/* Find a node in the table, inserting it if it is not there. Returns true if
+ * it was inserted, and its index in either case.
+ */
+static bool tree_insert(slot_t node, size_t *NONNULL index) {
 
-    /* Bail out if we've finished migrating all of the set. */
-    if (start >= set_size(local_seen)) {
-      break;
-    }
+  size_t i = set_index(local_seen, (size_t)hash_mix(node));
+  for (size_t attempts = 0; attempts < set_size(local_seen); attempts++) {
 
-    /* TODO: The following algorithm assumes insertions can collide. That is, it
-     * operates atomically on slots because another thread could be migrating
-     * and also targeting the same slot. If we were to more closely wick to the
-     * Maier design this would not be required.
+    /* most nodes are already present, so look before trying to claim the entry
+     * to avoid needlessly dirtying its cache line
      */
+    slot_t c = __atomic_load_n(&local_seen->bucket[i], __ATOMIC_SEQ_CST);
+    if (slot_is_empty(c) &&
+        __atomic_compare_exchange_n(&local_seen->bucket[i], &c, node, false,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      *index = i;
+      return true;
+    }
 
-    for (size_t i = start; i < end; i++) {
+    if (c == node) {
+      *index = i;
+      return false;
+    }
 
-      /* retrieve the slot element and mark it as migrated */
-      slot_t s = __atomic_exchange_n(&local_seen->bucket[i], slot_tombstone(),
-                                     __ATOMIC_SEQ_CST);
-      ASSERT(!slot_is_tombstone(s) && "attempted double slot migration");
+    i = set_index(local_seen, i + 1);
+  }
 
-      /* If the current slot contained a state, rehash it and insert it into the
-       * new set. Note we don't need to do any state comparisons because we know
-       * everything in the old set is unique.
-       */
-      if (!slot_is_empty(s)) {
-        size_t index = set_index(next, state_hash(slot_to_state(s)));
-        /* insert and shuffle any colliding entries one along */
-        for (size_t j = index; !slot_is_empty(s); j = set_index(next, j + 1)) {
-          s = __atomic_exchange_n(&next->bucket[j], s, __ATOMIC_SEQ_CST);
-        }
-      }
-    }
+  tree_full();
+}
+
+/* The leaves and interior nodes of the last state this thread interned, so that
+ * a similar state, such as the next successor of the same state, only needs to
+ * intern the parts of its tree that differ. An interior node is identified by
+ * the leaf at which its two halves meet, which is unique within the tree.
+ */
+static _Thread_local uint32_t tree_leaf[TREE_LEAVES + 1];
+static _Thread_local uint32_t tree_interior[TREE_LEAVES + 1];
+static _Thread_local bool tree_cached;
+
+/* Find the value of the subtree of a state spanning leaves [lo, hi), interning
+ * those of its interior nodes that are not in the cached tree. Returns whether
+ * the subtree differs from the cached one.
+ */
+static bool tree_update(const struct state *NONNULL s, size_t lo, size_t hi,
+                        uint32_t *NONNULL value) {
+
+  ASSERT(hi > lo && "empty subtree");
+
+  if (hi - lo == 1) {
+    size_t offset = TREE_LEAF_OFFSET[lo];
+    uint32_t leaf = (uint32_t)read_raw(
+        state_handle(s, offset, TREE_LEAF_OFFSET[hi] - offset));
+    bool changed = !tree_cached || leaf != tree_leaf[lo];
+    tree_leaf[lo] = leaf;
+    *value = leaf;
+    return changed;
   }
 
-  /* Release our reference to the old set now we're done with it. */
-  refcounted_ptr_put(&global_seen, local_seen);
+  size_t mid = lo + (hi - lo) / 2;
+  uint32_t left;
+  uint32_t right;
+  bool left_changed = tree_update(s, lo, mid, &left);
+  bool right_changed = tree_update(s, mid, hi, &right);
 
-  /* Now we need to make sure all the threads get to this point before any one
-   * thread leaves. The purpose of this is to guarantee we only ever have at
-   * most two seen sets "in flight". Without this rendezvous, one thread could
-   * race ahead, fill the new set, and then decide to expand again while some
-   * are still working on the old set. It's possible to make such a scheme work
-   * but the synchronisation requirements just seem too complicated.
-   */
-  rendezvous(set_update);
+  if (left_changed || right_changed) {
+    size_t index;
+    (void)tree_insert(tree_node(left, right), &index);
+    tree_interior[mid] = (uint32_t)index;
+  }
+  *value = tree_interior[mid];
+  return left_changed || right_changed;
+}
 
-  /* We're now ready to resume model checking. Note that we already have a
-   * (reference counted) pointer to the now-current global seen set, so we don't
-   * need to take a fresh reference to it.
-   */
-  local_seen = next;
+/* In place of a hash, a state is identified by its root node, interning the
+ * rest of its tree as a side effect.
+ */
+static size_t set_hash(const struct state *NONNULL s) {
+  uint32_t left = 0;
+  uint32_t right = 0;
+  if (TREE_LEAVES == 1) {
+    (void)tree_update(s, 0, 1, &right);
+  } else if (TREE_LEAVES > 1) {
+    (void)tree_update(s, 0, TREE_LEAVES / 2, &left);
+    (void)tree_update(s, TREE_LEAVES / 2, TREE_LEAVES, &right);
+  }
+  tree_cached = true;
+  return (size_t)(TREE_NODE_ROOT | tree_node(left, right));
 }
 
-static void set_expand(void) {
+/* Start fetching the entry a state with the given root will first probe. */
+static __attribute__((unused)) void set_prefetch(size_t hash) {
+  __builtin_prefetch(
+      &local_seen->bucket[set_index(local_seen, (size_t)hash_mix(hash))], 1);
+}
 
-  /* Using double-checked locking, we look to see if someone else has already
-   * started expanding the set. We do this by first checking before acquiring
-   * the set mutex, and then later again checking after we've acquired the
-   * mutex. The idea here is that, with multiple threads, you'll frequently find
-   * someone else beat you to expansion and you can jump straight to helping
-   * them with migration without having the expense of acquiring the set mutex.
-   */
-  if (THREADS > 1 && refcounted_ptr_peek(&next_global_seen) != NULL) {
-    /* Someone else already expanded it. Join them in the migration effort. */
-    TRACE(TC_SET, "attempted expansion failed because another thread got there "
-                  "first");
-    set_migrate();
-    return;
+static bool set_insert_hashed(struct state *NONNULL s, size_t hash,
+                              size_t *NONNULL count) {
+
+  size_t index;
+  if (!tree_insert((slot_t)hash, &index)) {
+    TRACE(TC_SET, "skipped adding state %p that was already in set", s);
+    return false;
   }
 
-  set_expand_lock();
+  *count = seen_count_add();
+  TRACE(TC_SET, "added state %p, this thread has added %zu", s, *count);
 
-  /* Check again, as described above. */
-  if (THREADS > 1 && refcounted_ptr_peek(&next_global_seen) != NULL) {
-    set_expand_unlock();
-    TRACE(TC_SET, "attempted expansion failed because another thread got there "
-                  "first");
-    set_migrate();
-    return;
+  size_t depth = 0;
+#if BOUND > 0
+  depth = (size_t)state_bound_get(s);
+#endif
+  register_allocation(depth);
+
+  return true;
+}
+
+/* Number of interior nodes in the table, which with the roots of the seen
+ * states make up its contents.
+ */
+static size_t tree_interior_count(void) {
+  size_t count = 0;
+  for (size_t i = 0; i < set_size(local_seen); i++) {
+    slot_t c = local_seen->bucket[i];
+    if (!slot_is_empty(c) && !(c & TREE_NODE_ROOT)) {
+      count++;
+    }
   }
+  return count;
+}
+#else
+/* Number of buckets migrated at a time when the set is expanded. */
+enum { MIGRATION_CHUNK = 4096 / sizeof(bucket_t) };
 
-  TRACE(TC_SET, "expanding set from %zu slots to %zu slots...",
-        (((size_t)1) << local_seen->size_exponent) / sizeof(slot_t),
-        (((size_t)1) << (local_seen->size_exponent + 1)) / sizeof(slot_t));
+/* Values of an entry of 'struct set.migrated'. */
+enum {
+  CHUNK_PENDING = 0, /* not yet migrated */
+  CHUNK_CLOSED = 1,  /* migrated, and no probe sequence continues past it */
+  CHUNK_OPEN = 2,    /* migrated, but probe sequences may continue past it */
+};
 
-  /* Create a set of double the size. */
-  struct set *set = xmalloc(sizeof(*set));
-  set->size_exponent = local_seen->size_exponent + 1;
-  set->bucket = xcalloc(set_size(set), sizeof(set->bucket[0]));
+static size_t set_chunks(const struct set *NONNULL set) {
+  return (set_size(set) + MIGRATION_CHUNK - 1) / MIGRATION_CHUNK;
+}
 
-  /* Advertise this as the newly expanded global set. */
-  refcounted_ptr_set(&next_global_seen, set);
+#if INLINE_SET
+/* Copy a state's data into the first empty entry of a set, starting from the
+ * given line. Used for migration, when we know the state is not already
+ * present.
+ */
+static void set_line_place(struct set *NONNULL set, size_t index,
+                           const uint8_t *NONNULL data, uint8_t status) {
+  for (size_t i = index;; i = set_index(set, i + 1)) {
+    struct set_line *line = &set->bucket[i];
+    for (size_t j = 0; j < SET_LINE_ENTRIES; j++) {
+      uint8_t e = ENTRY_EMPTY;
+      if (__atomic_compare_exchange_n(&line->status[j], &e, ENTRY_BUSY, false,
+                                      __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        memcpy(line->data[j], data, STATE_SIZE_BYTES);
+        __atomic_store_n(&line->status[j], status, __ATOMIC_SEQ_CST);
+        return;
+      }
+    }
+  }
+}
 
-  /* We now need to migrate all slots from the old set to the new one, but we
-   * can do this multithreaded.
-   */
-  set_expand_unlock();
-  set_migrate();
+/* Wait for a thread that has claimed an entry to finish writing it. */
+static uint8_t set_entry_await(const uint8_t *NONNULL status) {
+  uint8_t e;
+  while ((e = __atomic_load_n(status, __ATOMIC_SEQ_CST)) == ENTRY_BUSY) {
+    /* spin */
+  }
+  return e;
 }
 
-static bool set_insert(struct state *NONNULL s, size_t *NONNULL count) {
+/* Migration for the inline layout follows the same protocol as for the
+ * pointer-based layout below, with the status byte of each entry playing the
+ * role of the slot.
+ */
+static bool set_migrate_chunk(struct set *NONNULL set, size_t chunk) {
 
-restart:;
+  struct set *next = set->next;
+  size_t start = chunk * MIGRATION_CHUNK;
+  size_t end = start + MIGRATION_CHUNK;
+  if (end > set_size(set)) {
+    end = set_size(set);
+  }
 
-  if (__atomic_load_n(&seen_count, __ATOMIC_SEQ_CST) * 100 /
-          set_size(local_seen) >=
-      SET_EXPAND_THRESHOLD)
-    set_expand();
+  bool full = false;
+  for (size_t i = start; i < end; i++) {
+    struct set_line *line = &set->bucket[i];
+    for (size_t j = 0; j < SET_LINE_ENTRIES; j++) {
+
+      /* close off an empty entry, or wait for any in-progress write */
+      uint8_t e = ENTRY_EMPTY;
+      if (!__atomic_compare_exchange_n(&line->status[j], &e, ENTRY_MIGRATED,
+                                       false, __ATOMIC_SEQ_CST,
+                                       __ATOMIC_SEQ_CST)) {
+        e = set_entry_await(&line->status[j]);
+      }
 
-  size_t index = set_index(local_seen, state_hash(s));
+      full = e >= ENTRY_FULL;
+      if (full) {
+        size_t index = set_index(next, data_hash(line->data[j]));
+        set_line_place(next, index, line->data[j], e);
+        __atomic_store_n(&line->status[j], ENTRY_MIGRATED, __ATOMIC_SEQ_CST);
+      }
+    }
+  }
 
-  size_t attempts = 0;
-  for (size_t i = index; attempts < set_size(local_seen);
-       i = set_index(local_seen, i + 1)) {
+  return full;
+}
 
-    /* Guess that the current slot is empty and try to insert here. */
-    slot_t c = slot_empty();
-    if (__atomic_compare_exchange_n(&local_seen->bucket[i], &c,
-                                    state_to_slot(s), false, __ATOMIC_SEQ_CST,
-                                    __ATOMIC_SEQ_CST)) {
-      /* Success */
-      *count = __atomic_add_fetch(&seen_count, 1, __ATOMIC_SEQ_CST);
-      TRACE(TC_SET, "added state %p, set size is now %zu", s, *count);
+/* Look for a state in a set that is being migrated. */
+static bool set_migrating_find(struct set *NONNULL set,
+                               const struct state *NONNULL s, size_t hash,
+                               uint8_t tag) {
 
-      /* The maximum possible size of the seen state set should be constrained
+  size_t attempts = 0;
+  for (size_t i = set_index(set, hash); attempts < set_size(set);) {
+
+    uint8_t m =
+        __atomic_load_n(&set->migrated[i / MIGRATION_CHUNK], __ATOMIC_SEQ_CST);
+    if (m == CHUNK_CLOSED) {
+      return false;
+    }
+    if (m == CHUNK_OPEN) {
+      size_t end = (i / MIGRATION_CHUNK + 1) * MIGRATION_CHUNK;
+      attempts += end - i;
+      i = set_index(set, end);
+      continue;
+    }
+
+    struct set_line *line = &set->bucket[i];
+    for (size_t j = 0; j < SET_LINE_ENTRIES; j++) {
+
+      /* close off the first empty entry we find, ending the search */
+      uint8_t e = ENTRY_EMPTY;
+      if (__atomic_compare_exchange_n(&line->status[j], &e, ENTRY_MIGRATED,
+                                      false, __ATOMIC_SEQ_CST,
+                                      __ATOMIC_SEQ_CST)) {
+        return false;
+      }
+
+      if (e == ENTRY_BUSY) {
+        e = set_entry_await(&line->status[j]);
+      }
+
+      if (e == tag && memcmp(line->data[j], s->data, STATE_SIZE_BYTES) == 0) {
+        return true;
+      }
+    }
+
+    attempts++;
+    i = set_index(set, i + 1);
+  }
+
+  return false;
+}
+#else
+/* Migrate a chunk of a set that is being expanded into the next set. Each
+ * state is copied into the next set before its slot is replaced with a
+ * tombstone, so a thread looking for it always finds it in one set or the
+ * other. Empty slots are replaced with tombstones too, so no further states can
+ * be inserted into the chunk. Returns whether the chunk ends in a full slot,
+ * in which case a probe sequence may continue into the following chunk.
+ */
+static bool set_migrate_chunk(struct set *NONNULL set, size_t chunk) {
+
+  struct set *next = set->next;
+  size_t start = chunk * MIGRATION_CHUNK;
+  size_t end = start + MIGRATION_CHUNK;
+  if (end > set_size(set)) {
+    end = set_size(set);
+  }
+
+  bool full = false;
+  for (size_t i = start; i < end; i++) {
+
+    /* Close off an empty slot. If this fails, the slot either holds a state or
+     * has already been closed off by a thread looking for a state.
+     */
+    slot_t s = slot_empty();
+    full = !__atomic_compare_exchange_n(&set->bucket[i], &s, slot_tombstone(),
+                                        false, __ATOMIC_SEQ_CST,
+                                        __ATOMIC_SEQ_CST) &&
+           !slot_is_tombstone(s);
+
+    /* If the slot contained a state, rehash it and insert it into the next
+     * set. Note we don't need to do any state comparisons because we know
+     * everything in the old set is unique and no thread inserts a state into
+     * the next set without first checking the old one.
+     */
+    if (full) {
+      size_t index = set_index(next, slot_hash(s));
+      for (size_t j = index;; j = set_index(next, j + 1)) {
+        slot_t c = slot_empty();
+        if (__atomic_compare_exchange_n(&next->bucket[j], &c, s, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+          break;
+        }
+      }
+      __atomic_store_n(&set->bucket[i], slot_tombstone(), __ATOMIC_SEQ_CST);
+    }
+  }
+
+  return full;
+}
+
+/* Look for a state in a set that is being migrated. The search ends at the
+ * first empty slot, which is closed off with a tombstone so the state cannot
+ * subsequently be inserted there by a thread unaware of the migration.
+ * Tombstones are otherwise skipped, as their states are in the next set.
+ */
+static bool set_migrating_find(struct set *NONNULL set, slot_t slot,
+                               size_t hash) {
+
+  size_t attempts = 0;
+  for (size_t i = set_index(set, hash); attempts < set_size(set);) {
+
+    /* Chunks that have been migrated need not be searched, but we may need to
+     * look past them.
+     */
+    uint8_t m =
+        __atomic_load_n(&set->migrated[i / MIGRATION_CHUNK], __ATOMIC_SEQ_CST);
+    if (m == CHUNK_CLOSED) {
+      return false;
+    }
+    if (m == CHUNK_OPEN) {
+      size_t end = (i / MIGRATION_CHUNK + 1) * MIGRATION_CHUNK;
+      attempts += end - i;
+      i = set_index(set, end);
+      continue;
+    }
+
+    slot_t c = __atomic_load_n(&set->bucket[i], __ATOMIC_SEQ_CST);
+
+    if (slot_is_empty(c)) {
+      if (__atomic_compare_exchange_n(&set->bucket[i], &c, slot_tombstone(),
+                                      false, __ATOMIC_SEQ_CST,
+                                      __ATOMIC_SEQ_CST)) {
+        return false;
+      }
+      /* someone else wrote this slot in the meantime, so reexamine it */
+      continue;
+    }
+
+    if (!slot_is_tombstone(c) && slot_eq(slot, c)) {
+      return true;
+    }
+
+    attempts++;
+    i = set_index(set, i + 1);
+  }
+
+  return false;
+}
+#endif
+
+/* Take part in migrating a set that is being expanded, by migrating its next
+ * unclaimed chunk if there is one. Returns true if the migration is complete
+ * and the next set has become the current one.
+ */
+static bool set_migrate_step(struct set *NONNULL set) {
+
+  size_t chunks = set_chunks(set);
+
+  size_t chunk =
+      __atomic_fetch_add(&set->migration_claimed, 1, __ATOMIC_SEQ_CST);
+  if (chunk < chunks) {
+
+    TRACE(TC_SET, "migrating chunk %zu of %zu...", chunk, chunks);
+    bool open = set_migrate_chunk(set, chunk);
+    __atomic_store_n(&set->migrated[chunk], open ? CHUNK_OPEN : CHUNK_CLOSED,
+                     __ATOMIC_SEQ_CST);
+
+    if (__atomic_add_fetch(&set->migration_finished, 1, __ATOMIC_SEQ_CST) ==
+        chunks) {
+      /* We migrated the last chunk, so the next set becomes the current one. */
+      TRACE(TC_SET, "completed migration to set of %zu slots",
+            set_size(set->next));
+      set_expand_lock();
+      ASSERT(global_seen == set && "completed migration of a non-current set");
+      __atomic_store_n(&global_seen, set->next, __ATOMIC_SEQ_CST);
+      set_expand_unlock();
+    }
+  }
+
+  return __atomic_load_n(&global_seen, __ATOMIC_SEQ_CST) != set;
+}
+
+/* When this thread next needs to check whether the set should be expanded, in
+ * terms of its own occupancy shard. Rather than summing the shards on every
+ * insertion, each thread waits until it has inserted enough states that the
+ * set could have reached the threshold had every thread done the same.
+ */
+static _Thread_local size_t seen_check_at;
+
+/* Move on from a set whose migration is complete to the next one. */
+static void set_advance(void) {
+  set_expand_lock();
+  struct set *set = local_seen;
+  local_seen = set->next;
+  local_seen->users++;
+  ASSERT(set->users > 0 && "moving off a set no one was using");
+  set->users--;
+  set_reclaim();
+  set_expand_unlock();
+
+  /* check occupancy against the new set's capacity on our next insertion */
+  seen_check_at = 0;
+}
+
+/* Has the set reached the occupancy threshold at which it should be expanded?
+ */
+static bool set_expand_due(void) {
+
+  size_t local = seen_count_shard[thread_id].value;
+  if (local < seen_check_at) {
+    return false;
+  }
+
+#if MEMORY_LIMIT > 0
+  /* If states are about to be evicted, keep filling the set until then. */
+  if (__atomic_load_n(&eviction_pending, __ATOMIC_SEQ_CST)) {
+    return false;
+  }
+#endif
+
+  /* the smallest occupancy at or above the threshold */
+  size_t capacity = set_size(local_seen) * SET_LINE_ENTRIES;
+  size_t limit = capacity / 100 * SET_EXPAND_THRESHOLD +
+                 (capacity % 100 * SET_EXPAND_THRESHOLD + 99) / 100;
+
+  size_t count = set_occupancy();
+  if (count >= limit) {
+    return true;
+  }
+  size_t headroom = limit - count;
+
+#if MEMORY_LIMIT > 0
+  /* Each insertion adds at most one pending state, so we can also wait until
+   * enough have been inserted to reach the memory limit.
+   */
+  size_t used = memory_used(local_seen);
+  if (used >= (size_t)MEMORY_LIMIT) {
+    return true;
+  }
+  if (((size_t)MEMORY_LIMIT - used) / PENDING_STATE_SIZE < headroom) {
+    headroom = ((size_t)MEMORY_LIMIT - used) / PENDING_STATE_SIZE + 1;
+  }
+#endif
+
+  seen_check_at = local + (headroom + THREADS - 1) / THREADS;
+  return false;
+}
+
+static void set_expand(void) {
+
+  /* Using double-checked locking, we look to see if someone else has already
+   * expanded the set. We do this by first checking before acquiring the set
+   * mutex, and then later again checking after we've acquired the mutex. The
+   * idea here is that, with multiple threads, you'll frequently find someone
+   * else beat you to expansion and you can go straight to helping them with
+   * migration without having the expense of acquiring the set mutex.
+   */
+  if (__atomic_load_n(&local_seen->next, __ATOMIC_SEQ_CST) != NULL) {
+    TRACE(TC_SET, "attempted expansion failed because another thread got there "
+                  "first");
+    return;
+  }
+
+  set_expand_lock();
+
+  /* Check again, as described above. */
+  if (local_seen->next != NULL) {
+    set_expand_unlock();
+    TRACE(TC_SET, "attempted expansion failed because another thread got there "
+                  "first");
+    return;
+  }
+
+#if MEMORY_LIMIT > 0
+  /* If the set and the one it would be expanded into would exceed the memory
+   * limit, evict states from it instead. This waits until every thread has
+   * reached the top of its exploration loop (see 'eviction_poll'), so other
+   * threads carry on filling the set until then. Only if the set becomes
+   * completely full in the meantime, when we are called again, is it expanded
+   * regardless.
+   */
+  if (!__atomic_load_n(&eviction_pending, __ATOMIC_SEQ_CST) &&
+      memory_used(local_seen) + 2 * set_size(local_seen) *
+                                    sizeof(local_seen->bucket[0]) >
+          (size_t)MEMORY_LIMIT) {
+    __atomic_store_n(&eviction_pending, true, __ATOMIC_SEQ_CST);
+    set_expand_unlock();
+    TRACE(TC_SET, "set of %zu slots reached the memory limit",
+          set_size(local_seen));
+    return;
+  }
+#endif
+
+  TRACE(TC_SET, "expanding set from %zu slots to %zu slots...",
+        set_size(local_seen), set_size(local_seen) * 2);
+
+  /* Create a set of double the size. */
+  struct set *set = xcalloc(1, sizeof(*set));
+  set->size_exponent = local_seen->size_exponent + 1;
+  set_allocate(set);
+
+  local_seen->migrated =
+      xcalloc(set_chunks(local_seen), sizeof(local_seen->migrated[0]));
+
+  /* Advertise this as the set being expanded into. Threads will now migrate
+   * the old set's contents into it as they insert.
+   */
+  __atomic_store_n(&local_seen->next, set, __ATOMIC_SEQ_CST);
+
+  set_expand_unlock();
+}
+
+/* Start fetching the bucket a state with the given hash will first probe. The
+ * explorer calls this for a batch of new states before inserting any of them,
+ * so the cache misses of their insertions overlap.
+ */
+static __attribute__((unused)) void set_prefetch(size_t hash) {
+  __builtin_prefetch(&local_seen->bucket[set_index(local_seen, hash)], 1);
+}
+
+#if INLINE_SET
+static size_t set_hash(const struct state *NONNULL s) {
+  return state_hash(s);
+}
+
+static bool set_insert_hashed(struct state *NONNULL s, size_t hash,
+                              size_t *NONNULL count) {
+
+  /* derive a tag from the high bits of the hash that are not used for
+   * indexing
+   */
+  uint8_t tag =
+      (uint8_t)(ENTRY_FULL + (hash >> (sizeof(hash) * CHAR_BIT - 8)) %
+                                 (UINT8_MAX - ENTRY_FULL + 1));
+
+restart:;
+
+  /* See the pointer-based layout below for how insertion proceeds during an
+   * expansion.
+   */
+  struct set *set = local_seen;
+  struct set *next = __atomic_load_n(&set->next, __ATOMIC_SEQ_CST);
+  if (next != NULL) {
+    if (set_migrate_step(set)) {
+      set_advance();
+      goto restart;
+    }
+    if (set_migrating_find(set, s, hash, tag)) {
+      TRACE(TC_SET, "skipped adding state %p that was already in set", s);
+      return false;
+    }
+    set = next;
+  } else if (set_expand_due()) {
+    set_expand();
+    goto restart;
+  }
+
+  size_t index = set_index(set, hash);
+
+  size_t attempts = 0;
+  for (size_t i = index; attempts < set_size(set); i = set_index(set, i + 1)) {
+
+    struct set_line *line = &set->bucket[i];
+    for (size_t j = 0; j < SET_LINE_ENTRIES; j++) {
+
+      /* Guess that the current entry is empty and try to claim it. */
+      uint8_t e = ENTRY_EMPTY;
+      if (__atomic_compare_exchange_n(&line->status[j], &e, ENTRY_BUSY, false,
+                                      __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        memcpy(line->data[j], s->data, STATE_SIZE_BYTES);
+        __atomic_store_n(&line->status[j], tag, __ATOMIC_SEQ_CST);
+
+        *count = seen_count_add();
+        TRACE(TC_SET, "added state %p, this thread has added %zu", s, *count);
+
+        if (STATE_SIZE_BITS < sizeof(size_t) * CHAR_BIT) {
+          assert(*count <= ((size_t)1) << STATE_SIZE_BITS &&
+                 "seen set size "
+                 "exceeds total possible number of states");
+        }
+
+        size_t depth = 0;
+#if BOUND > 0
+        depth = (size_t)state_bound_get(s);
+#endif
+        register_allocation(depth);
+
+        return true;
+      }
+
+      if (e == ENTRY_BUSY) {
+        e = set_entry_await(&line->status[j]);
+      }
+
+      if (e == ENTRY_MIGRATED) {
+        /* This set has begun being expanded since we looked. Restart our
+         * insertion attempt, accounting for the expansion.
+         */
+        goto restart;
+      }
+
+      /* If we find this already in the set, we're done. */
+      if (e == tag && memcmp(line->data[j], s->data, STATE_SIZE_BYTES) == 0) {
+        TRACE(TC_SET, "skipped adding state %p that was already in set", s);
+        return false;
+      }
+    }
+
+    attempts++;
+  }
+
+  /* If we reach here, the set is full. Expand it and retry the insertion. */
+  set_expand();
+  goto restart;
+}
+#else
+static bool set_insert_hashed(struct state *NONNULL s, size_t hash,
+                              size_t *NONNULL count) {
+
+#if INCREMENTAL_HASH
+  /* remember the hash for hashing successors and migrating the set */
+  state_store_hash(s, (uint64_t)hash);
+#endif
+
+  slot_t slot = state_to_slot(s, hash);
+
+restart:;
+
+  struct set *set = local_seen;
+  struct set *next = __atomic_load_n(&set->next, __ATOMIC_SEQ_CST);
+  if (next != NULL) {
+    /* The set is being expanded. Do our share of the migration, moving on to
+     * the next set if it is complete.
+     */
+    if (set_migrate_step(set)) {
+      set_advance();
+      goto restart;
+    }
+
+    /* The state may be in either set. If it is not in the old one, we insert
+     * it into the next one.
+     */
+    if (set_migrating_find(set, slot, hash)) {
+      TRACE(TC_SET, "skipped adding state %p that was already in set", s);
+      return false;
+    }
+    set = next;
+  } else if (set_expand_due()) {
+    set_expand();
+    goto restart;
+  }
+
+  size_t index = set_index(set, hash);
+
+  size_t attempts = 0;
+  for (size_t i = index; attempts < set_size(set); i = set_index(set, i + 1)) {
+
+    /* Guess that the current slot is empty and try to insert here. */
+    slot_t c = slot_empty();
+    if (__atomic_compare_exchange_n(&set->bucket[i], &c, slot, false,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      /* Success */
+      *count = seen_count_add();
+      TRACE(TC_SET, "added state %p, this thread has added %zu", s, *count);
+#if MEMORY_LIMIT > 0
+      eviction_note_insert(slot);
+#endif
+
+      /* The maximum possible size of the seen state set should be constrained
        * by the number of possible states based on how many bits we are using to
        * represent the state data.
        */
-      if (STATE_SIZE_BITS < sizeof(size_t) * CHAR_BIT) {
+      if (MEMORY_LIMIT == 0 && STATE_SIZE_BITS < sizeof(size_t) * CHAR_BIT) {
         assert(*count <= ((size_t)1) << STATE_SIZE_BITS &&
                "seen set size "
                "exceeds total possible number of states");
@@ -3473,214 +5060,1933 @@ restart:;
 #endif
       register_allocation(depth);
 
-      return true;
-    }
+      return true;
+    }
+
+    if (slot_is_tombstone(c)) {
+      /* This set has begun being expanded since we looked. Restart our
+       * insertion attempt, accounting for the expansion.
+       */
+      goto restart;
+    }
+
+    /* If we find this already in the set, we're done. */
+    if (slot_eq(slot, c)) {
+#if MEMORY_LIMIT > 0
+      slot_visit(&set->bucket[i], c);
+#endif
+      TRACE(TC_SET, "skipped adding state %p that was already in set", s);
+      return false;
+    }
+
+    attempts++;
+  }
+
+  /* If we reach here, the set is full. Expand it and retry the insertion. */
+  set_expand();
+  goto restart;
+}
+
+/* Find an existing element in the set.
+ *
+ * Why would you ever want to do this? If you already have the state, why do you
+ * want to find a copy of it? The answer is for liveness information. When
+ * checking liveness properties, a duplicate of your current state that is
+ * already contained in the state set might know some of the liveness properties
+ * are satisfied that your current state considers unknown.
+ */
+#if HASH_COMPACTION_BITS == 0
+static __attribute__((unused)) const struct state *
+set_find(const struct state *NONNULL s) {
+
+  assert(s != NULL);
+
+  size_t hash = set_hash(s);
+  slot_t target = state_to_slot(s, hash);
+  size_t index = set_index(local_seen, hash);
+
+  size_t attempts = 0;
+  for (size_t i = index; attempts < set_size(local_seen);
+       i = set_index(local_seen, i + 1)) {
+
+    slot_t slot = __atomic_load_n(&local_seen->bucket[i], __ATOMIC_SEQ_CST);
+
+    /* This function is only expected to be called during the final liveness
+     * scan, in which all threads participate. So we should never encounter a
+     * set undergoing migration.
+     */
+    ASSERT(!slot_is_tombstone(slot) &&
+           "tombstone encountered during final phase");
+
+    if (slot_is_empty(slot)) {
+      /* reached the end of the linear block in which this state could lie */
+      break;
+    }
+
+    if (slot_eq(target, slot)) {
+      /* found */
+      const struct state *n = slot_to_state(slot);
+      ASSERT(n != NULL && "null pointer stored in state set");
+      return n;
+    }
+
+    attempts++;
+  }
+
+  /* not found */
+  return NULL;
+}
+#endif
+#endif
+#endif
+
+/* Complete any expansion of the set in progress and deallocate sets that have
+ * been superseded. Only safe to call when no other threads are using the set.
+ */
+static void set_settle(void) {
+#if BITSTATE_HASHES == 0 && !TREE_COMPRESSION && !EXTERNAL_MEMORY
+  if (global_seen->next != NULL) {
+    while (!set_migrate_step(global_seen)) {
+      /* keep migrating */
+    }
+  }
+#endif
+  set_expand_lock();
+  set_reclaim();
+  set_expand_unlock();
+}
+
+#if MEMORY_LIMIT > 0
+/*******************************************************************************
+ * State caching                                                               *
+ *                                                                             *
+ * With --memory-limit, once the seen set can no longer be expanded within the *
+ * limit, states are evicted from it to make room for new ones, as in the      *
+ * state caching of SPIN and Murphi. An evicted state that is reached again is *
+ * explored again. States are evicted in rounds while all other threads wait,  *
+ * so that states still pending can be found and kept, as evicting one of      *
+ * these would let it be queued twice. Each round evicts the lowest scoring    *
+ * states (see SLOT_SCORE_SHIFT) until the set is four fifths as full as the   *
+ * occupancy at which it would be expanded. If the pending states alone        *
+ * outgrow the limit, or several rounds in a row go by without any state being *
+ * found that was not evicted before, the search is not going to converge      *
+ * within the limit and is abandoned.                                          *
+ ******************************************************************************/
+
+/* Number of rounds in a row without progress before giving up. */
+enum { EVICTION_STALL_LIMIT = 16 };
+
+/* Number of threads waiting to evict states. */
+static size_t eviction_arrivals;
+
+/* Number of rounds in a row that found no state not evicted before. */
+static size_t eviction_stalls;
+
+/* Pin the slots of all pending states, so they are not evicted. */
+static void eviction_pin_pending(struct set *NONNULL set) {
+  for (size_t i = 0; i < sizeof(q) / sizeof(q[0]); i++) {
+    for (size_t j = q[i].top; j < q[i].bottom; j++) {
+      const struct state *s = q[i].array->s[j & (q[i].array->size - 1)];
+      slot_t slot = (slot_t)set_hash(s);
+      for (size_t k = set_index(set, slot_hash(slot));;
+           k = set_index(set, k + 1)) {
+        ASSERT(!slot_is_empty(set->bucket[k]) && "pending state not in set");
+        if (slot_eq(set->bucket[k], slot)) {
+          set->bucket[k] |= SLOT_PINNED;
+          break;
+        }
+      }
+    }
+  }
+}
+
+/* Evict states from the set. Called by the leader of a rendezvous, so all
+ * other threads are waiting and the set is not being expanded.
+ */
+static void eviction_round(void) {
+
+  struct set *set = global_seen;
+  bucket_t *bucket = set->bucket;
+  size_t size = set_size(set);
+
+  if (evicted_filter != NULL && !eviction_progress) {
+    eviction_stalls++;
+    if (eviction_stalls == EVICTION_STALL_LIMIT) {
+      fprintf(stderr,
+              "memory limit too small to converge: %zu rounds of eviction in a "
+              "row found no state that had not been evicted before; rerun "
+              "with a larger --memory-limit\n",
+              eviction_stalls);
+      exit(EXIT_FAILURE);
+    }
+  } else {
+    eviction_stalls = 0;
+  }
+  eviction_progress = false;
+
+  size_t used = memory_used(set);
+  if (used > (size_t)MEMORY_LIMIT) {
+    fprintf(stderr,
+            "memory limit too small to converge: the seen set and %zu pending "
+            "states, which cannot be evicted, need %zu bytes; rerun with a "
+            "larger --memory-limit\n",
+            queue_length(), used);
+    exit(EXIT_FAILURE);
+  }
+
+  if (evicted_filter == NULL) {
+    evicted_filter = xcalloc(evicted_filter_size(), 1);
+  }
+
+  eviction_pin_pending(set);
+
+  /* Count the states that could be evicted by their score. */
+  size_t histogram[SLOT_SCORE_MAX + 1] = {0};
+  size_t occupancy = 0;
+  size_t pinned = 0;
+  for (size_t i = 0; i < size; i++) {
+    if (!slot_is_empty(bucket[i])) {
+      occupancy++;
+      if (bucket[i] & SLOT_PINNED) {
+        pinned++;
+      } else {
+        histogram[slot_score(bucket[i])]++;
+      }
+    }
+  }
+
+  /* the occupancy at which the set would be expanded, and that to reduce it
+   * to
+   */
+  size_t limit = size / 100 * SET_EXPAND_THRESHOLD +
+                 (size % 100 * SET_EXPAND_THRESHOLD + 99) / 100;
+  size_t target = limit / 5 * 4 + limit % 5 * 4 / 5;
+
+  if (pinned >= limit) {
+    fprintf(stderr,
+            "memory limit too small to converge: %zu pending states, which "
+            "cannot be evicted, fill the seen set; rerun with a larger "
+            "--memory-limit\n",
+            pinned);
+    exit(EXIT_FAILURE);
+  }
+
+  /* Find the score below which every unpinned state is evicted, and how many
+   * with exactly that score are evicted too.
+   */
+  size_t excess = occupancy > target ? occupancy - target : 0;
+  if (excess > occupancy - pinned) {
+    excess = occupancy - pinned;
+  }
+  unsigned cutoff = 0;
+  size_t below = 0;
+  while (below + histogram[cutoff] < excess) {
+    below += histogram[cutoff];
+    cutoff++;
+  }
+  size_t at_cutoff = excess - below;
+
+  /* Find an empty slot to start reinsertion from below. This must be one that
+   * was empty before evicting, as a probe sequence may run through an evicted
+   * slot.
+   */
+  size_t start = 0;
+  while (!slot_is_empty(bucket[start])) {
+    start++;
+  }
+
+  /* Evict states, recording them in the filter, and decay the scores of those
+   * that remain.
+   */
+  size_t evicted = 0;
+  for (size_t i = 0; i < size; i++) {
+    slot_t c = bucket[i];
+    if (slot_is_empty(c)) {
+      continue;
+    }
+    unsigned score = slot_score(c);
+    if (!(c & SLOT_PINNED) &&
+        (score < cutoff || (score == cutoff && at_cutoff > 0))) {
+      if (score == cutoff) {
+        at_cutoff--;
+      }
+      size_t f = evicted_filter_index(c);
+      evicted_filter[f / CHAR_BIT] |= (uint8_t)(1u << (f % CHAR_BIT));
+      bucket[i] = slot_empty();
+      evicted++;
+      continue;
+    }
+    bucket[i] = slot_with_score(c & ~SLOT_PINNED, score > 0 ? score - 1 : 0);
+  }
+
+  /* Evicted states leave gaps in the probe sequences of the states after them.
+   * Close these by reinserting every state, going round the set from the slot
+   * found empty above, which no probe sequence crosses, so each state is
+   * reinserted after those earlier in its probe sequence.
+   */
+  for (size_t i = 1; i < size; i++) {
+    size_t index = set_index(set, start + i);
+    slot_t c = bucket[index];
+    if (slot_is_empty(c)) {
+      continue;
+    }
+    bucket[index] = slot_empty();
+    size_t j = set_index(set, slot_hash(c));
+    while (!slot_is_empty(bucket[j])) {
+      j = set_index(set, j + 1);
+    }
+    bucket[j] = c;
+  }
+
+  eviction_rounds++;
+  __atomic_fetch_add(&evicted_count, evicted, __ATOMIC_SEQ_CST);
+
+  TRACE(TC_SET, "evicted %zu of %zu states from set of %zu slots", evicted,
+        occupancy, size);
+}
+
+static void eviction_action(void) {
+
+  /* Complete any expansion of the set in progress, so there is a single set
+   * to evict from, and return claimed states to the queues so all pending
+   * states can be found and kept.
+   */
+  set_settle();
+  queue_settle();
+
+  /* Only evict if all threads arrived here to do so. Otherwise we were woken
+   * by a thread exiting, and the others will retry.
+   */
+  if (eviction_arrivals == running_count) {
+    eviction_round();
+    __atomic_store_n(&eviction_pending, false, __ATOMIC_SEQ_CST);
+  }
+}
+
+/* Called from the top of the exploration loop to check whether states need to
+ * be evicted from the seen set, and take part in it if so.
+ */
+static void eviction_poll(void) {
+
+  if (!__atomic_load_n(&eviction_pending, __ATOMIC_SEQ_CST)) {
+    return;
+  }
+
+  /* Let go of the seen set, as it may be replaced while settling any expansion
+   * in progress.
+   */
+  set_thread_release();
+
+  __atomic_add_fetch(&eviction_arrivals, 1, __ATOMIC_SEQ_CST);
+  rendezvous(eviction_action);
+  __atomic_sub_fetch(&eviction_arrivals, 1, __ATOMIC_SEQ_CST);
+
+  set_thread_init();
+}
+#endif
+
+/******************************************************************************/
+
+static time_t START_TIME;
+
+static unsigned long long gettime() {
+  return (unsigned long long)(time(NULL) - START_TIME);
+}
+
+#if EXTERNAL_MEMORY
+/*******************************************************************************
+ * External memory exploration                                                 *
+ *                                                                             *
+ * With --external-memory, the frontier and the seen set are kept in files on  *
+ * disk, following Stern & Dill, "Using magnetic disk instead of main memory   *
+ * in the Murphi verifier" in CAV 1998. Exploration proceeds breadth-first,    *
+ * one layer at a time. Successors are gathered into an in-memory table that   *
+ * removes duplicates within a batch. When this table fills, or a layer is     *
+ * finished, the batch is sorted and merged against the sorted file of seen    *
+ * states. States not already seen are added to it and appended to the file    *
+ * of states for the next layer. Only a single thread is supported.            *
+ ******************************************************************************/
+
+/* Prototype for a generated function. */
+static bool check_covers(const struct state *NONNULL s);
+
+/* A single queue for compatibility with the round-robin logic in init(). */
+static struct {
+  size_t count;
+} q[1];
+
+/* Files of seen states, sorted by their data. The current one is merged with
+ * each batch to produce the other, at which point they swap roles.
+ */
+static FILE *external_seen[2];
+static size_t external_seen_current;
+static size_t external_seen_count;
+
+/* Files of states in the layer being explored and the next layer. */
+static FILE *external_frontier[2];
+static size_t external_frontier_current;
+static size_t external_frontier_remaining;
+static size_t external_frontier_next_count;
+
+/* Table of states inserted since the last merge. */
+enum { EXTERNAL_BATCH_CAPACITY = SET_CAPACITY / (STATE_SIZE_BYTES + 1) };
+static uint8_t (*external_batch)[STATE_SIZE_BYTES];
+static bool *external_batch_used;
+static size_t external_batch_count;
+
+/* Number of batches merged into the seen states, reported at the end. */
+static size_t external_merges;
+
+static _Noreturn void external_fail(const char *NONNULL operation) {
+  fprintf(stderr, "%s failed: %s\n", operation, strerror(errno));
+  exit(EXIT_FAILURE);
+}
+
+static FILE *external_open(void) {
+
+  char path[PATH_MAX];
+  if (snprintf(path, sizeof(path), "%s/rumur-XXXXXX", EXTERNAL_MEMORY_DIR) >=
+      (int)sizeof(path)) {
+    fprintf(stderr, "path in %s is too long\n", EXTERNAL_MEMORY_DIR);
+    exit(EXIT_FAILURE);
+  }
+
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    external_fail("mkstemp");
+  }
+
+  /* Unlink the file immediately so it is cleaned up whenever we exit. */
+  (void)unlink(path);
+
+  FILE *f = fdopen(fd, "w+b");
+  if (f == NULL) {
+    external_fail("fdopen");
+  }
+  return f;
+}
+
+static void external_init(void) {
+
+  external_batch = xcalloc(EXTERNAL_BATCH_CAPACITY, sizeof(external_batch[0]));
+  external_batch_used =
+      xcalloc(EXTERNAL_BATCH_CAPACITY, sizeof(external_batch_used[0]));
+
+  for (size_t i = 0; i < 2; i++) {
+    external_seen[i] = external_open();
+    external_frontier[i] = external_open();
+  }
+}
+
+static bool external_read(FILE *NONNULL f, uint8_t *NONNULL data) {
+  if (fread(data, STATE_SIZE_BYTES, 1, f) != 1) {
+    if (ferror(f)) {
+      external_fail("fread");
+    }
+    return false;
+  }
+  return true;
+}
+
+static void external_write(FILE *NONNULL f, const uint8_t *NONNULL data) {
+  if (fwrite(data, STATE_SIZE_BYTES, 1, f) != 1) {
+    external_fail("fwrite");
+  }
+}
+
+static int external_compare(const void *a, const void *b) {
+  return memcmp(a, b, STATE_SIZE_BYTES);
+}
+
+static size_t queue_enqueue(struct state *NONNULL s, size_t queue_id) {
+  assert(queue_id < sizeof(q) / sizeof(q[0]) && "out of bounds queue access");
+
+  external_write(external_frontier[!external_frontier_current], s->data);
+  external_frontier_next_count++;
+
+  /* the state's data is on disk now, so we no longer need it in memory */
+  state_free(s);
+
+  size_t count = external_frontier_remaining + external_frontier_next_count;
+  q[queue_id].count = count;
+
+  TRACE(TC_QUEUE, "enqueued state into queue %zu, queue length is now %zu",
+        queue_id, count);
+
+  return count;
+}
+
+static size_t queue_enqueue_batch(struct state *NONNULL *NONNULL s,
+                                  size_t count, size_t queue_id) {
+  size_t length = 0;
+  for (size_t i = 0; i < count; i++) {
+    length = queue_enqueue(s[i], queue_id);
+  }
+  return length;
+}
+
+/* Merge the current batch into the seen states on disk, queueing those that
+ * were not previously seen.
+ */
+static void external_merge(void) {
+
+  if (external_batch_count == 0) {
+    return;
+  }
+
+  /* compact the batch to the front of the table and sort it */
+  size_t n = 0;
+  for (size_t i = 0; i < EXTERNAL_BATCH_CAPACITY; i++) {
+    if (external_batch_used[i]) {
+      if (i != n) {
+        memcpy(external_batch[n], external_batch[i], STATE_SIZE_BYTES);
+      }
+      external_batch_used[i] = false;
+      n++;
+    }
+  }
+  assert(n == external_batch_count && "miscounted states in external batch");
+  qsort(external_batch, n, sizeof(external_batch[0]), external_compare);
+  external_merges++;
+
+  FILE *in = external_seen[external_seen_current];
+  FILE *out = external_seen[!external_seen_current];
+  rewind(in);
+  rewind(out);
+
+  /* The output is at least as long as the input, so we can simply overwrite
+   * any stale content from previous merges without truncating.
+   */
+  size_t in_remaining = external_seen_count;
+  uint8_t current[STATE_SIZE_BYTES];
+  bool have_current = in_remaining > 0 && external_read(in, current);
+
+  for (size_t i = 0; i < n; i++) {
+
+    while (have_current && memcmp(current, external_batch[i],
+                                  STATE_SIZE_BYTES) < 0) {
+      external_write(out, current);
+      in_remaining--;
+      have_current = in_remaining > 0 && external_read(in, current);
+    }
+
+    if (have_current &&
+        memcmp(current, external_batch[i], STATE_SIZE_BYTES) == 0) {
+      /* already seen */
+      continue;
+    }
+
+    external_write(out, external_batch[i]);
+    external_seen_count++;
+    (void)seen_count_add();
+
+    struct state *s = state_new();
+    memset(s, 0, sizeof(*s));
+    memcpy(s->data, external_batch[i], STATE_SIZE_BYTES);
+
+    if (!check_covers(s)) {
+      /* one of the cover properties triggered an error */
+      state_free(s);
+      continue;
+    }
+
+    (void)queue_enqueue(s, 0);
+  }
+
+  while (have_current) {
+    external_write(out, current);
+    in_remaining--;
+    have_current = in_remaining > 0 && external_read(in, current);
+  }
+
+  if (fflush(out) != 0) {
+    external_fail("fflush");
+  }
+  external_seen_current = !external_seen_current;
+  external_batch_count = 0;
+}
+
+/* Whether a state is new is only known once its batch is merged, at which
+ * point check_covers() and queue_enqueue() are called for it. So insertion
+ * always claims the state was already seen, and the caller discards it.
+ */
+static size_t set_hash(const struct state *NONNULL s) {
+  return state_hash(s);
+}
+
+static __attribute__((unused)) void set_prefetch(size_t hash) {
+  __builtin_prefetch(&external_batch[hash % EXTERNAL_BATCH_CAPACITY], 1);
+}
+
+static bool set_insert_hashed(struct state *NONNULL s, size_t hash,
+                              size_t *NONNULL count) {
+
+  if (external_batch_count * 100 / EXTERNAL_BATCH_CAPACITY >=
+      SET_EXPAND_THRESHOLD) {
+    external_merge();
+  }
+
+  size_t index = hash % EXTERNAL_BATCH_CAPACITY;
+  for (;;) {
+    if (!external_batch_used[index]) {
+      memcpy(external_batch[index], s->data, STATE_SIZE_BYTES);
+      external_batch_used[index] = true;
+      external_batch_count++;
+      break;
+    }
+    if (memcmp(external_batch[index], s->data, STATE_SIZE_BYTES) == 0) {
+      break;
+    }
+    index = (index + 1) % EXTERNAL_BATCH_CAPACITY;
+  }
+
+  *count = seen_count();
+  return false;
+}
+
+static void external_progress(size_t queue_size) {
+  if (MACHINE_READABLE_OUTPUT) {
+    put("<progress states=\"");
+    put_uint(seen_count());
+    put("\" duration_seconds=\"");
+    put_uint(gettime());
+    put("\" rules_fired=\"");
+    put_uint(rules_fired_local);
+    put("\" queue_size=\"");
+    put_uint(queue_size);
+    put("\" thread_id=\"");
+    put_uint(thread_id);
+    put("\"/>\n");
+  } else {
+    put("\t ");
+    put_uint(seen_count());
+    put(" states explored in ");
+    put_uint(gettime());
+    put("s, with ");
+    put_uint(rules_fired_local);
+    put(" rules fired and ");
+    put_uint(queue_size);
+    put(" states in the queue.\n");
+  }
+}
+
+static const struct state *queue_dequeue(size_t *NONNULL queue_id) {
+  assert(queue_id != NULL && *queue_id < sizeof(q) / sizeof(q[0]) &&
+         "out of bounds queue access");
+
+  if (external_frontier_remaining == 0) {
+    /* We have finished a layer. Find which of its successors are new and move
+     * on to them.
+     */
+    external_merge();
+
+    if (external_frontier_next_count == 0) {
+      return NULL;
+    }
+
+    external_frontier_current = !external_frontier_current;
+    external_frontier_remaining = external_frontier_next_count;
+    external_frontier_next_count = 0;
+    rewind(external_frontier[external_frontier_current]);
+    rewind(external_frontier[!external_frontier_current]);
+
+    /* report progress each time we pass another 10000 states */
+    static size_t last_report;
+    if (seen_count() / 10000 > last_report / 10000) {
+      external_progress(external_frontier_remaining);
+      last_report = seen_count();
+    }
+  }
+
+  struct state *s = state_new();
+  memset(s, 0, sizeof(*s));
+  if (!external_read(external_frontier[external_frontier_current], s->data)) {
+    fprintf(stderr, "unexpected end of external memory frontier\n");
+    exit(EXIT_FAILURE);
+  }
+  external_frontier_remaining--;
+  q[*queue_id].count = external_frontier_remaining;
+
+  TRACE(TC_QUEUE, "dequeued state %p from queue %zu", s, *queue_id);
+
+  return s;
+}
+#endif
+
+/* Insert a state into the seen set, returning true if it was not already
+ * present. This is for callers that have not already hashed the state with
+ * set_hash().
+ */
+static bool set_insert(struct state *NONNULL s, size_t *NONNULL count) {
+  return set_insert_hashed(s, set_hash(s), count);
+}
+
+/* Equivalent to set_hash(), for a successor of a state already in the set. */
+static __attribute__((unused)) size_t
+set_hash_successor(const struct state *NONNULL s,
+                   const struct state *NONNULL parent
+                   __attribute__((unused))) {
+#if INCREMENTAL_HASH
+  return state_hash_from(s, parent);
+#else
+  return set_hash(s);
+#endif
+}
+
+#if CHECKPOINT || RESUME
+/*******************************************************************************
+ * Checkpointing                                                               *
+ *                                                                             *
+ * With --checkpoint, the seen set, the queued states and the counters         *
+ * reported at the end of the run are periodically written to a file, from     *
+ * which a verifier generated with --resume can continue exploration. A        *
+ * checkpoint is only taken when every running thread is at the top of its     *
+ * exploration loop, so no states are in flight. Counterexample traces and     *
+ * liveness are not supported, so states contain no pointers and can be        *
+ * written out as-is.                                                          *
+ *                                                                             *
+ * The header records the model and configuration the checkpoint belongs to,   *
+ * including every setting that changes how the seen set encodes its slots, so *
+ * a checkpoint is only resumed into an identical set. It is followed by a     *
+ * checksum of itself, so a damaged header is detected before anything is      *
+ * sized from it, and the file ends with a checksum of everything before it.   *
+ ******************************************************************************/
+
+struct checkpoint_header {
+  char magic[8];
+  uint64_t model_fingerprint;
+  uint64_t state_size_bits;
+  uint64_t state_size;
+  uint64_t hash_function;
+  uint64_t bucket_size;
+  uint64_t hash_compaction_bits;
+  uint64_t bitstate_hashes;
+  uint64_t inline_set;
+  uint64_t tree_compression;
+  uint64_t max_states;
+  uint64_t set_size_exponent;
+  uint64_t seen_count;
+  uint64_t queue_count;
+  uint64_t rules_fired;
+  uint64_t error_count;
+  uint64_t cover_count;
+};
+
+static const char CHECKPOINT_MAGIC[8] = "rumurckp";
+
+/* Running checksum (64-bit FNV-1a) of the checkpoint data written or read so
+ * far.
+ */
+static uint64_t checkpoint_sum;
+
+static void checkpoint_sum_update(const void *NONNULL p, size_t size) {
+  const unsigned char *data = p;
+  for (size_t i = 0; i < size; i++) {
+    checkpoint_sum ^= data[i];
+    checkpoint_sum *= UINT64_C(0x100000001b3);
+  }
+}
+#endif
+
+#if CHECKPOINT
+/* Has the time for a checkpoint arrived? */
+static bool checkpoint_pending;
+
+/* When is the next checkpoint due, in seconds since START_TIME? */
+static unsigned long long checkpoint_due = CHECKPOINT_INTERVAL;
+
+/* Number of threads waiting to take a checkpoint. */
+static size_t checkpoint_arrivals;
+
+static bool checkpoint_write_all(FILE *NONNULL f, const void *NONNULL p,
+                                 size_t size) {
+  checkpoint_sum_update(p, size);
+  return size == 0 || fwrite(p, size, 1, f) == 1;
+}
+
+/* Write the checksum of everything written so far. */
+static bool checkpoint_write_sum(FILE *NONNULL f) {
+  uint64_t sum = checkpoint_sum;
+  return checkpoint_write_all(f, &sum, sizeof(sum));
+}
+
+static bool checkpoint_write_file(FILE *NONNULL f) {
+
+  /* Take all states out of the queues, remembering where they came from so we
+   * can put them back in the same order afterwards.
+   */
+  struct {
+    struct state *s;
+    size_t queue_id;
+  } *queued = NULL;
+  size_t queued_count = 0;
+  size_t queued_capacity = 0;
+  {
+    size_t queue_id = 0;
+    for (;;) {
+      const struct state *s = queue_dequeue(&queue_id);
+      if (s == NULL) {
+        break;
+      }
+      if (queued_count == queued_capacity) {
+        queued_capacity = queued_capacity == 0 ? 1024 : queued_capacity * 2;
+        queued = realloc(queued, queued_capacity * sizeof(queued[0]));
+        if (__builtin_expect(queued == NULL, 0)) {
+          oom();
+        }
+      }
+      queued[queued_count].s = state_drop_const(s);
+      queued[queued_count].queue_id = queue_id;
+      queued_count++;
+    }
+  }
+
+  uintmax_t fire_count = 0;
+  for (size_t i = 0; i < sizeof(rules_fired) / sizeof(rules_fired[0]); i++) {
+    fire_count += rules_fired[i];
+  }
+
+  struct checkpoint_header header = {
+      .model_fingerprint = MODEL_FINGERPRINT,
+      .state_size_bits = STATE_SIZE_BITS,
+      .state_size = sizeof(struct state),
+      .hash_function = (uint64_t)hash_function_used(),
+      .bucket_size = sizeof(global_seen->bucket[0]),
+      .hash_compaction_bits = HASH_COMPACTION_BITS,
+      .bitstate_hashes = BITSTATE_HASHES,
+      .inline_set = INLINE_SET,
+      .tree_compression = TREE_COMPRESSION,
+      .max_states = MAX_STATES,
+      .set_size_exponent = global_seen->size_exponent,
+      .seen_count = seen_count(),
+      .queue_count = queued_count,
+      .rules_fired = fire_count,
+      .error_count = error_count,
+      .cover_count = sizeof(covers) / sizeof(covers[0]),
+  };
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+
+  checkpoint_sum = UINT64_C(0xcbf29ce484222325);
+  bool ok = checkpoint_write_all(f, &header, sizeof(header)) &&
+            checkpoint_write_sum(f) &&
+            checkpoint_write_all(f, covers, sizeof(covers));
+
+  for (size_t i = 0; i < queued_count; i++) {
+    uint64_t queue_id = queued[i].queue_id;
+    ok = ok && checkpoint_write_all(f, &queue_id, sizeof(queue_id)) &&
+         checkpoint_write_all(f, queued[i].s, sizeof(*queued[i].s));
+    (void)queue_enqueue(queued[i].s, queued[i].queue_id);
+  }
+  free(queued);
+
+  if (SET_STORES_STATES) {
+    /* the set holds pointers, so write out the states they point at */
+#if HASH_COMPACTION_BITS == 0 && BITSTATE_HASHES == 0 && !TREE_COMPRESSION &&  \
+    !INLINE_SET
+    for (size_t i = 0; i < set_size(global_seen); i++) {
+      slot_t slot = global_seen->bucket[i];
+      if (!slot_is_empty(slot)) {
+        const struct state *s = slot_to_state(slot);
+        ok = ok && checkpoint_write_all(f, s, sizeof(*s));
+      }
+    }
+#endif
+  } else {
+    /* the set contains no pointers, so can be written out directly */
+    ok = ok && checkpoint_write_all(f, global_seen->bucket,
+                                    set_size(global_seen) *
+                                        sizeof(global_seen->bucket[0]));
+  }
+
+  return ok && checkpoint_write_sum(f);
+}
+
+/* Write a checkpoint. Called by the leader of a rendezvous, so all other
+ * threads are waiting.
+ */
+static void checkpoint_write(void) {
+
+  /* Write to a temporary file and then rename it over the checkpoint, so that
+   * being interrupted part way through never leaves an incomplete checkpoint.
+   */
+  char path[PATH_MAX];
+  if (snprintf(path, sizeof(path), "%s.tmp", CHECKPOINT_PATH) >=
+      (int)sizeof(path)) {
+    fprintf(stderr, "checkpoint path %s is too long\n", CHECKPOINT_PATH);
+    return;
+  }
+
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "failed to open %s: %s\n", path, strerror(errno));
+    return;
+  }
+
+  bool ok = checkpoint_write_file(f);
+  ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+  int err = errno;
+  ok = fclose(f) == 0 && ok;
+
+  if (!ok || rename(path, CHECKPOINT_PATH) < 0) {
+    fprintf(stderr, "failed to write checkpoint %s: %s\n", CHECKPOINT_PATH,
+            strerror(ok ? errno : err));
+    (void)unlink(path);
+    return;
+  }
+
+  if (!MACHINE_READABLE_OUTPUT) {
+    put("\t Checkpoint of ");
+    put_uint(seen_count());
+    put(" states written to ");
+    put(CHECKPOINT_PATH);
+    put(".\n");
+  }
+}
+
+static void checkpoint_action(void) {
+
+  /* Complete any expansion of the set in progress, so the checkpoint contains
+   * a single set, and return claimed states to the queues so it contains all
+   * of them.
+   */
+  set_settle();
+  queue_settle();
+
+  /* Only write a checkpoint if all threads arrived here to do so. Otherwise
+   * we were woken by a thread exiting, and the others will retry.
+   */
+  if (checkpoint_arrivals == running_count) {
+    checkpoint_write();
+    checkpoint_due = gettime() + CHECKPOINT_INTERVAL;
+    __atomic_store_n(&checkpoint_pending, false, __ATOMIC_SEQ_CST);
+  }
+}
+
+/* Called from the top of the exploration loop to check whether it is time to
+ * take a checkpoint, and take part in it if so.
+ */
+static void checkpoint_poll(void) {
+
+  /* Only check the time occasionally, as this is a hot path. */
+  static _Thread_local unsigned polls;
+  if (!__atomic_load_n(&checkpoint_pending, __ATOMIC_SEQ_CST)) {
+    polls++;
+    if (polls % 1024 != 0 ||
+        gettime() < __atomic_load_n(&checkpoint_due, __ATOMIC_SEQ_CST)) {
+      return;
+    }
+    __atomic_store_n(&checkpoint_pending, true, __ATOMIC_SEQ_CST);
+  }
+
+  /* Make our fired rule count visible to the thread writing the checkpoint. */
+  rules_fired[thread_id] = rules_fired_local;
+
+  /* Let go of the seen set, as it may be replaced while settling any expansion
+   * in progress.
+   */
+  set_thread_release();
+
+  __atomic_add_fetch(&checkpoint_arrivals, 1, __ATOMIC_SEQ_CST);
+  rendezvous(checkpoint_action);
+  __atomic_sub_fetch(&checkpoint_arrivals, 1, __ATOMIC_SEQ_CST);
+
+  set_thread_init();
+}
+#endif
+
+#if RESUME
+static void checkpoint_read_all(FILE *NONNULL f, void *NONNULL p, size_t size) {
+  if (size > 0 && fread(p, size, 1, f) != 1) {
+    fprintf(stderr, "failed to read checkpoint %s: %s\n", RESUME_PATH,
+            ferror(f) ? strerror(errno) : "unexpected end of file");
+    exit(EXIT_FAILURE);
+  }
+  checkpoint_sum_update(p, size);
+}
+
+static _Noreturn void checkpoint_corrupt(void) {
+  fprintf(stderr, "checkpoint %s is corrupt\n", RESUME_PATH);
+  exit(EXIT_FAILURE);
+}
+
+/* Read a checksum and check it matches everything read before it. */
+static void checkpoint_read_sum(FILE *NONNULL f) {
+  uint64_t expected = checkpoint_sum;
+  uint64_t sum;
+  checkpoint_read_all(f, &sum, sizeof(sum));
+  if (sum != expected) {
+    checkpoint_corrupt();
+  }
+}
+
+/* Restore the state of a previous run, in place of init(). */
+static void checkpoint_load(void) {
+
+  FILE *f = fopen(RESUME_PATH, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "failed to open %s: %s\n", RESUME_PATH, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  struct checkpoint_header header;
+  checkpoint_sum = UINT64_C(0xcbf29ce484222325);
+  checkpoint_read_all(f, &header, sizeof(header));
+  if (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) {
+    fprintf(stderr, "%s is not a checkpoint\n", RESUME_PATH);
+    exit(EXIT_FAILURE);
+  }
+  checkpoint_read_sum(f);
+  if (header.model_fingerprint != MODEL_FINGERPRINT ||
+      header.state_size_bits != STATE_SIZE_BITS ||
+      header.state_size != sizeof(struct state) ||
+      header.hash_function != (uint64_t)hash_function_used() ||
+      header.bucket_size != sizeof(local_seen->bucket[0]) ||
+      header.hash_compaction_bits != HASH_COMPACTION_BITS ||
+      header.bitstate_hashes != BITSTATE_HASHES ||
+      header.inline_set != INLINE_SET ||
+      header.tree_compression != TREE_COMPRESSION ||
+      header.max_states != MAX_STATES ||
+      header.cover_count != sizeof(covers) / sizeof(covers[0])) {
+    fprintf(stderr,
+            "%s is not a checkpoint of a verifier for this model and "
+            "configuration\n",
+            RESUME_PATH);
+    exit(EXIT_FAILURE);
+  }
+
+  checkpoint_read_all(f, covers, sizeof(covers));
+  rules_fired_local = (uintmax_t)header.rules_fired;
+  error_count = (unsigned long)header.error_count;
+
+  for (uint64_t i = 0; i < header.queue_count; i++) {
+    uint64_t queue_id;
+    checkpoint_read_all(f, &queue_id, sizeof(queue_id));
+    struct state *s = state_new();
+    checkpoint_read_all(f, s, sizeof(*s));
+    if (SET_STORES_STATES) {
+      /* insert it now so the queue and set share this copy */
+      size_t count;
+      if (!set_insert(s, &count)) {
+        /* a state cannot have been queued twice */
+        checkpoint_corrupt();
+      }
+    }
+    (void)queue_enqueue(s, (size_t)(queue_id % THREADS));
+  }
+
+  if (SET_STORES_STATES) {
+    for (uint64_t i = 0; i < header.seen_count; i++) {
+      struct state *s = state_new();
+      checkpoint_read_all(f, s, sizeof(*s));
+      size_t count;
+      if (!set_insert(s, &count)) {
+        /* this is one of the queued states we already inserted */
+        state_free(s);
+      }
+    }
+    if (seen_count() != header.seen_count) {
+      checkpoint_corrupt();
+    }
+  } else {
+    set_deallocate(local_seen);
+    local_seen->size_exponent = (size_t)header.set_size_exponent;
+    set_allocate(local_seen);
+    checkpoint_read_all(f, local_seen->bucket,
+                        set_size(local_seen) * sizeof(local_seen->bucket[0]));
+    seen_count_shard[thread_id].value = (size_t)header.seen_count;
+  }
+
+  checkpoint_read_sum(f);
+  if (fgetc(f) != EOF) {
+    checkpoint_corrupt();
+  }
+  (void)fclose(f);
+
+  if (!MACHINE_READABLE_OUTPUT) {
+    put("Resuming from ");
+    put(RESUME_PATH);
+    put(" with ");
+    put_uint(seen_count());
+    put(" states seen and ");
+    put_uint(header.queue_count);
+    put(" states queued.\n\n");
+  }
+}
+#endif
+
+#if LIVENESS_COUNT > 0
+/* Set one of the liveness bits (i.e. mark the matching property as 'hit') in a
+ * state and all its predecessors.
+ */
+static __attribute__((unused)) void mark_liveness(struct state *NONNULL s,
+                                                  size_t index, bool shared) {
+
+  assert(s != NULL);
+  ASSERT(index < sizeof(s->liveness) * CHAR_BIT &&
+         "out of range liveness write");
+
+  size_t word_index = index / (sizeof(s->liveness[0]) * CHAR_BIT);
+  size_t bit_index = index % (sizeof(s->liveness[0]) * CHAR_BIT);
+
+  uintptr_t previous_value;
+  uintptr_t *target = &s->liveness[word_index];
+  uintptr_t mask = ((uintptr_t)1) << bit_index;
+
+  if (shared) {
+    /* If this state is shared (accessible by other threads) we need to operate
+     * on its liveness data atomically.
+     */
+    previous_value = __atomic_fetch_or(target, mask, __ATOMIC_SEQ_CST);
+  } else {
+    /* Otherwise we can use a cheaper ordinary OR. */
+    previous_value = *target;
+    *target |= mask;
+  }
+
+  /* Cheat a little and cast away the constness of the previous state for which
+   * we may need to update liveness data.
+   */
+  struct state *previous = state_drop_const(state_previous_get(s));
+
+  /* If the given bit was already set, we know all the predecessors of this
+   * state have already had their corresponding bit marked. However, if it was
+   * not we now need to recurse to mark them. Note that we assume any
+   * predecessors of this state are globally visible and hence shared. The
+   * recursion depth here can be indeterminately deep, but we assume the
+   * compiler can tail-optimise this call.
+   */
+  if ((previous_value & mask) != mask && previous != NULL) {
+    mark_liveness(previous, index, true);
+  }
+}
+
+/* number of unknown liveness properties for a given state */
+static unsigned long unknown_liveness(const struct state *NONNULL s) {
+
+  assert(s != NULL);
+
+  unsigned long unknown = 0;
+
+  for (size_t i = 0; i < sizeof(s->liveness) / sizeof(s->liveness[0]); i++) {
+
+    uintptr_t word = __atomic_load_n(&s->liveness[i], __ATOMIC_SEQ_CST);
+
+    for (size_t j = 0; j < sizeof(s->liveness[0]) * CHAR_BIT; j++) {
+      if (i * sizeof(s->liveness[0]) * CHAR_BIT + j >= LIVENESS_COUNT) {
+        break;
+      }
+
+      if (!((word >> j) & 0x1)) {
+        unknown++;
+      }
+    }
+  }
+
+  return unknown;
+}
+#endif
+
+/* Prototypes for generated functions. init() is unused when resuming from a
+ * checkpoint.
+ */
+static __attribute__((unused)) void init(void);
+static _Noreturn void explore(void);
+#if LIVENESS_COUNT > 0
+static void check_liveness_successors(struct state *NONNULL s);
+static unsigned long check_liveness_summarise(void);
+#endif
+
+#if PARTIAL_ORDER_REDUCTION
+/*******************************************************************************
+ * Partial-order reduction                                                     *
+ *                                                                             *
+ * With --partial-order-reduction on, the rule instances of the model are      *
+ * partitioned at generation time into components that do not read or write    *
+ * any state another component writes (see POR_COMPONENT). Firing only the     *
+ * enabled instances of one such component, and deferring the rest, preserves  *
+ * deadlocks and invariant violations provided the component writes nothing a  *
+ * property reads and no instance is deferred around a cycle. The former is    *
+ * decided when generating the table. The latter is ensured during exploration *
+ * by fully expanding any state one of whose reduced successors was already in *
+ * the seen set.                                                               *
+ ******************************************************************************/
+
+/* Choose the component whose enabled rule instances to fire, given the result
+ * of evaluating each instance's guard. POR_NONE is returned when every enabled
+ * instance must be fired.
+ */
+static uint32_t por_ample(const int8_t *NONNULL guards) {
+
+  /* take the first eligible component with an enabled instance */
+  uint32_t ample = POR_NONE;
+  for (size_t i = 0; i < POR_INSTANCES; i++) {
+    if (guards[i] == 1 && POR_COMPONENT[i] != POR_NONE) {
+      ample = POR_COMPONENT[i];
+      break;
+    }
+  }
+  if (ample == POR_NONE) {
+    return POR_NONE;
+  }
+
+  /* if every enabled instance is in this component, there is nothing to
+   * defer
+   */
+  for (size_t i = 0; i < POR_INSTANCES; i++) {
+    if (guards[i] == 1 && POR_COMPONENT[i] != ample) {
+      return ample;
+    }
+  }
+  return POR_NONE;
+}
+#endif
+
+/* A pseudo-random number generator (SplitMix64), for varying the order of
+ * exploration between threads. This does not need to be of high quality.
+ */
+static __attribute__((unused)) uint64_t random_next(uint64_t *NONNULL seed) {
+  uint64_t z = (*seed += UINT64_C(0x9e3779b97f4a7c15));
+  z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+  return z ^ (z >> 31);
+}
+
+#if SEARCH != SEARCH_BFS
+/*******************************************************************************
+ * Rule instances                                                              *
+ *                                                                             *
+ * Depth-first search and random simulation do not expand a state all at       *
+ * once, but fire its rule instances one by one. The instances of all rules    *
+ * are numbered consecutively, from 1 as in state_rule_taken_get(), and the    *
+ * start states init() queued are taken once up front to begin from.           *
+ ******************************************************************************/
+
+/* Fire a rule instance, numbered from 1 as in state_rule_taken_get(). Returns 1
+ * and the successor in *n if the instance was enabled, 0 if it was not, and -1
+ * if it triggered an error.
+ */
+static int fire_instance(const struct state *NONNULL s, uint64_t instance,
+                         struct state *NONNULL *NONNULL n);
+
+/* RULE_INSTANCES, as a variable to avoid warnings about dividing by it and
+ * comparing against it for models that have no rules. This is deliberately not
+ * const, which would let the compiler see through it.
+ */
+static uint64_t rule_instances = RULE_INSTANCES;
+
+/* Start states, shared by all threads. These are never freed, even when the
+ * seen set does not store states.
+ */
+static const struct state **start_states;
+static size_t start_state_count;
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+  while (b != 0) {
+    uint64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/* Pick a pseudo-random distance between consecutive rule instances to try.
+ * This is coprime to the number of rule instances, so stepping through them
+ * by it from any starting point tries every instance exactly once.
+ */
+static uint64_t random_stride(uint64_t *NONNULL seed) {
+  uint64_t stride = 1;
+  if (rule_instances > 1) {
+    do {
+      stride = random_next(seed) % rule_instances;
+    } while (stride == 0 || gcd(stride, rule_instances) != 1);
+  }
+  return stride;
+}
+
+/* Take the start states init() queued. This must be called by the initial
+ * thread before any others are started.
+ */
+static void take_start_states(void) {
+  assert(thread_id == 0 && phase == WARMUP);
+
+  size_t capacity = 0;
+  size_t queue_id = 0;
+  for (;;) {
+    const struct state *s = queue_dequeue(&queue_id);
+    if (s == NULL) {
+      break;
+    }
+    if (start_state_count == capacity) {
+      capacity = capacity == 0 ? 16 : capacity * 2;
+      start_states =
+          realloc(start_states, capacity * sizeof(start_states[0]));
+      if (__builtin_expect(start_states == NULL, 0)) {
+        oom();
+      }
+    }
+    start_states[start_state_count] = s;
+    start_state_count++;
+  }
+}
+#endif
+
+#if SEARCH == SEARCH_DFS
+/*******************************************************************************
+ * Depth-first search                                                          *
+ *                                                                             *
+ * With --search dfs, each thread explores from the start states using a stack *
+ * of the states whose successors it is generating. A stack frame records how  *
+ * many of its state's rule instances have been tried, so successors are       *
+ * generated one at a time and memory use grows with the depth of the search   *
+ * rather than its breadth. Threads share the seen set. Every thread expands   *
+ * the start states, but any other state is expanded only by the thread that   *
+ * inserted it into the seen set. To spread threads across the state space,    *
+ * every thread but the first tries rule instances in its own pseudo-random    *
+ * order.                                                                      *
+ ******************************************************************************/
+
+struct dfs_frame {
+  const struct state *state;
+
+  /* number of rule instances tried so far */
+  uint64_t tried;
+
+  /* next rule instance to try, numbered from 0 */
+  uint64_t next;
+
+  /* whether no rule instance has yet yielded a distinct successor */
+  bool possible_deadlock;
+};
+
+static _Thread_local struct dfs_frame *dfs_stack;
+static _Thread_local size_t dfs_depth;
+static _Thread_local size_t dfs_capacity;
+
+/* Distance between consecutive rule instances tried by this thread. */
+static _Thread_local uint64_t dfs_stride = 1;
+
+static _Thread_local uint64_t dfs_seed;
+
+static void dfs_thread_init(void) {
+  if (thread_id == 0) {
+    return;
+  }
+  dfs_seed = (uint64_t)thread_id;
+  dfs_stride = random_stride(&dfs_seed);
+}
+
+static void dfs_push(const struct state *NONNULL s) {
+  if (dfs_depth == dfs_capacity) {
+    dfs_capacity = dfs_capacity == 0 ? 1024 : dfs_capacity * 2;
+    dfs_stack = realloc(dfs_stack, dfs_capacity * sizeof(dfs_stack[0]));
+    if (__builtin_expect(dfs_stack == NULL, 0)) {
+      oom();
+    }
+  }
+  struct dfs_frame *f = &dfs_stack[dfs_depth];
+  f->state = s;
+  f->tried = 0;
+  f->next = 0;
+  if (thread_id != 0 && rule_instances > 0) {
+    f->next = random_next(&dfs_seed) % rule_instances;
+  }
+  f->possible_deadlock = true;
+  dfs_depth++;
+}
+
+/* Return the next rule instance of a frame to try, numbered from 1. */
+static uint64_t dfs_next_instance(struct dfs_frame *NONNULL f) {
+  assert(f->tried < rule_instances && "no rule instances left to try");
+  uint64_t instance = f->next + 1;
+  f->tried++;
+  f->next += dfs_stride;
+  if (f->next >= rule_instances) {
+    f->next -= rule_instances;
+  }
+  return instance;
+}
+
+/* Print a progress report for a thread that has added another 10000 states. */
+static void dfs_progress(size_t states) {
+  if (ftrylockfile(stdout) != 0) {
+    return;
+  }
+  if (MACHINE_READABLE_OUTPUT) {
+    put("<progress states=\"");
+    put_uint(states);
+    put("\" duration_seconds=\"");
+    put_uint(gettime());
+    put("\" rules_fired=\"");
+    put_uint(rules_fired_local);
+    put("\" queue_size=\"");
+    put_uint(dfs_depth);
+    put("\" thread_id=\"");
+    put_uint(thread_id);
+    put("\"/>\n");
+  } else {
+    put("\t ");
+    if (THREADS > 1) {
+      put("thread ");
+      put_uint(thread_id);
+      put(": ");
+    }
+    put_uint(states);
+    put(" states explored in ");
+    put_uint(gettime());
+    put("s, with ");
+    put_uint(rules_fired_local);
+    put(" rules fired and a stack depth of ");
+    put_uint(dfs_depth);
+    put(".\n");
+  }
+  funlockfile(stdout);
+}
+#endif
+
+#if SEARCH == SEARCH_SIMULATE
+/*******************************************************************************
+ * Random simulation                                                           *
+ *                                                                             *
+ * With --simulate, threads take random walks from the start states instead of *
+ * exploring the state space. Each step of a walk fires a pseudo-random        *
+ * enabled rule instance and checks the properties of the state it reaches.    *
+ * States are never inserted into the seen set. A walk keeps the states along  *
+ * its path to print a counterexample trace from, or only its current state if *
+ * traces are disabled. The choices a walk makes are derived from the seed and *
+ * the walk's number, so a walk is the same whichever thread takes it.         *
+ ******************************************************************************/
+
+/* number of walks claimed by threads so far */
+static uint64_t walks_started;
+
+/* when the first walk began */
+static struct timespec walks_start_time;
+
+static void walks_begin(void) {
+  if (__builtin_expect(
+          clock_gettime(CLOCK_MONOTONIC, &walks_start_time) != 0, 0)) {
+    fprintf(stderr, "clock_gettime failed: %s\n", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* seconds elapsed since the first walk began */
+static double walks_elapsed(void) {
+  struct timespec now;
+  if (__builtin_expect(clock_gettime(CLOCK_MONOTONIC, &now) != 0, 0)) {
+    return 0;
+  }
+  return (double)(now.tv_sec - walks_start_time.tv_sec) +
+         (double)(now.tv_nsec - walks_start_time.tv_nsec) / 1e9;
+}
+
+/* Claim the next walk to take, returning false if every walk has been
+ * claimed.
+ */
+static bool walk_claim(uint64_t *NONNULL walk) {
+  uint64_t w = __atomic_fetch_add(&walks_started, 1, __ATOMIC_SEQ_CST);
+  if (w >= SIMULATE_WALKS) {
+    return false;
+  }
+  *walk = w;
+  return true;
+}
+
+/* number of walks begun so far */
+static uint64_t walks_taken(void) {
+  uint64_t w = __atomic_load_n(&walks_started, __ATOMIC_SEQ_CST);
+  return w < SIMULATE_WALKS ? w : SIMULATE_WALKS;
+}
+
+static uint64_t walk_seed(uint64_t walk) {
+  uint64_t seed = SIMULATE_SEED ^ walk;
+  return random_next(&seed);
+}
+
+/* Take a step from the given state, firing an enabled rule instance picked
+ * using the walk's seed. Instances are tried from a random starting point, a
+ * stride apart. Returns 1 and the successor in *n, 0 if no rule instance was
+ * enabled, or -1 if firing an instance triggered an error. With stuttering
+ * deadlock detection, successors identical to the given state are passed over,
+ * so a state whose only successors are itself also yields 0.
+ */
+static int walk_step(const struct state *NONNULL s, uint64_t stride,
+                     uint64_t *NONNULL seed, struct state *NONNULL *NONNULL n) {
+  uint64_t next = 0;
+  if (rule_instances > 0) {
+    next = random_next(seed) % rule_instances;
+  }
+  for (uint64_t tried = 0; tried < rule_instances; tried++) {
+    int r = fire_instance(s, next + 1, n);
+    next += stride;
+    if (next >= rule_instances) {
+      next -= rule_instances;
+    }
+    if (r == 0) {
+      continue;
+    }
+    if (r != 1) {
+      return -1;
+    }
+    rules_fired_local++;
+    if (DEADLOCK_DETECTION == DEADLOCK_DETECTION_STUTTERING &&
+        state_eq(s, *n)) {
+      state_free(*n);
+      continue;
+    }
+    return 1;
+  }
+  return 0;
+}
+
+/* Free the states a walk has allocated, from its current state back to the
+ * start state it began from.
+ */
+static void walk_free(const struct state *NONNULL s,
+                      const struct state *NONNULL start) {
+#if COUNTEREXAMPLE_TRACE != CEX_OFF
+  while (s != start) {
+    const struct state *previous = state_previous_get(s);
+    state_free(state_drop_const(s));
+    s = previous;
+  }
+#else
+  if (s != start) {
+    state_free(state_drop_const(s));
+  }
+#endif
+}
+
+/* Print a progress report for a thread that has begun another 1000 walks. */
+static void walk_progress(uint64_t walks) {
+  if (ftrylockfile(stdout) != 0) {
+    return;
+  }
+  if (MACHINE_READABLE_OUTPUT) {
+    put("<progress states=\"");
+    put_uint(seen_count());
+    put("\" duration_seconds=\"");
+    put_uint(gettime());
+    put("\" rules_fired=\"");
+    put_uint(rules_fired_local);
+    put("\" queue_size=\"0\" walks=\"");
+    put_uint(walks);
+    put("\" thread_id=\"");
+    put_uint(thread_id);
+    put("\"/>\n");
+  } else {
+    put("\t ");
+    if (THREADS > 1) {
+      put("thread ");
+      put_uint(thread_id);
+      put(": ");
+    }
+    put_uint(walks);
+    put(" walks begun in ");
+    put_uint(gettime());
+    put("s, with ");
+    put_uint(rules_fired_local);
+    put(" rules fired.\n");
+  }
+  funlockfile(stdout);
+}
+#endif
+
+#if LIVENESS_COUNT > 0
+/*******************************************************************************
+ * Final liveness check                                                        *
+ *                                                                             *
+ * Exploration marks liveness properties as hit in a state and the chain of    *
+ * states it was reached from, but not in other predecessors whose successor   *
+ * was de-duped against an existing state. Once exploration is over, all       *
+ * threads scan the seen set once, regenerating the successors of any state    *
+ * with unknown liveness and recording each such successor-to-predecessor      *
+ * edge. Each state whose liveness bits change afterwards is queued on a       *
+ * worklist of the thread that changed it and its recorded predecessors are    *
+ * revisited, so the work done is proportional to what is learnt rather than   *
+ * to repeated scans of the whole seen set.                                    *
+ ******************************************************************************/
+
+/* An edge from a state with unknown liveness to one of its successors, chained
+ * with the other edges whose successor hashes to the same bucket.
+ */
+struct liveness_edge {
+  const struct state *successor;
+  struct state *predecessor;
+  struct liveness_edge *next;
+};
+
+/* Edges are allocated in blocks that never move, so they can be linked into
+ * buckets shared by all threads.
+ */
+enum { LIVENESS_EDGE_BLOCK = 4096 };
+struct liveness_edge_block {
+  struct liveness_edge_block *next;
+  size_t used;
+  struct liveness_edge edge[LIVENESS_EDGE_BLOCK];
+};
+
+/* Buckets of edges, indexed by a hash of the successor. */
+static struct liveness_edge **liveness_edges;
+static size_t liveness_edges_bits;
+
+/* Per-thread data for the final liveness check. */
+static struct liveness_work {
+
+  /* states whose liveness this thread changed and that need to pass it on */
+  struct state **changed;
+  size_t changed_count;
+  size_t changed_capacity;
+
+  /* blocks of edges this thread found */
+  struct liveness_edge_block *edges;
+
+  /* liveness facts this thread has proved */
+  unsigned long learned;
+} liveness_work[THREADS];
+
+/* Number of seen set slots claimed at a time by a thread during the scan. */
+enum { LIVENESS_SCAN_CHUNK = 1024 };
+
+/* Next unclaimed slot of the seen set. */
+static size_t liveness_scan_next;
+
+/* Liveness facts proved and left to prove at the last progress output. */
+static unsigned long liveness_learned;
+static unsigned long liveness_remaining;
+static unsigned long long liveness_last_update;
+
+/* Set some liveness bits in a state and the states it was reached from, queuing
+ * every state that changes.
+ */
+static void liveness_raise(struct state *NONNULL s, size_t word_index,
+                           uintptr_t bits) {
+
+  assert(s != NULL);
+
+  struct liveness_work *w = &liveness_work[thread_id];
 
-    if (slot_is_tombstone(c)) {
-      /* This slot has been migrated. We need to rendezvous with other migrating
-       * threads and restart our insertion attempt on the newly expanded set.
-       */
-      set_migrate();
-      goto restart;
+  for (struct state *p = s; p != NULL;
+       p = state_drop_const(state_previous_get(p))) {
+
+    uintptr_t previous_value =
+        __atomic_fetch_or(&p->liveness[word_index], bits, __ATOMIC_SEQ_CST);
+
+    /* Bits that were already set have already been passed on from here. */
+    bits &= ~previous_value;
+    if (bits == 0) {
+      break;
     }
 
-    /* If we find this already in the set, we're done. */
-    if (state_eq(s, slot_to_state(c))) {
-      TRACE(TC_SET, "skipped adding state %p that was already in set", s);
-      return false;
+    if (w->changed_count == w->changed_capacity) {
+      size_t capacity =
+          w->changed_capacity == 0 ? 1024 : w->changed_capacity * 2;
+      struct state **c = realloc(w->changed, capacity * sizeof(c[0]));
+      if (__builtin_expect(c == NULL, 0)) {
+        oom();
+      }
+      w->changed = c;
+      w->changed_capacity = capacity;
     }
+    w->changed[w->changed_count] = p;
+    w->changed_count++;
 
-    attempts++;
+    __atomic_store_n(&w->learned,
+                     w->learned + (unsigned long)__builtin_popcountll(bits),
+                     __ATOMIC_RELAXED);
   }
-
-  /* If we reach here, the set is full. Expand it and retry the insertion. */
-  set_expand();
-  return set_insert(s, count);
 }
 
-/* Find an existing element in the set.
- *
- * Why would you ever want to do this? If you already have the state, why do you
- * want to find a copy of it? The answer is for liveness information. When
- * checking liveness properties, a duplicate of your current state that is
- * already contained in the state set might know some of the liveness properties
- * are satisfied that your current state considers unknown.
- */
-static __attribute__((unused)) const struct state *
-set_find(const struct state *NONNULL s) {
+/* learn new liveness information about the state `s` from its successor */
+static void liveness_learn(struct state *NONNULL s,
+                           const struct state *NONNULL successor) {
 
   assert(s != NULL);
+  assert(successor != NULL);
 
-  size_t index = set_index(local_seen, state_hash(s));
+  for (size_t i = 0; i < sizeof(s->liveness) / sizeof(s->liveness[0]); i++) {
 
-  size_t attempts = 0;
-  for (size_t i = index; attempts < set_size(local_seen);
-       i = set_index(local_seen, i + 1)) {
+    uintptr_t word_src =
+        __atomic_load_n(&successor->liveness[i], __ATOMIC_SEQ_CST);
+    uintptr_t word_dst = __atomic_load_n(&s->liveness[i], __ATOMIC_SEQ_CST);
 
-    slot_t slot = __atomic_load_n(&local_seen->bucket[i], __ATOMIC_SEQ_CST);
+    if ((word_src & ~word_dst) != 0) {
+      liveness_raise(s, i, word_src & ~word_dst);
+    }
+  }
+}
 
-    /* This function is only expected to be called during the final liveness
-     * scan, in which all threads participate. So we should never encounter a
-     * set undergoing migration.
-     */
-    ASSERT(!slot_is_tombstone(slot) &&
-           "tombstone encountered during final phase");
+static size_t liveness_edge_bucket(const struct state *NONNULL s) {
+  uint64_t h = (uint64_t)(uintptr_t)s * UINT64_C(0x9e3779b97f4a7c15);
+  return (size_t)(h >> (64 - liveness_edges_bits));
+}
 
-    if (slot_is_empty(slot)) {
-      /* reached the end of the linear block in which this state could lie */
-      break;
-    }
+/* Called by check_liveness_successors() for each successor of `s`. Note that
+ * typically `state_previous_get(successor) != s` because `successor` is one of
+ * the de-duped aliases of the original successor to `s`.
+ */
+static void liveness_successor(struct state *NONNULL s,
+                               const struct state *NONNULL successor) {
+
+  if (successor == s) {
+    return;
+  }
 
-    const struct state *n = slot_to_state(slot);
-    ASSERT(n != NULL && "null pointer stored in state set");
+  liveness_learn(s, successor);
 
-    if (state_eq(s, n)) {
-      /* found */
-      return n;
+  /* If `s` is still missing anything, the successor may learn it later. There
+   * is no need to record this if `s` is the state the successor was reached
+   * from, as liveness_raise() will follow that link anyway.
+   */
+  if (state_previous_get(successor) != s && unknown_liveness(s) > 0) {
+    struct liveness_work *w = &liveness_work[thread_id];
+    if (w->edges == NULL || w->edges->used == LIVENESS_EDGE_BLOCK) {
+      struct liveness_edge_block *b = xmalloc(sizeof(*b));
+      b->next = w->edges;
+      b->used = 0;
+      w->edges = b;
+    }
+    struct liveness_edge *e = &w->edges->edge[w->edges->used];
+    w->edges->used++;
+    e->successor = successor;
+    e->predecessor = s;
+
+    struct liveness_edge **bucket =
+        &liveness_edges[liveness_edge_bucket(successor)];
+    e->next = __atomic_load_n(bucket, __ATOMIC_SEQ_CST);
+    while (!__atomic_compare_exchange_n(bucket, &e->next, e, true,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      /* retry */
     }
+  }
+}
 
-    attempts++;
+static void liveness_progress(void) {
+
+  /* only the initial thread reports progress, to avoid interleaved output */
+  if (MACHINE_READABLE_OUTPUT || thread_id != 0) {
+    return;
   }
 
-  /* not found */
-  return NULL;
+  unsigned long long t = gettime();
+  if (t > liveness_last_update) {
+    unsigned long learned = 0;
+    for (size_t i = 0; i < THREADS; i++) {
+      learned += __atomic_load_n(&liveness_work[i].learned, __ATOMIC_RELAXED);
+    }
+    learned -= liveness_learned;
+    liveness_learned += learned;
+    liveness_remaining -= learned;
+    put("\t ");
+    put_uint(learned);
+    put(" further liveness constraints proved in ");
+    put_uint(t - liveness_last_update);
+    put("s, with ");
+    put(green());
+    put_uint(liveness_remaining);
+    put(reset());
+    put(" remaining\n");
+    liveness_last_update = t;
+  }
 }
 
-/******************************************************************************/
+/* First pass: expand every state with unknown liveness. */
+static void liveness_scan(void) {
 
-static time_t START_TIME;
+  for (;;) {
 
-static unsigned long long gettime() {
-  return (unsigned long long)(time(NULL) - START_TIME);
-}
+    size_t start = __atomic_fetch_add(&liveness_scan_next, LIVENESS_SCAN_CHUNK,
+                                      __ATOMIC_SEQ_CST);
+    if (start >= set_size(local_seen)) {
+      break;
+    }
+    size_t end = start + LIVENESS_SCAN_CHUNK;
+    if (end > set_size(local_seen)) {
+      end = set_size(local_seen);
+    }
 
-#if LIVENESS_COUNT > 0
-/* Set one of the liveness bits (i.e. mark the matching property as 'hit') in a
- * state and all its predecessors.
- */
-static __attribute__((unused)) void mark_liveness(struct state *NONNULL s,
-                                                  size_t index, bool shared) {
+    for (size_t i = start; i < end; i++) {
 
-  assert(s != NULL);
-  ASSERT(index < sizeof(s->liveness) * CHAR_BIT &&
-         "out of range liveness write");
+      slot_t slot = __atomic_load_n(&local_seen->bucket[i], __ATOMIC_SEQ_CST);
 
-  size_t word_index = index / (sizeof(s->liveness[0]) * CHAR_BIT);
-  size_t bit_index = index % (sizeof(s->liveness[0]) * CHAR_BIT);
+      ASSERT(!slot_is_tombstone(slot) &&
+             "seen set being migrated during final liveness check");
 
-  uintptr_t previous_value;
-  uintptr_t *target = &s->liveness[word_index];
-  uintptr_t mask = ((uintptr_t)1) << bit_index;
+      if (slot_is_empty(slot)) {
+        /* skip empty entries in the hash table */
+        continue;
+      }
 
-  if (shared) {
-    /* If this state is shared (accessible by other threads) we need to operate
-     * on its liveness data atomically.
-     */
-    previous_value = __atomic_fetch_or(target, mask, __ATOMIC_SEQ_CST);
-  } else {
-    /* Otherwise we can use a cheaper ordinary OR. */
-    previous_value = *target;
-    *target |= mask;
+      struct state *s = slot_to_state(slot);
+      ASSERT(s != NULL && "null pointer stored in state set");
+
+      if (unknown_liveness(s) == 0) {
+        /* skip entries where liveness is fully satisfied already */
+        continue;
+      }
+
+#if BOUND > 0
+      /* If we're doing bounded checking and this state is at the bound limit,
+       * it's not valid to expand beyond this.
+       */
+      ASSERT(state_bound_get(s) <= BOUND &&
+             "a state that exceeded the bound depth was explored");
+      if (state_bound_get(s) == BOUND) {
+        continue;
+      }
+#endif
+
+      check_liveness_successors(s);
+    }
+
+    liveness_progress();
   }
+}
 
-  /* Cheat a little and cast away the constness of the previous state for which
-   * we may need to update liveness data.
-   */
-  struct state *previous = state_drop_const(state_previous_get(s));
+/* Second pass: pass what each changed state learnt on to its predecessors. */
+static void liveness_propagate(void) {
 
-  /* If the given bit was already set, we know all the predecessors of this
-   * state have already had their corresponding bit marked. However, if it was
-   * not we now need to recurse to mark them. Note that we assume any
-   * predecessors of this state are globally visible and hence shared. The
-   * recursion depth here can be indeterminately deep, but we assume the
-   * compiler can tail-optimise this call.
-   */
-  if ((previous_value & mask) != mask && previous != NULL) {
-    mark_liveness(previous, index, true);
+  struct liveness_work *w = &liveness_work[thread_id];
+
+  while (w->changed_count > 0) {
+    w->changed_count--;
+    const struct state *t = w->changed[w->changed_count];
+
+    for (const struct liveness_edge *e =
+             liveness_edges[liveness_edge_bucket(t)];
+         e != NULL; e = e->next) {
+      if (e->successor == t) {
+        liveness_learn(e->predecessor, t);
+      }
+    }
+
+    if (w->changed_count % 1024 == 0) {
+      liveness_progress();
+    }
   }
 }
 
-/* number of unknown liveness properties for a given state */
-static unsigned long unknown_liveness(const struct state *NONNULL s) {
+/* Function the threads of the final liveness check are currently running. */
+static void (*liveness_step)(void);
 
-  assert(s != NULL);
+static void *liveness_thread_main(void *arg) {
 
-  unsigned long unknown = 0;
+  thread_id = (size_t)(uintptr_t)arg;
 
-  for (size_t i = 0; i < sizeof(s->liveness) / sizeof(s->liveness[0]); i++) {
+  numa_thread_init();
 
-    uintptr_t word = __atomic_load_n(&s->liveness[i], __ATOMIC_SEQ_CST);
+  set_thread_init();
+  liveness_step();
+  set_thread_release();
 
-    for (size_t j = 0; j < sizeof(s->liveness[0]) * CHAR_BIT; j++) {
-      if (i * sizeof(s->liveness[0]) * CHAR_BIT + j >= LIVENESS_COUNT) {
-        break;
-      }
+  return NULL;
+}
 
-      if (!((word >> j) & 0x1)) {
-        unknown++;
-      }
+/* Run a pass of the final liveness check across all threads. */
+static void liveness_run(void (*step)(void)) {
+
+  assert(thread_id == 0 && "final liveness check run from secondary thread");
+
+  liveness_step = step;
+
+  for (size_t i = 1; i < THREADS; i++) {
+    int r = pthread_create(&threads[i - 1], NULL, liveness_thread_main,
+                           (void *)(uintptr_t)i);
+    if (__builtin_expect(r != 0, 0)) {
+      fprintf(stderr, "pthread_create failed: %s\n", strerror(r));
+      exit(EXIT_FAILURE);
     }
   }
 
-  return unknown;
+  step();
+
+  for (size_t i = 1; i < THREADS; i++) {
+    int r = pthread_join(threads[i - 1], NULL);
+    if (__builtin_expect(r != 0, 0)) {
+      fprintf(stderr, "failed to join thread: %s\n", strerror(r));
+      exit(EXIT_FAILURE);
+    }
+  }
 }
 
-/** learn new liveness information about the state `s` from its successor
- *
- * Note that typically `state_previous_get(successor) != s` because `successor`
- * is actually one of the de-duped aliases of the original successor to `s`.
- *
- * \param s State to learn information about
- * \param successor Successor to s
- * \return Number of new liveness information facts learnt
- */
-static unsigned long learn_liveness(struct state *NONNULL s,
-                                    const struct state *NONNULL successor) {
+static void check_liveness_final(void) {
 
-  assert(s != NULL);
-  assert(successor != NULL);
+  if (!MACHINE_READABLE_OUTPUT) {
+    put("trying to prove remaining liveness constraints...\n");
 
-  unsigned long new_info = 0;
+    /* find how many liveness bits are unknown */
+    for (size_t i = 0; i < set_size(local_seen); i++) {
 
-  for (size_t i = 0; i < sizeof(s->liveness) / sizeof(s->liveness[0]); i++) {
+      slot_t slot = __atomic_load_n(&local_seen->bucket[i], __ATOMIC_SEQ_CST);
 
-    uintptr_t word_src =
-        __atomic_load_n(&successor->liveness[i], __ATOMIC_SEQ_CST);
-    uintptr_t word_dst = __atomic_load_n(&s->liveness[i], __ATOMIC_SEQ_CST);
+      ASSERT(!slot_is_tombstone(slot) &&
+             "seen set being migrated during final liveness check");
 
-    for (size_t j = 0; j < sizeof(s->liveness[0]) * CHAR_BIT; j++) {
-      if (i * sizeof(s->liveness[0]) * CHAR_BIT + j >= LIVENESS_COUNT) {
-        break;
+      if (slot_is_empty(slot)) {
+        /* skip empty entries in the hash table */
+        continue;
       }
 
-      bool live_src = !!((word_src >> j) & 0x1);
-      bool live_dst = !!((word_dst >> j) & 0x1);
+      struct state *s = slot_to_state(slot);
+      ASSERT(s != NULL && "null pointer stored in state set");
 
-      if (!live_dst && live_src) {
-        mark_liveness(s, i * sizeof(s->liveness[0]) * CHAR_BIT + j, true);
-        new_info++;
-      }
+      liveness_remaining += unknown_liveness(s);
     }
+    put("\t ");
+    put_uint(liveness_remaining);
+    put(" constraints remaining\n");
+    liveness_last_update = gettime();
   }
 
-  return new_info;
+  /* size the edge buckets to the number of states */
+  liveness_edges_bits = 1;
+  while (((size_t)1 << liveness_edges_bits) < seen_count()) {
+    liveness_edges_bits++;
+  }
+  liveness_edges =
+      xcalloc((size_t)1 << liveness_edges_bits, sizeof(liveness_edges[0]));
+
+  liveness_run(liveness_scan);
+  liveness_run(liveness_propagate);
+
+  for (size_t i = 0; i < THREADS; i++) {
+    free(liveness_work[i].changed);
+    while (liveness_work[i].edges != NULL) {
+      struct liveness_edge_block *b = liveness_work[i].edges;
+      liveness_work[i].edges = b->next;
+      free(b);
+    }
+  }
+  free(liveness_edges);
 }
 #endif
 
-/* Prototypes for generated functions. */
-static void init(void);
-static _Noreturn void explore(void);
-#if LIVENESS_COUNT > 0
-static void check_liveness_final(void);
-static unsigned long check_liveness_summarise(void);
+#if HASH_COMPACTION_BITS > 0
+/* An upper bound on the probability that hash compaction caused part of the
+ * state space to be missed. A new state is only wrongly discarded when its
+ * fingerprint collides with that of a different state, so this is the birthday
+ * bound for the number of fingerprints we stored.
+ */
+static double omission_probability(void) {
+  size_t count = seen_count();
+  if (count < 2) {
+    return 0;
+  }
+  double p = (double)count * (double)(count - 1) / 2;
+  for (size_t i = 0; i < HASH_COMPACTION_BITS; i++) {
+    p /= 2;
+  }
+  return p > 1 ? 1 : p;
+}
 #endif
 
 static int exit_with(int status) {
 
-  /* Opt out of the thread-wide rendezvous protocol. */
-  refcounted_ptr_put(&global_seen, local_seen);
-  rendezvous_opt_out(set_update);
-  local_seen = NULL;
+  /* Stop using the seen set and opt out of the thread-wide rendezvous
+   * protocol.
+   */
+  set_thread_release();
+  rendezvous_opt_out(set_settle);
 
   /* Make fired rule count visible globally. */
   rules_fired[thread_id] = rules_fired_local;
@@ -3717,9 +7023,14 @@ static int exit_with(int status) {
 
     /* Reacquire a pointer to the seen set. Note that this may not be the same
      * value as what we previously had in local_seen because the other threads
-     * may have expanded and migrated the seen set in the meantime.
+     * may have expanded the seen set in the meantime. They may also have left
+     * an expansion incomplete, which we finish first.
      */
-    local_seen = refcounted_ptr_get(&global_seen);
+    set_settle();
+    set_thread_init();
+#if !EXTERNAL_MEMORY
+    queue_settle();
+#endif
 
     if (error_count == 0) {
       /* If we didn't see any other errors, print cover information. */
@@ -3819,39 +7130,167 @@ static int exit_with(int status) {
       fire_count += rules_fired[i];
     }
 
+#if SEARCH == SEARCH_SIMULATE
+    /* use a finer clock than gettime(), as a run may take under a second */
+    uintmax_t rules_per_second = 0;
+    {
+      double elapsed = walks_elapsed();
+      if (elapsed > 0) {
+        rules_per_second = (uintmax_t)((double)fire_count / elapsed);
+      }
+    }
+#endif
+
     /* Paranoid check that we didn't miscount during set insertions/expansions.
+     * This is not possible in bitstate mode, where states do not occupy slots.
      */
+#if BITSTATE_HASHES == 0 && !EXTERNAL_MEMORY
 #ifndef NDEBUG
     size_t count = 0;
     for (size_t i = 0; i < set_size(local_seen); i++) {
+#if INLINE_SET
+      for (size_t j = 0; j < SET_LINE_ENTRIES; j++) {
+        if (local_seen->bucket[i].status[j] >= ENTRY_FULL) {
+          count++;
+        }
+      }
+#elif TREE_COMPRESSION
+      if (local_seen->bucket[i] & TREE_NODE_ROOT) {
+        count++;
+      }
+#else
       if (!slot_is_empty(local_seen->bucket[i])) {
         count++;
       }
+#endif
     }
 #endif
-    assert(count == seen_count && "seen set count is inconsistent at exit");
+    assert(count == set_occupancy() &&
+           "seen set count is inconsistent at exit");
+#endif
 
     if (MACHINE_READABLE_OUTPUT) {
       put("<summary states=\"");
-      put_uint(seen_count);
+      put_uint(seen_count());
       put("\" rules_fired=\"");
       put_uint(fire_count);
       put("\" errors=\"");
       put_uint(error_count);
       put("\" duration_seconds=\"");
       put_uint(gettime());
+#if SEARCH == SEARCH_SIMULATE
+      put("\" walks=\"");
+      put_uint(walks_taken());
+      put("\" rules_fired_per_second=\"");
+      put_uint(rules_per_second);
+#endif
+      if (MEMORY_LIMIT > 0) {
+        put("\" state_caching=\"");
+        put(eviction_rounds > 0 ? "true" : "false");
+        put("\" evictions=\"");
+        put_uint(evicted_count);
+        put("\" eviction_rounds=\"");
+        put_uint(eviction_rounds);
+      }
+#if HASH_COMPACTION_BITS > 0
+      {
+        char buffer[128] = {0};
+        snprintf(buffer, sizeof(buffer), "%.3g", omission_probability());
+        put("\" omission_probability=\"");
+        put(buffer);
+      }
+#endif
+#if BITSTATE_HASHES > 0
+      {
+        char buffer[128] = {0};
+        snprintf(buffer, sizeof(buffer), "%.3g", bitstate_fill_ratio());
+        put("\" bitstate_fill_ratio=\"");
+        put(buffer);
+        snprintf(buffer, sizeof(buffer), "%.3g", bitstate_coverage());
+        put("\" bitstate_coverage=\"");
+        put(buffer);
+      }
+#endif
+#if TREE_COMPRESSION
+      put("\" tree_nodes=\"");
+      put_uint(seen_count() + tree_interior_count());
+#endif
+#if EXTERNAL_MEMORY
+      put("\" external_batches=\"");
+      put_uint(external_merges);
+#endif
       put("\"/>\n");
+      numa_print_placement();
       put("</rumur_run>\n");
     } else {
+#if SEARCH == SEARCH_SIMULATE
+      put("Random Walks:\n"
+          "\n"
+          "\t");
+      put_uint(walks_taken());
+      put(" walks, ");
+      put_uint(fire_count);
+      put(" rules fired in ");
+      put_uint(gettime());
+      put("s (");
+      put_uint(rules_per_second);
+      put(" rules fired per second).\n");
+#else
       put("State Space Explored:\n"
           "\n"
           "\t");
-      put_uint(seen_count);
+      put_uint(seen_count());
       put(" states, ");
       put_uint(fire_count);
       put(" rules fired in ");
       put_uint(gettime());
       put("s.\n");
+#endif
+      if (MEMORY_LIMIT > 0 && eviction_rounds > 0) {
+        put("\t* State caching was engaged when the seen set reached the "
+            "memory limit. ");
+        put_uint(evicted_count);
+        put(" states were evicted from the seen set in ");
+        put_uint(eviction_rounds);
+        put(" rounds, so some states may have been explored, and counted "
+            "above, more than once.\n");
+      }
+#if HASH_COMPACTION_BITS > 0
+      {
+        char buffer[128] = {0};
+        snprintf(buffer, sizeof(buffer), "%.3g", omission_probability());
+        put("\t* Probability of having omitted states due to hash "
+            "compaction is at most ");
+        put(buffer);
+        put(".\n");
+      }
+#endif
+#if BITSTATE_HASHES > 0
+      {
+        char buffer[128] = {0};
+        snprintf(buffer, sizeof(buffer), "%.2f%%",
+                 bitstate_fill_ratio() * 100);
+        put("\t* The bitstate array is ");
+        put(buffer);
+        put(" full, giving an estimated coverage of ");
+        snprintf(buffer, sizeof(buffer), "%.2f%%", bitstate_coverage() * 100);
+        put(buffer);
+        put(" of the state space.\n");
+      }
+#endif
+#if TREE_COMPRESSION
+      put("\t* Tree compression stored the states in ");
+      put_uint((seen_count() + tree_interior_count()) * sizeof(slot_t));
+      put(" bytes of tree nodes, compared to ");
+      put_uint(seen_count() * STATE_SIZE_BYTES);
+      put(" bytes uncompressed.\n");
+#endif
+#if EXTERNAL_MEMORY
+      put("\t* Successors were merged into the seen states on disk in ");
+      put_uint(external_merges);
+      put(" batches.\n");
+#endif
+      numa_print_placement();
     }
 
     /* print memory usage statistics if `--trace memory_usage` is in effect */
@@ -3868,6 +7307,8 @@ static void *thread_main(void *arg) {
   /* Initialize (thread-local) thread identifier. */
   thread_id = (size_t)(uintptr_t)arg;
 
+  numa_thread_init();
+
   set_thread_init();
 
   explore();
@@ -3919,6 +7360,19 @@ int main(void) {
   /* We don't need to read anything from stdin, so discard it. */
   (void)fclose(stdin);
 
+  hash_init();
+
+  numa_init();
+  numa_thread_init();
+
+  if (HUGE_PAGES && !HUGE_PAGES_SUPPORTED) {
+    fprintf(stderr, "huge pages are not supported on this platform\n");
+  }
+
+#if STATE_ID_BITS > 0
+  state_pool_init();
+#endif
+
   sandbox();
 
   if (MACHINE_READABLE_OUTPUT) {
@@ -3929,7 +7383,7 @@ int main(void) {
     put("\" state_size_bytes=\"");
     put_uint(STATE_SIZE_BYTES);
     put("\" hash_table_slots=\"");
-    put_uint(((size_t)1) << INITIAL_SET_SIZE_EXPONENT);
+    put_uint((((size_t)1) << INITIAL_SET_SIZE_EXPONENT) * SET_LINE_ENTRIES);
     put("\"/>\n");
   } else {
     put("Memory usage:\n"
@@ -3938,11 +7392,52 @@ int main(void) {
     put_uint(STATE_SIZE_BITS);
     put(" bits (rounded up to ");
     put_uint(STATE_SIZE_BYTES);
-    put(" bytes).\n"
-        "\t* The size of the hash table is ");
-    put_uint(((size_t)1) << INITIAL_SET_SIZE_EXPONENT);
-    put(" slots.\n"
-        "\n");
+    put(" bytes).\n");
+    if (EXTERNAL_MEMORY) {
+      put("\t* States are stored on disk in ");
+      put(EXTERNAL_MEMORY_DIR);
+      put(", with an in-memory batch of up to ");
+      put_uint(SET_CAPACITY / (STATE_SIZE_BYTES + 1));
+      put(" states.\n");
+    } else if (BITSTATE_HASHES > 0) {
+      put("\t* The size of the bitstate array is ");
+      put_uint((((size_t)1) << INITIAL_SET_SIZE_EXPONENT) * sizeof(slot_t) *
+               CHAR_BIT);
+      put(" bits, probed by ");
+      put_uint(BITSTATE_HASHES);
+      put(" hash functions.\n");
+    } else {
+      put("\t* The size of the hash table is ");
+      put_uint((((size_t)1) << INITIAL_SET_SIZE_EXPONENT) * SET_LINE_ENTRIES);
+      put(" slots.\n");
+      if (INLINE_SET) {
+        put("\t* States are stored inline in the hash table, ");
+        put_uint(SET_LINE_ENTRIES);
+        put(" per cache line.\n");
+      }
+    }
+#if TREE_COMPRESSION
+    put("\t* Tree compression is enabled, storing states as trees of ");
+    put_uint(TREE_LEAVES);
+    put(TREE_LEAVES == 1 ? " leaf.\n" : " leaves.\n");
+#endif
+    if (HASH_COMPACTION_BITS > 0) {
+      put("\t* Hash compaction is enabled, storing ");
+      put_uint(HASH_COMPACTION_BITS);
+      put("-bit fingerprints of states.\n");
+    }
+    if (STATE_ID_BITS > 0) {
+      put("\t* States are allocated from a pool of ");
+      put_uint(MAX_STATES);
+      put(", and referred to by ");
+      put_uint(STATE_ID_BITS);
+      put("-bit indices.\n");
+    }
+    if (HUGE_PAGES_SUPPORTED) {
+      put("\t* The seen set and states are mapped to use huge pages where "
+          "available.\n");
+    }
+    put("\n");
   }
 
 #ifndef NDEBUG
@@ -3957,7 +7452,15 @@ int main(void) {
 
   set_thread_init();
 
+#if EXTERNAL_MEMORY
+  external_init();
+#endif
+
+#if RESUME
+  checkpoint_load();
+#else
   init();
+#endif
 
   if (!MACHINE_READABLE_OUTPUT) {
     put("Progress Report:\n\n");
@@ -4,6 +4,12 @@
 #define _POSIX_C_SOURCE 200809L
 #endif
 
+/* On Linux, also expose the extensions used for NUMA placement and huge pages.
+ */
+#ifdef __linux__
+#define _DEFAULT_SOURCE
+#endif
+
 #include <assert.h>
 #include <errno.h>
 #include <inttypes.h>
@@ -17,10 +23,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #ifdef __linux__
 #include <linux/version.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #endif
 
 #ifdef __APPLE__
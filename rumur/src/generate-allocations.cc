@@ -1,4 +1,5 @@
 #include "generate.h"
+#include "layout.h"
 #include <cstddef>
 #include <iostream>
 #include <memory>
@@ -32,7 +33,7 @@ public:
 private:
   void define_backing_mem(size_t id, const TypeExpr *t) {
     if (t != nullptr && !t->is_simple())
-      *out << "  uint8_t ret" << id << "[BITS_TO_BYTES(" << t->width()
+      *out << "  uint8_t ret" << id << "[BITS_TO_BYTES(" << layout_width(*t)
            << ")];\n";
   }
 };
@@ -1,5 +1,6 @@
 #include "../../common/isa.h"
 #include "generate.h"
+#include "layout.h"
 #include "utils.h"
 #include <cassert>
 #include <cstddef>
@@ -76,6 +77,15 @@ public:
     if (lvalue && !n.is_lvalue())
       invalid(n);
 
+    // an element at a constant index of a state variable can be read directly
+    if (!lvalue && n.type()->is_simple()) {
+      mpz_class offset;
+      if (get_state_offset(n, offset)) {
+        read_const(n, offset);
+        return;
+      }
+    }
+
     // First, determine the width of the array's elements
 
     const Ptr<TypeExpr> t1 = n.array->type();
@@ -84,7 +94,7 @@ public:
     assert(t2 != nullptr && "array with invalid type");
 
     auto a = dynamic_cast<const Array &>(*t2);
-    mpz_class element_width = a.element_type->width();
+    mpz_class element_width = layout_width(*a.element_type);
 
     // Second, determine the minimum and maximum values of the array's index
     // type
@@ -135,7 +145,14 @@ public:
       assert(!n.rhs->type()->is_simple() &&
              "comparison between simple and complex type");
 
-      *this << "handle_eq(" << *n.lhs << ", " << *n.rhs << ")";
+      if (is_byte_aligned(*n.lhs) && is_byte_aligned(*n.rhs) &&
+          layout_width(*n.lhs->type()) % 8 == 0) {
+        const mpz_class bytes = layout_width(*n.lhs->type()) / 8;
+        *this << "(memcmp((" << *n.lhs << ").base, (" << *n.rhs << ").base, "
+              << bytes.get_str() << "ull) == 0)";
+      } else {
+        *this << "handle_eq(" << *n.lhs << ", " << *n.rhs << ")";
+      }
 
     } else {
       *this << "(" << *n.lhs << " == " << *n.rhs << ")";
@@ -175,6 +192,13 @@ public:
       const Ptr<TypeExpr> t = n.type();
       assert((!n.is_lvalue() || t != nullptr) && "lvalue without a type");
 
+      mpz_class offset;
+      if (!lvalue && n.is_lvalue() && t->is_simple() &&
+          get_state_offset(n, offset)) {
+        read_const(n, offset);
+        return;
+      }
+
       if (!lvalue && n.is_lvalue() && t->is_simple()) {
         const std::string lb = t->lower_bound();
         const std::string ub = t->upper_bound();
@@ -197,6 +221,15 @@ public:
     if (lvalue && !n.is_lvalue())
       invalid(n);
 
+    // a field of a state variable can be read directly
+    if (!lvalue && n.type()->is_simple()) {
+      mpz_class offset;
+      if (get_state_offset(n, offset)) {
+        read_const(n, offset);
+        return;
+      }
+    }
+
     const Ptr<TypeExpr> root = n.record->type();
     assert(root != nullptr);
     const Ptr<TypeExpr> resolved = root->resolve();
@@ -217,12 +250,12 @@ public:
           } else {
             generate_rvalue(*out, *n.record);
           }
-          *out << ", " << offset << ", " << f->type->width() << ")";
+          *out << ", " << offset << ", " << layout_width(*f->type) << ")";
           if (!lvalue && f->type->is_simple())
             *out << ")";
           return;
         }
-        offset += f->type->width();
+        offset += layout_width(*f->type);
       }
       throw Error("no field named \"" + n.field + "\" in record", n.loc);
     }
@@ -341,10 +374,10 @@ public:
         assert(method >= 1 && method <= 5);
 
         if (method == 1 || method == 2 || method == 3)
-          *out << "uint8_t " << storage << "[BITS_TO_BYTES(" << p->width()
+          *out << "uint8_t " << storage << "[BITS_TO_BYTES(" << layout_width(*p)
                << ")] = { 0 }; "
                << "struct handle " << handle << " = { .base = " << storage
-               << ", .offset = 0, .width = " << p->width() << "ull }; ";
+               << ", .offset = 0, .width = " << layout_width(*p) << "ull }; ";
 
         if (method == 1) {
           const std::string lb = p->get_type()->lower_bound();
@@ -382,7 +415,7 @@ public:
                << "} ";
 
         } else if (method == 3) {
-          assert(a->type()->width() == p->width() &&
+          assert(layout_width(*a->type()) == layout_width(*p) &&
                  "complex function "
                  "parameter receiving an argument of a differing width");
 
@@ -401,7 +434,8 @@ public:
     // Pass the return type output parameter if required.
     if (return_type != nullptr && !return_type->is_simple())
       *out << ", (struct handle){ .base = ret" << n.unique_id
-           << ", .offset = 0ul, .width = " << return_type->width() << "ull }";
+           << ", .offset = 0ul, .width = " << layout_width(*return_type)
+           << "ull }";
 
     // Now emit the arguments to the function.
     {
@@ -516,7 +550,14 @@ public:
       assert(!n.rhs->type()->is_simple() &&
              "comparison between simple and complex type");
 
-      *this << "(!handle_eq(" << *n.lhs << ", " << *n.rhs << "))";
+      if (is_byte_aligned(*n.lhs) && is_byte_aligned(*n.rhs) &&
+          layout_width(*n.lhs->type()) % 8 == 0) {
+        const mpz_class bytes = layout_width(*n.lhs->type()) / 8;
+        *this << "(memcmp((" << *n.lhs << ").base, (" << *n.rhs << ").base, "
+              << bytes.get_str() << "ull) != 0)";
+      } else {
+        *this << "(!handle_eq(" << *n.lhs << ", " << *n.rhs << "))";
+      }
 
     } else {
       *this << "(" << *n.lhs << " != " << *n.rhs << ")";
@@ -570,6 +611,15 @@ private:
   void invalid(const Expr &n) const {
     throw Error("invalid expression used as lvalue", n.loc);
   }
+
+  // generate a read of a simple value at the given offset in the state
+  void read_const(const Expr &n, const mpz_class &offset) {
+    const Ptr<TypeExpr> t = n.type();
+    *out << "check_read(" << to_C_string(n.loc) << ", rule_name, "
+         << to_C_string(n) << ", s, " << t->lower_bound() << ", "
+         << t->upper_bound() << ", read_const(s, " << offset << "ull, "
+         << layout_width(*t) << "ull))";
+  }
 };
 
 } // namespace
@@ -583,3 +633,103 @@ void generate_rvalue(std::ostream &out, const Expr &e) {
   Generator g(out, false);
   g.dispatch(e);
 }
+
+bool is_byte_aligned(const Expr &e) {
+
+  if (auto i = dynamic_cast<const ExprID *>(&e)) {
+    if (auto a = dynamic_cast<const AliasDecl *>(i->value.get()))
+      return is_byte_aligned(*a->value);
+
+    // only state variables have a known offset; local variables and parameters
+    // may refer to anything
+    if (auto v = dynamic_cast<const VarDecl *>(i->value.get()))
+      return v->is_in_state() && v->offset % 8 == 0;
+
+    return false;
+  }
+
+  if (auto f = dynamic_cast<const Field *>(&e)) {
+    if (!is_byte_aligned(*f->record))
+      return false;
+    const Ptr<TypeExpr> t = f->record->type()->resolve();
+    auto r = dynamic_cast<const Record &>(*t);
+    mpz_class offset = 0;
+    for (const Ptr<VarDecl> &field : r.fields) {
+      if (field->name == f->field)
+        return offset % 8 == 0;
+      offset += layout_width(*field->type);
+    }
+    return false;
+  }
+
+  if (auto el = dynamic_cast<const Element *>(&e)) {
+    if (!is_byte_aligned(*el->array))
+      return false;
+    const Ptr<TypeExpr> t = el->array->type()->resolve();
+    auto a = dynamic_cast<const Array &>(*t);
+    return layout_width(*a.element_type) % 8 == 0;
+  }
+
+  return false;
+}
+
+bool get_state_offset(const Expr &e, mpz_class &offset) {
+
+  if (auto i = dynamic_cast<const ExprID *>(&e)) {
+    if (auto a = dynamic_cast<const AliasDecl *>(i->value.get()))
+      return get_state_offset(*a->value, offset);
+
+    if (auto v = dynamic_cast<const VarDecl *>(i->value.get())) {
+      if (!v->is_in_state())
+        return false;
+      offset = v->offset;
+      return true;
+    }
+
+    return false;
+  }
+
+  if (auto f = dynamic_cast<const Field *>(&e)) {
+    if (!get_state_offset(*f->record, offset))
+      return false;
+    const Ptr<TypeExpr> t = f->record->type()->resolve();
+    auto r = dynamic_cast<const Record &>(*t);
+    for (const Ptr<VarDecl> &field : r.fields) {
+      if (field->name == f->field)
+        return true;
+      offset += layout_width(*field->type);
+    }
+    return false;
+  }
+
+  if (auto el = dynamic_cast<const Element *>(&e)) {
+    if (!el->index->constant())
+      return false;
+    const Ptr<TypeExpr> t = el->array->type()->resolve();
+    auto a = dynamic_cast<const Array &>(*t);
+
+    // find the position of the index, leaving out-of-range indices to the
+    // checks in handle_index()
+    const Ptr<TypeExpr> it = a.index_type->resolve();
+    mpz_class index = el->index->constant_fold();
+    mpz_class min, max;
+    if (auto r = dynamic_cast<const Range *>(it.get())) {
+      min = r->min->constant_fold();
+      max = r->max->constant_fold();
+    } else if (auto en = dynamic_cast<const Enum *>(it.get())) {
+      min = 0;
+      max = en->count() - 1;
+    } else {
+      return false;
+    }
+    if (index < min || index > max)
+      return false;
+
+    if (!get_state_offset(*el->array, offset))
+      return false;
+    offset += (index - min) * layout_width(*a.element_type);
+    return true;
+  }
+
+  return false;
+}
@@ -1,6 +1,7 @@
 #include "../../common/escape.h"
 #include "../../common/isa.h"
 #include "generate.h"
+#include "options.h"
 #include "symmetry-reduction.h"
 #include <cassert>
 #include <cstddef>
@@ -528,87 +529,12 @@ void generate_model(std::ostream &out, const Model &m) {
         << "}\n\n";
   }
 
-  // Write final liveness checker, the one that runs just prior to termination
+  // Write the successor generator for the final liveness check, the one that
+  // runs just prior to termination
   {
-    out << "static void check_liveness_final(void) {\n"
+    out << "static void check_liveness_successors(struct state *NONNULL s) {\n"
         << "\n"
         << "  static const char *rule_name __attribute__((unused)) = NULL;\n"
-        << "\n"
-        << "  if (!MACHINE_READABLE_OUTPUT) {\n"
-        << "    put(\"trying to prove remaining liveness "
-           "constraints...\\n\");\n"
-        << "  }\n"
-        << "\n"
-        << "  /* find how many liveness bits are unknown */\n"
-        << "  unsigned long remaining = 0;\n"
-        << "  unsigned long long last_update = 0;\n"
-        << "  unsigned long learned_since_last = 0;\n"
-        << "  if (!MACHINE_READABLE_OUTPUT) {\n"
-        << "    for (size_t i = 0; i < set_size(local_seen); i++) {\n"
-        << "\n"
-        << "      slot_t slot = __atomic_load_n(&local_seen->bucket[i], "
-           "__ATOMIC_SEQ_CST);\n"
-        << "\n"
-        << "      ASSERT(!slot_is_tombstone(slot)\n"
-        << "        && \"seen set being migrated during final liveness "
-           "check\");\n"
-        << "\n"
-        << "      if (slot_is_empty(slot)) {\n"
-        << "        /* skip empty entries in the hash table */\n"
-        << "        continue;\n"
-        << "      }\n"
-        << "\n"
-        << "      struct state *s = slot_to_state(slot);\n"
-        << "      ASSERT(s != NULL && \"null pointer stored in state set\");\n"
-        << "\n"
-        << "      remaining += unknown_liveness(s);\n"
-        << "    }\n"
-        << "    put(\"\\t \");\n"
-        << "    put_uint(remaining);\n"
-        << "    put(\" constraints remaining\\n\");\n"
-        << "    last_update = gettime();\n"
-        << "  }\n"
-        << "\n"
-        << "  bool progress = true;\n"
-        << "  while (progress) {\n"
-        << "    progress = false;\n"
-        << "\n"
-        << "    /* Run through all seen states trying to learn new liveness "
-           "information. */\n"
-        << "    for (size_t i = 0; i < set_size(local_seen); i++) {\n"
-        << "\n"
-        << "      slot_t slot = __atomic_load_n(&local_seen->bucket[i], "
-           "__ATOMIC_SEQ_CST);\n"
-        << "\n"
-        << "      ASSERT(!slot_is_tombstone(slot)\n"
-        << "        && \"seen set being migrated during final liveness "
-           "check\");\n"
-        << "\n"
-        << "      if (slot_is_empty(slot)) {\n"
-        << "        /* skip empty entries in the hash table */\n"
-        << "        continue;\n"
-        << "      }\n"
-        << "\n"
-        << "      struct state *s = slot_to_state(slot);\n"
-        << "      ASSERT(s != NULL && \"null pointer stored in state set\");\n"
-        << "\n"
-        << "      if (unknown_liveness(s) == 0) {\n"
-        << "        /* skip entries where liveness is fully satisfied already "
-           "*/\n"
-        << "        continue;\n"
-        << "      }\n"
-        << "\n"
-        << "#if BOUND > 0\n"
-        << "      /* If we're doing bounded checking and this state is at the "
-           "bound limit,\n"
-        << "       * it's not valid to expand beyond this.\n"
-        << "       */\n"
-        << "      ASSERT(state_bound_get(s) <= BOUND && \"a state that "
-           "exceeded the bound depth was explored\");\n"
-        << "      if (state_bound_get(s) == BOUND) {\n"
-        << "        continue;\n"
-        << "      }\n"
-        << "#endif\n"
         << "\n";
     size_t index = 0;
     for (const Ptr<Node> &c : m.children) {
@@ -621,88 +547,56 @@ void generate_model(std::ostream &out, const Model &m) {
                    "miscounted simple rules during model generation");
 
             // open a scope so we do not have to think about name collisions
-            out << "      {\n";
+            out << "  {\n";
 
             for (const Quantifier &q : r->quantifiers)
               generate_quantifier_header(out, q);
 
             out
                 // use a dummy do-while to give us 'break' as a local goto
-                << "        do {\n"
-                << "          struct state *n = state_dup(s);\n"
-                << "\n"
-                << "          int g = guard" << index << "(n";
+                << "    do {\n"
+                << "      int g = guard" << index << "(s";
             for (const Quantifier &q : r->quantifiers)
               out << ", ru_" << q.name;
             out << ");\n"
-                << "          if (g == -1) {\n"
-                << "            /* guard triggered an error */\n"
-                << "            state_free(n);\n"
-                << "            break;\n"
-                << "          } else if (g == 1) {\n"
-                << "            if (!rule" << index << "(n";
+                << "      if (g == -1) {\n"
+                << "        /* guard triggered an error */\n"
+                << "        break;\n"
+                << "      } else if (g == 1) {\n"
+                << "        struct state *n = state_dup(s);\n"
+                << "        if (!rule" << index << "(n";
             for (const Quantifier &q : r->quantifiers)
               out << ", ru_" << q.name;
             out << ")) {\n"
-                << "              /* this rule triggered an error */\n"
-                << "              state_free(n);\n"
-                << "              break;\n"
-                << "            }\n"
-                << "            state_canonicalise(n);\n"
-                << "            if (!check_assumptions(n)) {\n"
-                << "              /* assumption violated */\n"
-                << "              state_free(n);\n"
-                << "              break;\n"
-                << "            }\n"
+                << "          /* this rule triggered an error */\n"
+                << "          state_free(n);\n"
+                << "          break;\n"
+                << "        }\n"
+                << "        state_canonicalise(n);\n"
+                << "        if (!check_assumptions(n)) {\n"
+                << "          /* assumption violated */\n"
+                << "          state_free(n);\n"
+                << "          break;\n"
+                << "        }\n"
                 << "\n"
-                << "            /* note that we can skip an invariant check "
+                << "        /* note that we can skip an invariant check "
                    "because we already know it\n"
-                << "             * passed from prior expansion of this state.\n"
-                << "             */\n"
+                << "         * passed from prior expansion of this state.\n"
+                << "         */\n"
                 << "\n"
-                << "            /* We should be able to find this state in the "
+                << "        /* We should be able to find this state in the "
                    "seen set. */\n"
-                << "            const struct state *t = set_find(n);\n"
-                << "            ASSERT(t != NULL && \"state encountered during "
+                << "        const struct state *t = set_find(n);\n"
+                << "        ASSERT(t != NULL && \"state encountered during "
                    "final liveness wrap up \"\n"
-                << "              \"that was not previously seen\");\n"
+                << "          \"that was not previously seen\");\n"
                 << "\n"
-                << "            /* See if this successor state learned a "
-                   "liveness property it never\n"
-                << "             * passed back to us. This can occur if the "
-                   "state our exploration\n"
-                << "             * encountered (`n`) was not the first of its "
-                   "kind seen and thus was\n"
-                << "             * de-duped and never made it into the seen "
-                   "set with a back pointer\n"
-                << "             * to `s`.\n"
-                << "             */\n"
-                << "            unsigned long learned = learn_liveness(s, t);\n"
-                << "            if (learned > 0) {\n"
-                << "              if (!MACHINE_READABLE_OUTPUT) {\n"
-                << "                learned_since_last += learned;\n"
-                << "                remaining -= learned;\n"
-                << "                unsigned long long t = gettime();\n"
-                << "                if (t > last_update) {\n"
-                << "                  put(\"\\t \");\n"
-                << "                  put_uint(learned_since_last);\n"
-                << "                  put(\" further liveness constraints "
-                   "proved in \");\n"
-                << "                  put_uint(t - last_update);\n"
-                << "                  put(\"s, with \");\n"
-                << "                  put(green()); put_uint(remaining); "
-                   "put(reset());\n"
-                << "                  put(\" remaining\\n\");\n"
-                << "                  learned_since_last = 0;\n"
-                << "                  last_update = t;\n"
-                << "                }\n"
-                << "              }\n"
-                << "              progress = true;\n"
-                << "            }\n"
-                << "          }\n"
-                << "          /* we don't need this state anymore. */\n"
-                << "          state_free(n);\n"
-                << "        } while (0);\n";
+                << "        liveness_successor(s, t);\n"
+                << "\n"
+                << "        /* we don't need this state anymore. */\n"
+                << "        state_free(n);\n"
+                << "      }\n"
+                << "    } while (0);\n";
 
             // close the quantifier loops
             for (auto it = r->quantifiers.rbegin(); it != r->quantifiers.rend();
@@ -710,17 +604,14 @@ void generate_model(std::ostream &out, const Model &m) {
               generate_quantifier_footer(out, *it);
 
             // close this rule's scope
-            out << "}\n";
+            out << "  }\n";
 
             ++index;
           }
         }
       }
     }
-    out << "    }\n"
-        << "  }\n"
-        << "}\n"
-        << "\n"
+    out << "}\n"
         << "\n"
         << "static unsigned long check_liveness_summarise(void) {\n"
         << "\n"
@@ -920,8 +811,127 @@ void generate_model(std::ostream &out, const Model &m) {
     out << "}\n\n";
   }
 
+  // Write the logic for inserting a batch of successor states into the seen set
+  // and queue
+  if (options.search == Search::BFS) {
+    out << "/* Insert a batch of successors, returning whether all of them "
+           "were new. */\n"
+        << "static bool explore_successors(struct state *NONNULL *NONNULL "
+           "successors,\n"
+        << "                               const size_t *NONNULL hashes, "
+           "size_t count,\n"
+        << "                               size_t *NONNULL queue_id,\n"
+        << "                               size_t *NONNULL last_queue_size) "
+           "{\n"
+        << "\n"
+        << "  bool all_new = true;\n"
+        << "\n"
+        << "  /* New states to be enqueued. */\n"
+        << "  struct state *fresh[SUCCESSOR_BATCH];\n"
+        << "  size_t fresh_count = 0;\n"
+        << "\n"
+        << "  /* Seen set size to report progress at, if any. */\n"
+        << "  size_t report = 0;\n"
+        << "\n"
+        << "  for (size_t i = 0; i < count; i++) {\n"
+        << "    struct state *n = successors[i];\n"
+        << "\n"
+        << "    size_t size;\n"
+        << "    if (!set_insert_hashed(n, hashes[i], &size)) {\n"
+        << "      state_free(n);\n"
+        << "      all_new = false;\n"
+        << "      continue;\n"
+        << "    }\n"
+        << "\n"
+        << "    if (!check_covers(n)) {\n"
+        << "      /* one of the cover properties triggered an error */\n"
+        << "      all_new = false;\n"
+        << "      continue;\n"
+        << "    }\n"
+        << "#if LIVENESS_COUNT > 0\n"
+        << "    if (!check_liveness(n)) {\n"
+        << "      /* one of the liveness properties triggered an error */\n"
+        << "      all_new = false;\n"
+        << "      continue;\n"
+        << "    }\n"
+        << "#endif\n"
+        << "\n"
+        << "#if BOUND > 0\n"
+        << "    if (state_bound_get(n) >= BOUND) {\n"
+        << "      if (!SET_STORES_STATES) {\n"
+        << "        /* this state will not be expanded, so is no longer needed "
+           "*/\n"
+        << "        state_free(n);\n"
+        << "      }\n"
+        << "      continue;\n"
+        << "    }\n"
+        << "#endif\n"
+        << "\n"
+        << "    fresh[fresh_count] = n;\n"
+        << "    fresh_count++;\n"
+        << "\n"
+        << "    /* report progress each time this thread adds another 10000 "
+           "states */\n"
+        << "    if (size % 10000 == 0) {\n"
+        << "      report = seen_count();\n"
+        << "    }\n"
+        << "  }\n"
+        << "\n"
+        << "  if (fresh_count == 0) {\n"
+        << "    return all_new;\n"
+        << "  }\n"
+        << "\n"
+        << "  size_t queue_size = queue_enqueue_batch(fresh, fresh_count, "
+           "thread_id);\n"
+        << "  *queue_id = thread_id;\n"
+        << "\n"
+        << "  if (report > 0 && ftrylockfile(stdout) == 0) {\n"
+        << "    if (MACHINE_READABLE_OUTPUT) {\n"
+        << "      put(\"<progress states=\\\"\");\n"
+        << "      put_uint(report);\n"
+        << "      put(\"\\\" duration_seconds=\\\"\");\n"
+        << "      put_uint(gettime());\n"
+        << "      put(\"\\\" rules_fired=\\\"\");\n"
+        << "      put_uint(rules_fired_local);\n"
+        << "      put(\"\\\" queue_size=\\\"\");\n"
+        << "      put_uint(queue_size);\n"
+        << "      put(\"\\\" thread_id=\\\"\");\n"
+        << "      put_uint(thread_id);\n"
+        << "      put(\"\\\"/>\\n\");\n"
+        << "    } else {\n"
+        << "      put(\"\\t \");\n"
+        << "      if (THREADS > 1) {\n"
+        << "        put(\"thread \");\n"
+        << "        put_uint(thread_id);\n"
+        << "        put(\": \");\n"
+        << "      }\n"
+        << "      put_uint(report);\n"
+        << "      put(\" states explored in \");\n"
+        << "      put_uint(gettime());\n"
+        << "      put(\"s, with \");\n"
+        << "      put_uint(rules_fired_local);\n"
+        << "      put(\" rules fired and \");\n"
+        << "      put(queue_size > *last_queue_size ? yellow() : green());\n"
+        << "      put_uint(queue_size);\n"
+        << "      put(reset());\n"
+        << "      put(\" states in the queue.\\n\");\n"
+        << "    }\n"
+        << "    funlockfile(stdout);\n"
+        << "    *last_queue_size = queue_size;\n"
+        << "  }\n"
+        << "\n"
+        << "  if (THREADS > 1 && thread_id == 0 && phase == WARMUP && "
+           "queue_size > 20) {\n"
+        << "    start_secondary_threads();\n"
+        << "    phase = RUN;\n"
+        << "  }\n"
+        << "\n"
+        << "  return all_new;\n"
+        << "}\n\n";
+  }
+
   // Write exploration logic
-  {
+  if (options.search == Search::BFS) {
     out << "static void explore(void) {\n"
         << "\n"
         << "  /* Used when writing to quantifier variables. */\n"
@@ -932,6 +942,13 @@ void generate_model(std::ostream &out, const Model &m) {
         << "  /* Identifier of the last queue we interacted with. */\n"
         << "  size_t queue_id = thread_id;\n"
         << "\n"
+        << "  /* Successors of the current state awaiting insertion into the "
+           "seen set, and\n"
+        << "   * their hashes.\n"
+        << "   */\n"
+        << "  struct state *successors[SUCCESSOR_BATCH];\n"
+        << "  size_t successor_hashes[SUCCESSOR_BATCH];\n"
+        << "\n"
         << "  for (;;) {\n"
         << "\n"
         << "    if (THREADS > 1 && __atomic_load_n(&error_count,\n"
@@ -940,12 +957,42 @@ void generate_model(std::ostream &out, const Model &m) {
         << "      break;\n"
         << "    }\n"
         << "\n"
+        << "#if CHECKPOINT\n"
+        << "    checkpoint_poll();\n"
+        << "#endif\n"
+        << "#if MEMORY_LIMIT > 0\n"
+        << "    eviction_poll();\n"
+        << "#endif\n"
+        << "\n"
         << "    const struct state *s = queue_dequeue(&queue_id);\n"
         << "    if (s == NULL) {\n"
         << "      break;\n"
         << "    }\n"
         << "\n"
         << "    bool possible_deadlock = true;\n"
+        << "    size_t successor_count = 0;\n"
+        << "\n"
+        << "    /* Whether every successor found so far was new. */\n"
+        << "    bool all_new = true;\n"
+        << "\n"
+        << "#if PARTIAL_ORDER_REDUCTION\n"
+        << "    /* The first pass only evaluates every guard. The second fires "
+           "the enabled\n"
+        << "     * rule instances of one independent component, or all of "
+           "them if there is\n"
+        << "     * no such component. The third fires the remainder, if the "
+           "second found a\n"
+        << "     * state already seen and so may have closed a cycle.\n"
+        << "     */\n"
+        << "    int8_t guards[POR_INSTANCES];\n"
+        << "    uint32_t ample = POR_NONE;\n"
+        << "    for (int pass = 0; pass < 3; pass++) {\n"
+        << "    if (pass == 1) {\n"
+        << "      ample = por_ample(guards);\n"
+        << "    } else if (pass == 2 && (ample == POR_NONE || all_new)) {\n"
+        << "      break;\n"
+        << "    }\n"
+        << "#endif\n"
         << "    uint64_t rule_taken = 1;\n";
     size_t index = 0;
     for (const Ptr<Node> &c : m.children) {
@@ -966,25 +1013,48 @@ void generate_model(std::ostream &out, const Model &m) {
             out
                 // use a dummy do-while to give us 'break' as a local goto
                 << "      do {\n"
-                << "        struct state *n = state_dup(s);\n"
-                << "#if COUNTEREXAMPLE_TRACE != CEX_OFF\n"
-                << "        state_rule_taken_set(n, rule_taken);\n"
-                << "#endif\n"
-                << "        int g = guard" << index << "(n";
+                << "        /* evaluate the guard against the current state, "
+                   "to avoid copying it\n"
+                << "         * for rules that are not enabled\n"
+                << "         */\n"
+                << "#if PARTIAL_ORDER_REDUCTION\n"
+                << "        if (pass == 0) {\n"
+                << "          guards[rule_taken - 1] = (int8_t)guard" << index
+                << "(s";
             for (const Quantifier &q : r->quantifiers)
               out << ", ru_" << q.name;
             out << ");\n"
+                << "          break;\n"
+                << "        }\n"
+                << "        int g = guards[rule_taken - 1];\n"
+                << "        bool in_ample = ample == POR_NONE ||\n"
+                << "                        POR_COMPONENT[rule_taken - 1] == "
+                   "ample;\n"
+                << "        if (in_ample != (pass == 1)) {\n"
+                << "          /* fired in the other pass */\n"
+                << "          break;\n"
+                << "        }\n"
+                << "#else\n"
+                << "        int g = guard" << index << "(s";
+            for (const Quantifier &q : r->quantifiers)
+              out << ", ru_" << q.name;
+            out << ");\n"
+                << "#endif\n"
                 << "        if (g == -1) {\n"
                 << "          /* error() was called */\n"
-                << "          state_free(n);\n"
                 << "          break;\n"
                 << "        } else if (g == 1) {\n"
+                << "          struct state *n = state_dup(s);\n"
+                << "#if COUNTEREXAMPLE_TRACE != CEX_OFF\n"
+                << "          state_rule_taken_set(n, rule_taken);\n"
+                << "#endif\n"
                 << "          if (!rule" << index << "(n";
             for (const Quantifier &q : r->quantifiers)
               out << ", ru_" << q.name;
             out << ")) {\n"
                 << "            /* this rule triggered an error */\n"
                 << "            state_free(n);\n"
+                << "            all_new = false;\n"
                 << "            break;\n"
                 << "          }\n"
                 << "          rules_fired_local++;\n"
@@ -996,87 +1066,34 @@ void generate_model(std::ostream &out, const Model &m) {
                 << "          if (!check_assumptions(n)) {\n"
                 << "            /* assumption violated */\n"
                 << "            state_free(n);\n"
+                << "            all_new = false;\n"
                 << "            break;\n"
                 << "          }\n"
                 << "          if (!check_invariants(n)) {\n"
                 << "            /* invariant violated */\n"
                 << "            state_free(n);\n"
+                << "            all_new = false;\n"
                 << "            break;\n"
                 << "          }\n"
-                << "          size_t size;\n"
-                << "          if (set_insert(n, &size)) {\n"
-                << "\n"
-                << "            if (!check_covers(n)) {\n"
-                << "              /* one of the cover properties triggered an "
-                   "error */\n"
-                << "              break;\n"
-                << "            }\n"
-                << "#if LIVENESS_COUNT > 0\n"
-                << "            if (!check_liveness(n)) {\n"
-                << "              /* one of the liveness properties triggered "
-                   "an error */\n"
-                << "              break;\n"
-                << "            }\n"
-                << "#endif\n"
-                << "\n"
-                << "#if BOUND > 0\n"
-                << "            if (state_bound_get(n) < BOUND) {\n"
-                << "#endif\n"
-                << "            size_t queue_size = queue_enqueue(n, "
-                   "thread_id);\n"
-                << "            queue_id = thread_id;\n"
-                << "\n"
-                << "            if (size % 10000 == 0 && ftrylockfile(stdout) "
-                   "== 0) {\n"
-                << "              if (MACHINE_READABLE_OUTPUT) {\n"
-                << "                put(\"<progress states=\\\"\");\n"
-                << "                put_uint(size);\n"
-                << "                put(\"\\\" duration_seconds=\\\"\");\n"
-                << "                put_uint(gettime());\n"
-                << "                put(\"\\\" rules_fired=\\\"\");\n"
-                << "                put_uint(rules_fired_local);\n"
-                << "                put(\"\\\" queue_size=\\\"\");\n"
-                << "                put_uint(queue_size);\n"
-                << "                put(\"\\\" thread_id=\\\"\");\n"
-                << "                put_uint(thread_id);\n"
-                << "                put(\"\\\"/>\\n\");\n"
-                << "              } else {\n"
-                << "                put(\"\\t \");\n"
-                << "                if (THREADS > 1) {\n"
-                << "                  put(\"thread \");\n"
-                << "                  put_uint(thread_id);\n"
-                << "                  put(\": \");\n"
-                << "                }\n"
-                << "                put_uint(size);\n"
-                << "                put(\" states explored in \");\n"
-                << "                put_uint(gettime());\n"
-                << "                put(\"s, with \");\n"
-                << "                put_uint(rules_fired_local);\n"
-                << "                put(\" rules fired and \");\n"
-                << "                put(queue_size > last_queue_size ? "
-                   "yellow() : green());\n"
-                << "                put_uint(queue_size);\n"
-                << "                put(reset());\n"
-                << "                put(\" states in the queue.\\n\");\n"
-                << "              }\n"
-                << "              funlockfile(stdout);\n"
-                << "              last_queue_size = queue_size;\n"
-                << "            }\n"
-                << "\n"
-                << "            if (THREADS > 1 && thread_id == 0 && phase == "
-                   "WARMUP && queue_size > 20) {\n"
-                << "              start_secondary_threads();\n"
-                << "              phase = RUN;\n"
-                << "            }\n"
-                << "\n"
-                << "#if BOUND > 0\n"
-                << "            }\n"
-                << "#endif\n"
-                << "          } else {\n"
-                << "            state_free(n);\n"
+                << "          /* Defer insertion into the seen set, but start "
+                   "fetching the memory it\n"
+                << "           * will touch.\n"
+                << "           */\n"
+                << "          successors[successor_count] = n;\n"
+                << "          successor_hashes[successor_count] = "
+                   "set_hash_successor(n, s);\n"
+                << "          "
+                   "set_prefetch(successor_hashes[successor_count]);\n"
+                << "          successor_count++;\n"
+                << "          if (successor_count == SUCCESSOR_BATCH) {\n"
+                << "            all_new &= explore_successors(successors, "
+                   "successor_hashes,\n"
+                << "                                          "
+                   "successor_count, &queue_id,\n"
+                << "                                          "
+                   "&last_queue_size);\n"
+                << "            successor_count = 0;\n"
                 << "          }\n"
-                << "        } else {\n"
-                << "          state_free(n);\n"
                 << "        }\n"
                 << "      } while (0);\n"
                 << "      rule_taken++;\n";
@@ -1094,7 +1111,15 @@ void generate_model(std::ostream &out, const Model &m) {
         }
       }
     }
-    out << "    /* If we did not toggle 'possible_deadlock' off by this point, "
+    out << "    all_new &= explore_successors(successors, successor_hashes,\n"
+        << "                                  successor_count, &queue_id, "
+           "&last_queue_size);\n"
+        << "    successor_count = 0;\n"
+        << "#if PARTIAL_ORDER_REDUCTION\n"
+        << "    }\n"
+        << "#endif\n"
+        << "\n"
+        << "    /* If we did not toggle 'possible_deadlock' off by this point, "
            "we\n"
         << "     * have a deadlock.\n"
         << "     */\n"
@@ -1103,11 +1128,29 @@ void generate_model(std::ostream &out, const Model &m) {
         << "      deadlock(s);\n"
         << "    }\n"
         << "\n"
+        << "    if (!SET_STORES_STATES) {\n"
+        << "      /* the seen set does not refer to this state, so we can now "
+           "reclaim it */\n"
+        << "      state_free(state_drop_const(s));\n"
+        << "    }\n"
+        << "\n"
         << "  }\n"
         << "  exit_with(EXIT_SUCCESS);\n"
         << "}\n\n";
   }
 
+  // Write depth-first exploration logic
+  if (options.search == Search::DFS) {
+    generate_fire_instance(out, m);
+    generate_dfs(out);
+  }
+
+  // Write random simulation logic
+  if (options.search == Search::SIMULATE) {
+    generate_fire_instance(out, m);
+    generate_simulate(out);
+  }
+
   // Write a function to print the state.
   out << "static void state_print(const struct state *previous, const struct "
       << "state *NONNULL s) {\n";
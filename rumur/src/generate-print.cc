@@ -1,5 +1,6 @@
 #include "../../common/escape.h"
 #include "generate.h"
+#include "layout.h"
 #include "options.h"
 #include <cassert>
 #include <cstddef>
@@ -140,7 +141,7 @@ public:
       p << "]";
 
       // construct a dynamic handle to the current element
-      mpz_class w = n.element_type->width();
+      mpz_class w = layout_width(*n.element_type);
       const std::string o = "(" + i + " * ((size_t)" + w.get_str() + "ull))";
       const std::string h = derive_handle(current_handle, o, w);
       const std::string ph = derive_handle(previous_handle, o, w);
@@ -274,7 +275,7 @@ public:
       p << "]";
 
       // construct a dynamic handle to the current element
-      mpz_class w = n.element_type->width();
+      mpz_class w = layout_width(*n.element_type);
       const std::string o = "(" + j + " * ((size_t)" + w.get_str() + "ull))";
       const std::string h = derive_handle(current_handle, o, w);
 
@@ -300,7 +301,7 @@ public:
     if (auto e = dynamic_cast<const Enum *>(t.get())) {
 
       mpz_class preceding_offset = 0;
-      mpz_class w = n.element_type->width();
+      mpz_class w = layout_width(*n.element_type);
       for (const std::pair<std::string, location> &m : e->members) {
         Printf p = prefix;
         p << "[" << m.first << "]";
@@ -397,7 +398,7 @@ public:
   void visit_record(const Record &n) final {
     mpz_class preceding_offset = 0;
     for (auto &f : n.fields) {
-      mpz_class w = f->width();
+      mpz_class w = layout_width(*f);
       Printf p = prefix;
       p << "." << f->name;
       const std::string h = derive_handle(current_handle, preceding_offset, w);
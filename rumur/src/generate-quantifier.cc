@@ -1,4 +1,5 @@
 #include "generate.h"
+#include "layout.h"
 #include <cassert>
 #include <cstddef>
 #include <iostream>
@@ -21,7 +22,8 @@ void generate_quantifier_header(std::ostream &out, const Quantifier &q) {
 
   // Calculate the width of the loop counter type. Use the VarDecl that
   // references to this variable will be referring to.
-  std::string width = "((size_t)" + q.decl->type->width().get_str() + "ull)";
+  std::string width =
+      "((size_t)" + layout_width(*q.decl->type).get_str() + "ull)";
 
   // open a scope to allow us to use the names 'lb', 'ub', and 'step' without
   // worrying about collisions
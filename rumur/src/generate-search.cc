@@ -0,0 +1,306 @@
+#include "../../common/isa.h"
+#include "generate.h"
+#include "layout.h"
+#include <cassert>
+#include <cstddef>
+#include <gmpxx.h>
+#include <iostream>
+#include <rumur/rumur.h>
+#include <string>
+#include <vector>
+
+using namespace rumur;
+
+namespace {
+// the values a ruleset quantifier ranges over, as an arithmetic progression
+struct Progression {
+  mpz_class lb;
+  mpz_class step;
+  mpz_class count;
+};
+} // namespace
+
+static Progression get_progression(const Quantifier &q) {
+
+  assert(q.constant() && "non-constant quantifier in ruleset");
+
+  Progression p;
+  p.count = q.count();
+
+  if (q.type != nullptr) {
+    p.lb = 0;
+    const Ptr<TypeExpr> t = q.type->resolve();
+    if (auto r = dynamic_cast<const Range *>(t.get()))
+      p.lb = r->min->constant_fold();
+    p.step = 1;
+    return p;
+  }
+
+  p.lb = q.from->constant_fold();
+  const mpz_class ub = q.to->constant_fold();
+  p.step = ub >= p.lb ? 1 : -1;
+  if (q.step != nullptr)
+    p.step = q.step->constant_fold();
+  return p;
+}
+
+void generate_fire_instance(std::ostream &out, const Model &m) {
+
+  out << "static int fire_instance(const struct state *NONNULL s, uint64_t "
+         "instance,\n"
+      << "                         struct state *NONNULL *NONNULL n) {\n"
+      << "\n"
+      << "  ASSERT(instance >= 1 && instance <= RULE_INSTANCES &&\n"
+      << "         \"rule instance out of range\");\n"
+      << "  uint64_t i __attribute__((unused)) = instance - 1;\n"
+      << "\n";
+
+  size_t index = 0;
+  for (const Ptr<Node> &c : m.children) {
+    auto rule = dynamic_cast<const Rule *>(c.get());
+    if (rule == nullptr)
+      continue;
+
+    for (const Ptr<Rule> &r : rule->flatten()) {
+      if (!isa<SimpleRule>(r))
+        continue;
+
+      // the number of instances of this rule, and of each suffix of its
+      // quantifiers, the last of which varies fastest
+      std::vector<Progression> ps;
+      for (const Quantifier &q : r->quantifiers)
+        ps.push_back(get_progression(q));
+      std::vector<mpz_class> stride(ps.size() + 1, 1);
+      for (size_t j = ps.size(); j > 0; j--)
+        stride[j - 1] = stride[j] * ps[j - 1].count;
+      const mpz_class &count = stride[0];
+
+      out << "  if (i < " << count << "ull) {\n";
+
+      // decode the value of each quantifier from the instance number
+      for (size_t j = 0; j < ps.size(); j++) {
+        const Quantifier &q = r->quantifiers[j];
+        const std::string width =
+            "((size_t)" + layout_width(*q.decl->type).get_str() + "ull)";
+        out << "    {\n"
+            << "    uint8_t _ru2_" << q.name << "[BITS_TO_BYTES(" << width
+            << ")] = { 0 };\n"
+            << "    struct handle ru_" << q.name << " = { .base = _ru2_"
+            << q.name << ", .offset = 0, .width = " << width << " };\n"
+            << "    handle_write_raw(s, ru_" << q.name
+            << ", (raw_value_t)((raw_value_t)((raw_value_t)VALUE_C("
+            << ps[j].lb << ") + (raw_value_t)1) - (raw_value_t)("
+            << q.decl->type->lower_bound() << ")) + (raw_value_t)(i / "
+            << stride[j + 1] << "ull % " << ps[j].count
+            << "ull) * (raw_value_t)VALUE_C(" << ps[j].step << "));\n";
+      }
+
+      out << "    int g = guard" << index << "(s";
+      for (const Quantifier &q : r->quantifiers)
+        out << ", ru_" << q.name;
+      out << ");\n"
+          << "    if (g != 1) {\n"
+          << "      return g;\n"
+          << "    }\n"
+          << "    *n = state_dup(s);\n"
+          << "#if COUNTEREXAMPLE_TRACE != CEX_OFF\n"
+          << "    state_rule_taken_set(*n, instance);\n"
+          << "#endif\n"
+          << "    if (!rule" << index << "(*n";
+      for (const Quantifier &q : r->quantifiers)
+        out << ", ru_" << q.name;
+      out << ")) {\n"
+          << "      /* this rule triggered an error */\n"
+          << "      state_free(*n);\n"
+          << "      return -1;\n"
+          << "    }\n"
+          << "    return 1;\n";
+
+      for (size_t j = 0; j < ps.size(); j++)
+        out << "    }\n";
+
+      out << "  }\n"
+          << "  i -= " << count << "ull;\n"
+          << "\n";
+
+      ++index;
+    }
+  }
+
+  out << "  ASSERT(!\"rule instance out of range\");\n"
+      << "  return 0;\n"
+      << "}\n\n";
+}
+
+void generate_dfs(std::ostream &out) {
+
+  out << "static void explore(void) {\n"
+      << "\n"
+      << "  if (thread_id == 0) {\n"
+      << "    take_start_states();\n"
+      << "    if (THREADS > 1) {\n"
+      << "      start_secondary_threads();\n"
+      << "      phase = RUN;\n"
+      << "    }\n"
+      << "  }\n"
+      << "  dfs_thread_init();\n"
+      << "\n"
+      << "  for (size_t r = 0; r < start_state_count; r++) {\n"
+      << "\n"
+      << "    /* start each thread from a different start state, where there "
+         "are several */\n"
+      << "    dfs_push(start_states[(r + thread_id) % start_state_count]);\n"
+      << "\n"
+      << "    while (dfs_depth > 0) {\n"
+      << "\n"
+      << "      if (THREADS > 1 && __atomic_load_n(&error_count,\n"
+      << "          __ATOMIC_SEQ_CST) >= MAX_ERRORS) {\n"
+      << "        /* Another thread found an error. */\n"
+      << "        exit_with(EXIT_SUCCESS);\n"
+      << "      }\n"
+      << "\n"
+      << "      struct dfs_frame *f = &dfs_stack[dfs_depth - 1];\n"
+      << "      const struct state *s = f->state;\n"
+      << "\n"
+      << "      if (f->tried == RULE_INSTANCES) {\n"
+      << "        /* Every successor of this state has been generated. If we "
+         "did not toggle\n"
+      << "         * 'possible_deadlock' off by this point, we have a "
+         "deadlock.\n"
+      << "         */\n"
+      << "        if (DEADLOCK_DETECTION != DEADLOCK_DETECTION_OFF && "
+         "f->possible_deadlock) {\n"
+      << "          deadlock(s);\n"
+      << "        }\n"
+      << "        dfs_depth--;\n"
+      << "        if (!SET_STORES_STATES && dfs_depth > 0) {\n"
+      << "          /* the seen set does not refer to this state, so we can "
+         "now reclaim it */\n"
+      << "          state_free(state_drop_const(s));\n"
+      << "        }\n"
+      << "        continue;\n"
+      << "      }\n"
+      << "\n"
+      << "      const uint64_t instance = dfs_next_instance(f);\n"
+      << "      struct state *n = NULL;\n"
+      << "      if (fire_instance(s, instance, &n) != 1) {\n"
+      << "        continue;\n"
+      << "      }\n"
+      << "      rules_fired_local++;\n"
+      << "      if (DEADLOCK_DETECTION != DEADLOCK_DETECTION_STUTTERING || "
+         "!state_eq(s, n)) {\n"
+      << "        f->possible_deadlock = false;\n"
+      << "      }\n"
+      << "      state_canonicalise(n);\n"
+      << "      if (!check_assumptions(n)) {\n"
+      << "        /* assumption violated */\n"
+      << "        state_free(n);\n"
+      << "        continue;\n"
+      << "      }\n"
+      << "      if (!check_invariants(n)) {\n"
+      << "        /* invariant violated */\n"
+      << "        state_free(n);\n"
+      << "        continue;\n"
+      << "      }\n"
+      << "\n"
+      << "      size_t size;\n"
+      << "      if (!set_insert_hashed(n, set_hash_successor(n, s), &size)) "
+         "{\n"
+      << "        state_free(n);\n"
+      << "        continue;\n"
+      << "      }\n"
+      << "      if (!check_covers(n)) {\n"
+      << "        /* one of the cover properties triggered an error */\n"
+      << "        continue;\n"
+      << "      }\n"
+      << "#if LIVENESS_COUNT > 0\n"
+      << "      if (!check_liveness(n)) {\n"
+      << "        /* one of the liveness properties triggered an error */\n"
+      << "        continue;\n"
+      << "      }\n"
+      << "#endif\n"
+      << "\n"
+      << "      dfs_push(n);\n"
+      << "\n"
+      << "      /* report progress each time this thread adds another 10000 "
+         "states */\n"
+      << "      if (size % 10000 == 0) {\n"
+      << "        dfs_progress(seen_count());\n"
+      << "      }\n"
+      << "    }\n"
+      << "  }\n"
+      << "  exit_with(EXIT_SUCCESS);\n"
+      << "}\n\n";
+}
+
+void generate_simulate(std::ostream &out) {
+
+  out << "static void explore(void) {\n"
+      << "\n"
+      << "  if (thread_id == 0) {\n"
+      << "    take_start_states();\n"
+      << "    walks_begin();\n"
+      << "    if (THREADS > 1) {\n"
+      << "      start_secondary_threads();\n"
+      << "      phase = RUN;\n"
+      << "    }\n"
+      << "  }\n"
+      << "\n"
+      << "  uint64_t walk;\n"
+      << "  while (start_state_count > 0 && walk_claim(&walk)) {\n"
+      << "\n"
+      << "    if (THREADS > 1 && __atomic_load_n(&error_count,\n"
+      << "        __ATOMIC_SEQ_CST) >= MAX_ERRORS) {\n"
+      << "      /* Another thread found an error. */\n"
+      << "      exit_with(EXIT_SUCCESS);\n"
+      << "    }\n"
+      << "\n"
+      << "    if (walk > 0 && walk % 1000 == 0) {\n"
+      << "      walk_progress(walk);\n"
+      << "    }\n"
+      << "\n"
+      << "    uint64_t seed = walk_seed(walk);\n"
+      << "    const uint64_t stride = random_stride(&seed);\n"
+      << "    const struct state *start =\n"
+      << "        start_states[random_next(&seed) % start_state_count];\n"
+      << "    const struct state *s = start;\n"
+      << "\n"
+      << "    for (uint64_t step = 0; step < WALK_LENGTH; step++) {\n"
+      << "\n"
+      << "      struct state *n = NULL;\n"
+      << "      int r = walk_step(s, stride, &seed, &n);\n"
+      << "      if (r == 0) {\n"
+      << "        if (DEADLOCK_DETECTION != DEADLOCK_DETECTION_OFF) {\n"
+      << "          deadlock(s);\n"
+      << "        }\n"
+      << "        break;\n"
+      << "      }\n"
+      << "      if (r != 1) {\n"
+      << "        /* firing the rule triggered an error */\n"
+      << "        break;\n"
+      << "      }\n"
+      << "#if COUNTEREXAMPLE_TRACE == CEX_OFF\n"
+      << "      /* without traces, the path so far need not be kept */\n"
+      << "      walk_free(s, start);\n"
+      << "#endif\n"
+      << "      s = n;\n"
+      << "\n"
+      << "      if (!check_assumptions(s)) {\n"
+      << "        /* assumption violated */\n"
+      << "        break;\n"
+      << "      }\n"
+      << "      if (!check_invariants(s)) {\n"
+      << "        /* invariant violated */\n"
+      << "        break;\n"
+      << "      }\n"
+      << "      if (!check_covers(s)) {\n"
+      << "        /* one of the cover properties triggered an error */\n"
+      << "        break;\n"
+      << "      }\n"
+      << "    }\n"
+      << "\n"
+      << "    walk_free(s, start);\n"
+      << "  }\n"
+      << "  exit_with(EXIT_SUCCESS);\n"
+      << "}\n\n";
+}
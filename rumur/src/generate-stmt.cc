@@ -1,6 +1,7 @@
 #include "../../common/escape.h"
 #include "../../common/isa.h"
 #include "generate.h"
+#include "layout.h"
 #include "options.h"
 #include "utils.h"
 #include <cassert>
@@ -21,8 +22,8 @@ static void clear(std::ostream &out, const TypeExpr &t,
   if (t.is_simple()) {
     out << indent << "handle_write_raw(s, (struct handle){ .base = root.base + "
         << "(root.offset + " << offset << ") / CHAR_BIT, .offset = "
-        << "(root.offset + " << offset << ") % CHAR_BIT, .width = " << t.width()
-        << "ull }, 1);\n";
+        << "(root.offset + " << offset << ") % CHAR_BIT, .width = "
+        << layout_width(t) << "ull }, 1);\n";
 
     return;
   }
@@ -37,7 +38,7 @@ static void clear(std::ostream &out, const TypeExpr &t,
 
     // The bit size of each array element as a C code string
     const std::string width =
-        "((size_t)" + a->element_type->width().get_str() + "ull)";
+        "((size_t)" + layout_width(*a->element_type).get_str() + "ull)";
 
     // Generate a loop to iterate over all the elements
     const std::string var = "i" + std::to_string(depth);
@@ -65,7 +66,7 @@ static void clear(std::ostream &out, const TypeExpr &t,
 
       // Jump over this field to get the offset of the next field
       const std::string width =
-          "((size_t)" + f->type->width().get_str() + "ull)";
+          "((size_t)" + layout_width(*f->type).get_str() + "ull)";
       off += " + " + width;
     }
 
@@ -105,7 +106,21 @@ public:
 
   void visit_assignment(const Assignment &s) final {
 
-    if (s.lhs->type()->is_simple()) {
+    mpz_class offset;
+    if (s.lhs->type()->is_simple() && get_state_offset(*s.lhs, offset)) {
+      /* The target is at a fixed location in the state, so write it directly.
+       */
+      const std::string lb = s.lhs->type()->lower_bound();
+      const std::string ub = s.lhs->type()->upper_bound();
+
+      *out << "write_const(s, " << offset << "ull, "
+           << layout_width(*s.lhs->type()) << "ull, check_write("
+           << to_C_string(s.loc) << ", rule_name, "
+           << to_C_string(*s.lhs) << ", s, " << lb << ", " << ub << ", ";
+      generate_rvalue(*out, *s.rhs);
+      *out << "))";
+
+    } else if (s.lhs->type()->is_simple()) {
       const std::string lb = s.lhs->type()->lower_bound();
       const std::string ub = s.lhs->type()->upper_bound();
 
@@ -116,6 +131,18 @@ public:
       generate_rvalue(*out, *s.rhs);
       *out << ")";
 
+    } else if (is_byte_aligned(*s.lhs) && is_byte_aligned(*s.rhs) &&
+               layout_width(*s.lhs->type()) % 8 == 0) {
+      /* Both sides are whole bytes, so we can skip handle_copy's alignment
+       * logic. The two may be the same variable, so this is a memmove.
+       */
+      const mpz_class bytes = layout_width(*s.lhs->type()) / 8;
+      *out << "memmove((";
+      generate_lvalue(*out, *s.lhs);
+      *out << ").base, (";
+      generate_rvalue(*out, *s.rhs);
+      *out << ").base, " << bytes << "ull)";
+
     } else {
       *out << "handle_copy(";
       generate_lvalue(*out, *s.lhs);
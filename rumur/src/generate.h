@@ -27,6 +27,13 @@ void generate_function(std::ostream &out, const rumur::Function &f,
 
 void generate_model(std::ostream &out, const rumur::Model &m);
 
+/* Generate fire_instance(), which fires a single rule instance identified by
+ * its number, and the depth-first or random simulation explore() built on it.
+ */
+void generate_fire_instance(std::ostream &out, const rumur::Model &m);
+void generate_dfs(std::ostream &out);
+void generate_simulate(std::ostream &out);
+
 // Generate C code to print the value of the given type at the given handle.
 void generate_print(std::ostream &out, const rumur::TypeExpr &e,
                     const std::string &prefix, const std::string &handle,
@@ -43,3 +50,13 @@ void generate_quantifier_footer(std::ostream &out, const rumur::Quantifier &q);
 void generate_stmt(std::ostream &out, const rumur::Stmt &s);
 
 void generate_cover_array(std::ostream &out, const rumur::Model &model);
+
+/* Whether the handle for the given expression is known, at generation time, to
+ * start on a byte boundary.
+ */
+bool is_byte_aligned(const rumur::Expr &e);
+
+/* Whether the given expression refers to a fixed location in the state, and if
+ * so its offset in bits.
+ */
+bool get_state_offset(const rumur::Expr &e, mpz_class &offset);
@@ -0,0 +1,260 @@
+#include "layout.h"
+#include "log.h"
+#include "options.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <gmpxx.h>
+#include <rumur/rumur.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace rumur;
+
+// width of a type in the aligned layout
+static mpz_class aligned_width(const TypeExpr &t) {
+
+  const Ptr<TypeExpr> r = t.resolve();
+
+  if (r->is_simple()) {
+    const mpz_class w = r->width();
+    if (w == 0)
+      return 0;
+    for (mpz_class size = 8; size <= 64; size *= 2) {
+      if (w <= size)
+        return size;
+    }
+    // wider than any integer type, so just round up to whole bytes
+    return (w + 7) / 8 * 8;
+  }
+
+  if (auto a = dynamic_cast<const Array *>(r.get())) {
+    mpz_class i = a->index_type->count();
+    assert(i >= 1 && "index count apparently does not include undefined");
+    return (i - 1) * aligned_width(*a->element_type);
+  }
+
+  if (auto s = dynamic_cast<const Record *>(r.get())) {
+    mpz_class w = 0;
+    for (const Ptr<VarDecl> &f : s->fields)
+      w += aligned_width(*f->type);
+    return w;
+  }
+
+  assert(!"unexpected type in aligned_width()");
+  return r->width();
+}
+
+mpz_class layout_width(const TypeExpr &t) {
+  if (options.state_layout == StateLayout::ALIGNED)
+    return aligned_width(t);
+  return t.width();
+}
+
+mpz_class layout_width(const VarDecl &v) { return layout_width(*v.type); }
+
+mpz_class state_size_bits(const Model &m) {
+  mpz_class s = 0;
+  for (const Ptr<Node> &n : m.children) {
+    if (auto v = dynamic_cast<const VarDecl *>(n.get()))
+      s += layout_width(*v);
+  }
+  return s;
+}
+
+// append the pieces a value of the given type at the given offset is made of
+// to a list of (offset, width) pairs, in the order they are laid out
+static void tree_units(const TypeExpr &t, mpz_class offset,
+                       std::vector<std::pair<mpz_class, mpz_class>> &units) {
+
+  const mpz_class w = layout_width(t);
+  if (w == 0)
+    return;
+
+  // anything that fits in a leaf is kept whole
+  if (w <= TREE_LEAF_BITS) {
+    units.emplace_back(offset, w);
+    return;
+  }
+
+  const Ptr<TypeExpr> r = t.resolve();
+
+  if (auto a = dynamic_cast<const Array *>(r.get())) {
+    const mpz_class element_width = layout_width(*a->element_type);
+    for (mpz_class o = offset; o < offset + w; o += element_width)
+      tree_units(*a->element_type, o, units);
+    return;
+  }
+
+  if (auto s = dynamic_cast<const Record *>(r.get())) {
+    for (const Ptr<VarDecl> &f : s->fields) {
+      tree_units(*f->type, offset, units);
+      offset += layout_width(*f->type);
+    }
+    return;
+  }
+
+  // a scalar wider than a leaf is split into leaf-sized pieces
+  for (mpz_class o = offset; o < offset + w; o += TREE_LEAF_BITS) {
+    const mpz_class rest = offset + w - o;
+    units.emplace_back(o, rest < TREE_LEAF_BITS ? rest : TREE_LEAF_BITS);
+  }
+}
+
+std::vector<mpz_class> tree_leaf_offsets(const Model &m) {
+
+  std::vector<std::pair<mpz_class, mpz_class>> units;
+  for (const Ptr<Node> &c : m.children) {
+    if (auto v = dynamic_cast<const VarDecl *>(c.get()))
+      tree_units(*v->type, v->offset, units);
+  }
+  std::sort(units.begin(), units.end());
+
+  // pack runs of adjacent pieces into leaves
+  std::vector<mpz_class> offsets;
+  mpz_class leaf_end = 0;
+  for (const std::pair<mpz_class, mpz_class> &u : units) {
+    if (offsets.empty() || u.first + u.second - offsets.back() > TREE_LEAF_BITS)
+      offsets.push_back(u.first);
+    leaf_end = u.first + u.second;
+  }
+  offsets.push_back(leaf_end);
+
+  return offsets;
+}
+
+namespace {
+// a traversal that counts references to state variables
+class ReadCounter : public ConstTraversal {
+
+public:
+  mpz_class reads = 0;
+
+  void visit_exprid(const ExprID &n) final {
+    if (auto v = dynamic_cast<const VarDecl *>(n.value.get())) {
+      if (v->is_in_state())
+        reads++;
+    }
+  }
+};
+
+// a traversal that updates the offsets of state variables referenced by
+// ExprIDs, which hold their own copies of the variables' declarations
+class OffsetUpdater : public Traversal {
+
+public:
+  explicit OffsetUpdater(
+      const std::unordered_map<std::string, mpz_class> &offsets_)
+      : offsets(offsets_) {}
+
+  void visit_exprid(ExprID &n) final {
+    if (auto v = dynamic_cast<VarDecl *>(n.value.get())) {
+      if (v->is_in_state()) {
+        auto it = offsets.find(v->name);
+        if (it != offsets.end())
+          v->offset = it->second;
+      }
+    }
+    // an alias holds its own copy of the expression it stands for
+    if (auto a = dynamic_cast<AliasDecl *>(n.value.get()))
+      dispatch(*a->value);
+  }
+
+private:
+  const std::unordered_map<std::string, mpz_class> &offsets;
+};
+} // namespace
+
+/* Decide whether a model is better served by the aligned layout. Aligned
+ * fields are cheaper to access, but make every state larger, costing memory and
+ * time to hash, compare and copy states. So we only accept growth in the state
+ * size in proportion to how much state the model's rules read, up to 50% for
+ * rules that make ten or more references to state variables.
+ */
+static bool prefer_aligned(const Model &m) {
+
+  std::vector<Ptr<Rule>> rules;
+  for (const Ptr<Node> &c : m.children) {
+    if (auto r = dynamic_cast<const Rule *>(c.get())) {
+      for (const Ptr<Rule> &f : r->flatten())
+        rules.push_back(f);
+    }
+  }
+  if (rules.empty())
+    return false;
+
+  ReadCounter counter;
+  for (const Ptr<Rule> &r : rules)
+    counter.dispatch(*r);
+  mpz_class reads_per_rule = counter.reads / rules.size();
+  if (reads_per_rule > 10)
+    reads_per_rule = 10;
+
+  mpz_class packed = 0;
+  mpz_class aligned = 0;
+  for (const Ptr<Node> &c : m.children) {
+    if (auto v = dynamic_cast<const VarDecl *>(c.get())) {
+      packed += v->type->width();
+      aligned += aligned_width(*v->type);
+    }
+  }
+  const mpz_class packed_bytes = (packed + 7) / 8;
+  const mpz_class aligned_bytes = (aligned + 7) / 8;
+
+  *debug << "rules make " << reads_per_rule
+         << " references to state variables on average; state is "
+         << packed_bytes << " bytes packed, " << aligned_bytes
+         << " bytes aligned\n";
+
+  return aligned_bytes * 20 <= packed_bytes * (20 + reads_per_rule);
+}
+
+void layout_state(Model &m) {
+
+  if (options.state_layout == StateLayout::AUTO)
+    options.state_layout =
+        prefer_aligned(m) ? StateLayout::ALIGNED : StateLayout::PACKED;
+
+  // the packed layout is the one the model was indexed with
+  if (options.state_layout == StateLayout::PACKED)
+    return;
+
+  *debug << "using aligned state layout\n";
+
+  // collect the state variables in the order they are currently laid out
+  std::vector<const VarDecl *> vars;
+  for (const Ptr<Node> &c : m.children) {
+    if (auto v = dynamic_cast<const VarDecl *>(c.get()))
+      vars.push_back(v);
+  }
+  std::stable_sort(vars.begin(), vars.end(),
+                   [](const VarDecl *a, const VarDecl *b) {
+                     return a->offset < b->offset;
+                   });
+
+  mpz_class offset = 0;
+  std::unordered_map<std::string, mpz_class> offsets;
+  for (const VarDecl *v : vars) {
+    offsets[v->name] = offset;
+    offset += layout_width(*v);
+  }
+
+  set_state_offsets(m, offsets);
+}
+
+void set_state_offsets(
+    Model &m, const std::unordered_map<std::string, mpz_class> &offsets) {
+
+  for (Ptr<Node> &c : m.children) {
+    if (auto v = dynamic_cast<VarDecl *>(c.get())) {
+      auto it = offsets.find(v->name);
+      if (it != offsets.end())
+        v->offset = it->second;
+    }
+  }
+
+  OffsetUpdater u(offsets);
+  u.dispatch(m);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <gmpxx.h>
+#include <rumur/rumur.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Width in bits that a value of the given type occupies in the verifier. In
+ * the packed layout, this is the type's own width. In the aligned layout, each
+ * simple value is widened to 8, 16, 32 or 64 bits so it can be read and written
+ * as a whole integer, and complex values are made of these.
+ */
+mpz_class layout_width(const rumur::TypeExpr &t);
+mpz_class layout_width(const rumur::VarDecl &v);
+
+// width of the model's state in bits, under the chosen layout
+mpz_class state_size_bits(const rumur::Model &m);
+
+/* Split points for tree compression (--tree-compression on), as the bit offset
+ * of each leaf of the state followed by the end of the state. Leaves hold at
+ * most TREE_LEAF_BITS bits. They follow the boundaries of state variables,
+ * array elements and record fields, so that equal components of different
+ * states land in equal leaves.
+ */
+constexpr unsigned long TREE_LEAF_BITS = 31;
+std::vector<mpz_class> tree_leaf_offsets(const rumur::Model &m);
+
+/* Resolve --state-layout auto to a concrete layout for this model, and assign
+ * the offsets of the state variables under the chosen layout. The variables
+ * keep the order their current offsets give them.
+ */
+void layout_state(rumur::Model &m);
+
+/* Set the offsets of the model's state variables, both in their declarations
+ * and in the copies of these that references to them hold.
+ */
+void set_state_offsets(
+    rumur::Model &m, const std::unordered_map<std::string, mpz_class> &offsets);
@@ -3,6 +3,7 @@
 #include "environ.h"
 #include "generate.h"
 #include "has-start-state.h"
+#include "layout.h"
 #include "log.h"
 #include "optimise-field-ordering.h"
 #include "options.h"
@@ -50,64 +51,103 @@ static void parse_args(int argc, char **argv) {
 
   for (;;) {
     enum {
-      OPT_BOUND = 128,
+      OPT_BITSTATE = 128,
+      OPT_BOUND,
+      OPT_CHECKPOINT,
+      OPT_CHECKPOINT_INTERVAL,
       OPT_COLOUR,
       OPT_COUNTEREXAMPLE_TRACE,
       OPT_DEADLOCK_DETECTION,
+      OPT_EXTERNAL_MEMORY,
+      OPT_HASH,
+      OPT_HASH_COMPACTION,
+      OPT_HUGE_PAGES,
       OPT_MAX_ERRORS,
+      OPT_MAX_STATES,
+      OPT_MEMORY_LIMIT,
       OPT_MONOPOLISE,
+      OPT_NUMA,
       OPT_OUTPUT_FORMAT,
       OPT_PACK_STATE,
+      OPT_PARTIAL_ORDER_REDUCTION,
       OPT_POINTER_BITS,
       OPT_REORDER_FIELDS,
+      OPT_RESUME,
       OPT_SANDBOX,
       OPT_SCALARSET_SCHEDULES,
+      OPT_SEARCH,
+      OPT_SEED,
+      OPT_SIMULATE,
       OPT_SMT_ARG,
       OPT_SMT_BITVECTORS,
       OPT_SMT_BUDGET,
       OPT_SMT_PATH,
       OPT_SMT_PRELUDE,
       OPT_SMT_SIMPLIFICATION,
+      OPT_STATE_LAYOUT,
+      OPT_SUCCESSOR_BATCH,
       OPT_SYMMETRY_REDUCTION,
       OPT_TRACE,
+      OPT_TREE_COMPRESSION,
       OPT_VALUE_TYPE,
       OPT_VERSION,
+      OPT_WALK_LENGTH,
     };
 
     static struct option opts[] = {
+        {"bitstate", required_argument, 0, OPT_BITSTATE},
         {"bound", required_argument, 0, OPT_BOUND},
+        {"checkpoint", required_argument, 0, OPT_CHECKPOINT},
+        {"checkpoint-interval", required_argument, 0, OPT_CHECKPOINT_INTERVAL},
         {"color", required_argument, 0, OPT_COLOUR},
         {"colour", required_argument, 0, OPT_COLOUR},
         {"counterexample-trace", required_argument, 0,
          OPT_COUNTEREXAMPLE_TRACE},
         {"deadlock-detection", required_argument, 0, OPT_DEADLOCK_DETECTION},
         {"debug", no_argument, 0, 'd'},
+        {"external-memory", required_argument, 0, OPT_EXTERNAL_MEMORY},
+        {"hash", required_argument, 0, OPT_HASH},
+        {"hash-compaction", required_argument, 0, OPT_HASH_COMPACTION},
+        {"huge-pages", required_argument, 0, OPT_HUGE_PAGES},
         {"help", no_argument, 0, 'h'},
         {"max-errors", required_argument, 0, OPT_MAX_ERRORS},
+        {"max-states", required_argument, 0, OPT_MAX_STATES},
+        {"memory-limit", required_argument, 0, OPT_MEMORY_LIMIT},
         {"monopolise", no_argument, 0, OPT_MONOPOLISE},
         {"monopolize", no_argument, 0, OPT_MONOPOLISE},
+        {"numa", required_argument, 0, OPT_NUMA},
         {"output", required_argument, 0, 'o'},
         {"output-format", required_argument, 0, OPT_OUTPUT_FORMAT},
         {"pack-state", required_argument, 0, OPT_PACK_STATE},
+        {"partial-order-reduction", required_argument, 0,
+         OPT_PARTIAL_ORDER_REDUCTION},
         {"pointer-bits", required_argument, 0, OPT_POINTER_BITS},
         {"quiet", no_argument, 0, 'q'},
         {"reorder-fields", required_argument, 0, OPT_REORDER_FIELDS},
+        {"resume", required_argument, 0, OPT_RESUME},
         {"sandbox", required_argument, 0, OPT_SANDBOX},
         {"scalarset-schedules", required_argument, 0, OPT_SCALARSET_SCHEDULES},
+        {"search", required_argument, 0, OPT_SEARCH},
+        {"seed", required_argument, 0, OPT_SEED},
         {"set-capacity", required_argument, 0, 's'},
         {"set-expand-threshold", required_argument, 0, 'e'},
+        {"simulate", required_argument, 0, OPT_SIMULATE},
         {"smt-arg", required_argument, 0, OPT_SMT_ARG},
         {"smt-bitvectors", required_argument, 0, OPT_SMT_BITVECTORS},
         {"smt-budget", required_argument, 0, OPT_SMT_BUDGET},
         {"smt-path", required_argument, 0, OPT_SMT_PATH},
         {"smt-prelude", required_argument, 0, OPT_SMT_PRELUDE},
         {"smt-simplification", required_argument, 0, OPT_SMT_SIMPLIFICATION},
+        {"state-layout", required_argument, 0, OPT_STATE_LAYOUT},
+        {"successor-batch", required_argument, 0, OPT_SUCCESSOR_BATCH},
         {"symmetry-reduction", required_argument, 0, OPT_SYMMETRY_REDUCTION},
         {"threads", required_argument, 0, 't'},
         {"trace", required_argument, 0, OPT_TRACE},
+        {"tree-compression", required_argument, 0, OPT_TREE_COMPRESSION},
         {"value-type", required_argument, 0, OPT_VALUE_TYPE},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, OPT_VERSION},
+        {"walk-length", required_argument, 0, OPT_WALK_LENGTH},
         {0, 0, 0, 0},
     };
 
@@ -250,6 +290,88 @@ static void parse_args(int argc, char **argv) {
       }
       break;
 
+    case OPT_CHECKPOINT: // --checkpoint ...
+      options.checkpoint = optarg;
+      break;
+
+    case OPT_CHECKPOINT_INTERVAL: { // --checkpoint-interval ...
+      bool valid = true;
+      try {
+        options.checkpoint_interval = optarg;
+        if (options.checkpoint_interval <= 0)
+          valid = false;
+      } catch (std::invalid_argument &) {
+        valid = false;
+      }
+      if (!valid) {
+        std::cerr << "invalid --checkpoint-interval argument \"" << optarg
+                  << "\"\n";
+        exit(EXIT_FAILURE);
+      }
+      break;
+    }
+
+    case OPT_EXTERNAL_MEMORY: { // --external-memory ...
+      struct stat buf;
+      if (stat(optarg, &buf) < 0 || !S_ISDIR(buf.st_mode)) {
+        std::cerr << "invalid --external-memory argument \"" << optarg
+                  << "\": not a directory\n";
+        exit(EXIT_FAILURE);
+      }
+      options.external_memory = optarg;
+      break;
+    }
+
+    case OPT_HASH: // --hash ...
+      if (strcmp(optarg, "additive") == 0) {
+        options.hash_function = HashFunction::ADDITIVE;
+      } else if (strcmp(optarg, "crc32c") == 0) {
+        options.hash_function = HashFunction::CRC32C;
+      } else if (strcmp(optarg, "murmur") == 0) {
+        options.hash_function = HashFunction::MURMUR;
+      } else if (strcmp(optarg, "xxh") == 0) {
+        options.hash_function = HashFunction::XXH;
+      } else {
+        std::cerr << "invalid --hash argument \"" << optarg << "\"\n"
+                  << "valid arguments are \"additive\", \"crc32c\", "
+                     "\"murmur\", and \"xxh\"\n";
+        exit(EXIT_FAILURE);
+      }
+      break;
+
+    case OPT_HASH_COMPACTION: // --hash-compaction ...
+      if (strcmp(optarg, "off") == 0) {
+        options.hash_compaction = 0;
+      } else {
+        bool valid = true;
+        try {
+          options.hash_compaction = optarg;
+          if (options.hash_compaction <= 0 || options.hash_compaction > 64)
+            valid = false;
+        } catch (std::invalid_argument &) {
+          valid = false;
+        }
+        if (!valid) {
+          std::cerr << "invalid --hash-compaction argument \"" << optarg
+                    << "\"\n"
+                    << "valid arguments are \"off\" and 1 - 64\n";
+          exit(EXIT_FAILURE);
+        }
+      }
+      break;
+
+    case OPT_HUGE_PAGES: // --huge-pages ...
+      if (strcmp(optarg, "on") == 0) {
+        options.huge_pages = true;
+      } else if (strcmp(optarg, "off") == 0) {
+        options.huge_pages = false;
+      } else {
+        std::cerr << "invalid argument to --huge-pages, \"" << optarg
+                  << "\"\n";
+        exit(EXIT_FAILURE);
+      }
+      break;
+
     case OPT_MONOPOLISE: { // --monopolise
 
       long pagesize = sysconf(_SC_PAGESIZE);
@@ -276,6 +398,17 @@ static void parse_args(int argc, char **argv) {
       break;
     }
 
+    case OPT_NUMA: // --numa ...
+      if (strcmp(optarg, "on") == 0) {
+        options.numa = true;
+      } else if (strcmp(optarg, "off") == 0) {
+        options.numa = false;
+      } else {
+        std::cerr << "invalid argument to --numa, \"" << optarg << "\"\n";
+        exit(EXIT_FAILURE);
+      }
+      break;
+
     case OPT_PACK_STATE: // --pack-state ...
       if (strcmp(optarg, "on") == 0) {
         options.pack_state = true;
@@ -287,6 +420,18 @@ static void parse_args(int argc, char **argv) {
       }
       break;
 
+    case OPT_PARTIAL_ORDER_REDUCTION: // --partial-order-reduction ...
+      if (strcmp(optarg, "on") == 0) {
+        options.partial_order_reduction = true;
+      } else if (strcmp(optarg, "off") == 0) {
+        options.partial_order_reduction = false;
+      } else {
+        std::cerr << "invalid argument to --partial-order-reduction, \""
+                  << optarg << "\"\n";
+        exit(EXIT_FAILURE);
+      }
+      break;
+
     case OPT_POINTER_BITS: // --pointer-bits ...
       if (strcmp(optarg, "auto") == 0) {
         options.pointer_bits = 0;
@@ -313,6 +458,8 @@ static void parse_args(int argc, char **argv) {
         options.symmetry_reduction = SymmetryReduction::HEURISTIC;
       } else if (strcmp(optarg, "exhaustive") == 0) {
         options.symmetry_reduction = SymmetryReduction::EXHAUSTIVE;
+      } else if (strcmp(optarg, "refinement") == 0) {
+        options.symmetry_reduction = SymmetryReduction::REFINEMENT;
       } else {
         std::cerr << "invalid argument to --symmetry-reduction, \"" << optarg
                   << "\"\n";
@@ -343,6 +490,67 @@ static void parse_args(int argc, char **argv) {
       }
       break;
 
+    case OPT_SEARCH: // --search ...
+      if (strcmp(optarg, "bfs") == 0) {
+        options.search = Search::BFS;
+      } else if (strcmp(optarg, "dfs") == 0) {
+        options.search = Search::DFS;
+      } else {
+        std::cerr << "invalid argument to --search, \"" << optarg << "\"\n";
+        exit(EXIT_FAILURE);
+      }
+      break;
+
+    case OPT_SEED: { // --seed ...
+      bool valid = true;
+      try {
+        options.simulate.seed = optarg;
+        if (options.simulate.seed < 0 ||
+            options.simulate.seed >= mpz_class(1) << 64)
+          valid = false;
+      } catch (std::invalid_argument &) {
+        valid = false;
+      }
+      if (!valid) {
+        std::cerr << "invalid --seed argument \"" << optarg << "\"\n";
+        exit(EXIT_FAILURE);
+      }
+      break;
+    }
+
+    case OPT_SIMULATE: { // --simulate ...
+      bool valid = true;
+      try {
+        options.simulate.walks = optarg;
+        if (options.simulate.walks <= 0)
+          valid = false;
+      } catch (std::invalid_argument &) {
+        valid = false;
+      }
+      if (!valid) {
+        std::cerr << "invalid --simulate argument \"" << optarg << "\"\n";
+        exit(EXIT_FAILURE);
+      }
+      options.search = Search::SIMULATE;
+      break;
+    }
+
+    case OPT_WALK_LENGTH: { // --walk-length ...
+      bool valid = true;
+      try {
+        options.simulate.walk_length = optarg;
+        if (options.simulate.walk_length <= 0)
+          valid = false;
+      } catch (std::invalid_argument &) {
+        valid = false;
+      }
+      if (!valid) {
+        std::cerr << "invalid --walk-length argument \"" << optarg << "\"\n";
+        exit(EXIT_FAILURE);
+      }
+      break;
+    }
+
     case OPT_MAX_ERRORS: { // --max-errors ...
       bool valid = true;
       try {
@@ -359,6 +567,72 @@ static void parse_args(int argc, char **argv) {
       break;
     }
 
+    case OPT_MAX_STATES: { // --max-states ...
+      bool valid = true;
+      try {
+        options.max_states = optarg;
+        // references to states must fit in 64 bits
+        if (options.max_states <= 0 ||
+            options.max_states + 2 > mpz_class(1) << 64)
+          valid = false;
+      } catch (std::invalid_argument &) {
+        valid = false;
+      }
+      if (!valid) {
+        std::cerr << "invalid --max-states argument \"" << optarg << "\"\n";
+        exit(EXIT_FAILURE);
+      }
+      break;
+    }
+
+    case OPT_MEMORY_LIMIT: { // --memory-limit ...
+      bool valid = true;
+      try {
+        options.memory_limit = optarg;
+        if (options.memory_limit <= 0)
+          valid = false;
+      } catch (std::invalid_argument &) {
+        valid = false;
+      }
+      if (!valid) {
+        std::cerr << "invalid --memory-limit argument \"" << optarg << "\"\n";
+        exit(EXIT_FAILURE);
+      }
+      break;
+    }
+
+    case OPT_STATE_LAYOUT: // --state-layout ...
+      if (strcmp(optarg, "auto") == 0) {
+        options.state_layout = StateLayout::AUTO;
+      } else if (strcmp(optarg, "packed") == 0) {
+        options.state_layout = StateLayout::PACKED;
+      } else if (strcmp(optarg, "aligned") == 0) {
+        options.state_layout = StateLayout::ALIGNED;
+      } else {
+        std::cerr << "invalid --state-layout argument \"" << optarg << "\"\n"
+                  << "valid arguments are \"auto\", \"packed\", and "
+                     "\"aligned\"\n";
+        exit(EXIT_FAILURE);
+      }
+      break;
+
+    case OPT_SUCCESSOR_BATCH: { // --successor-batch ...
+      bool valid = true;
+      try {
+        options.successor_batch = optarg;
+        if (options.successor_batch <= 0)
+          valid = false;
+      } catch (std::invalid_argument &) {
+        valid = false;
+      }
+      if (!valid) {
+        std::cerr << "invalid --successor-batch argument \"" << optarg
+                  << "\"\n";
+        exit(EXIT_FAILURE);
+      }
+      break;
+    }
+
     case OPT_COUNTEREXAMPLE_TRACE: // --counterexample-trace ...
       if (strcmp(optarg, "full") == 0) {
         options.counterexample_trace = CounterexampleTrace::FULL;
@@ -391,6 +665,38 @@ static void parse_args(int argc, char **argv) {
       std::cout << "Rumur version " << get_version() << "\n";
       exit(EXIT_SUCCESS);
 
+    case OPT_BITSTATE: // --bitstate ...
+      if (strcmp(optarg, "off") == 0) {
+        options.bitstate = 0;
+      } else {
+        bool valid = true;
+        try {
+          options.bitstate = optarg;
+          if (options.bitstate <= 0 || options.bitstate > 64)
+            valid = false;
+        } catch (std::invalid_argument &) {
+          valid = false;
+        }
+        if (!valid) {
+          std::cerr << "invalid --bitstate argument \"" << optarg << "\"\n"
+                    << "valid arguments are \"off\" and 1 - 64\n";
+          exit(EXIT_FAILURE);
+        }
+      }
+      break;
+
+    case OPT_TREE_COMPRESSION: // --tree-compression ...
+      if (strcmp(optarg, "on") == 0) {
+        options.tree_compression = true;
+      } else if (strcmp(optarg, "off") == 0) {
+        options.tree_compression = false;
+      } else {
+        std::cerr << "invalid argument to --tree-compression, \"" << optarg
+                  << "\"\n";
+        exit(EXIT_FAILURE);
+      }
+      break;
+
     case OPT_BOUND: { // --bound ...
       bool valid = true;
       try {
@@ -423,6 +729,10 @@ static void parse_args(int argc, char **argv) {
       }
       break;
 
+    case OPT_RESUME: // --resume ...
+      options.resume = optarg;
+      break;
+
     case OPT_SMT_ARG: // --smt-arg ...
       options.smt.args.emplace_back(optarg);
       if (options.smt.simplification == SmtSimplification::AUTO) {
@@ -534,6 +844,186 @@ static void parse_args(int argc, char **argv) {
     }
   }
 
+  if (options.hash_compaction > 0 && options.bitstate > 0) {
+    std::cerr << "--bitstate and --hash-compaction cannot be used together\n";
+    exit(EXIT_FAILURE);
+  }
+
+  if (options.partial_order_reduction) {
+    if (options.bound > 0) {
+      std::cerr << "--partial-order-reduction cannot be used with --bound\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.external_memory != "") {
+      std::cerr << "--partial-order-reduction cannot be used with "
+                << "--external-memory\n";
+      exit(EXIT_FAILURE);
+    }
+    // an evicted state looks new when reached again, so it would not close a
+    // cycle in the reduction's "any successor already seen" check
+    if (options.memory_limit > 0) {
+      std::cerr << "--partial-order-reduction cannot be used with "
+                << "--memory-limit\n";
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (options.search != Search::BFS) {
+    const char *search =
+        options.search == Search::DFS ? "--search dfs" : "--simulate";
+    if (options.partial_order_reduction) {
+      std::cerr << "--partial-order-reduction cannot be used with " << search
+                << "\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.external_memory != "") {
+      std::cerr << "--external-memory cannot be used with " << search << "\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.checkpoint != "" || options.resume != "") {
+      std::cerr << "--checkpoint and --resume cannot be used with " << search
+                << "\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.memory_limit > 0) {
+      std::cerr << "--memory-limit cannot be used with " << search << "\n";
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // a state first reached by a path longer than its shortest one would not be
+  // expanded again when later reached by the shorter path, so states within
+  // the bound could be missed
+  if (options.search == Search::DFS && options.bound > 0) {
+    std::cerr << "--bound cannot be used with --search dfs\n";
+    exit(EXIT_FAILURE);
+  }
+
+  if (options.search == Search::SIMULATE && options.bound > 0) {
+    std::cerr << "--bound cannot be used with --simulate, whose walks are "
+              << "bounded by --walk-length instead\n";
+    exit(EXIT_FAILURE);
+  }
+
+  if (options.external_memory != "") {
+    if (options.hash_compaction > 0 || options.bitstate > 0) {
+      std::cerr << "--external-memory cannot be used with --bitstate or "
+                << "--hash-compaction\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.bound > 0) {
+      std::cerr << "--external-memory cannot be used with --bound\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.sandbox_enabled) {
+      std::cerr << "--external-memory cannot be used with --sandbox on\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.counterexample_trace != CounterexampleTrace::OFF) {
+      *info << "counterexample traces are not available when states are "
+            << "stored on disk (--external-memory ...), so they will be "
+            << "disabled\n";
+      options.counterexample_trace = CounterexampleTrace::OFF;
+    }
+    if (options.threads != 1) {
+      *info << "exploration with states stored on disk (--external-memory "
+            << "...) is single threaded, so --threads 1 will be used\n";
+      options.threads = 1;
+    }
+  }
+
+  if (options.tree_compression) {
+    if (options.hash_compaction > 0 || options.bitstate > 0) {
+      std::cerr << "--tree-compression cannot be used with --bitstate or "
+                << "--hash-compaction\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.external_memory != "") {
+      std::cerr << "--tree-compression cannot be used with --external-memory\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.memory_limit > 0) {
+      std::cerr << "--tree-compression cannot be used with --memory-limit\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.counterexample_trace != CounterexampleTrace::OFF) {
+      *info << "counterexample traces are not available when states are "
+            << "stored as trees (--tree-compression on), so they will be "
+            << "disabled\n";
+      options.counterexample_trace = CounterexampleTrace::OFF;
+    }
+    // tree nodes are numbered by their position in the table, in 31 bits
+    const mpz_class max_capacity = mpz_class(8) << TREE_LEAF_BITS;
+    if (options.set_capacity > max_capacity) {
+      *info << "the tree compression table cannot exceed " << max_capacity
+            << " bytes, so --set-capacity " << max_capacity
+            << " will be used\n";
+      options.set_capacity = max_capacity;
+    }
+  }
+
+  if (options.checkpoint != "" || options.resume != "") {
+    if (options.external_memory != "") {
+      std::cerr << "--checkpoint and --resume cannot be used with "
+                << "--external-memory\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.sandbox_enabled) {
+      std::cerr << "--checkpoint and --resume cannot be used with --sandbox "
+                << "on\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.counterexample_trace != CounterexampleTrace::OFF) {
+      *info << "counterexample traces are not available when checkpointing "
+            << "(--checkpoint ... or --resume ...), so they will be "
+            << "disabled\n";
+      options.counterexample_trace = CounterexampleTrace::OFF;
+    }
+  }
+
+  if (options.memory_limit > 0) {
+    if (options.bitstate > 0) {
+      std::cerr << "--memory-limit cannot be used with --bitstate, whose bit "
+                << "array never grows\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.external_memory != "") {
+      std::cerr << "--memory-limit cannot be used with --external-memory\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.checkpoint != "" || options.resume != "") {
+      std::cerr << "--checkpoint and --resume cannot be used with "
+                << "--memory-limit\n";
+      exit(EXIT_FAILURE);
+    }
+    if (options.hash_compaction == 0) {
+      *info << "states can only be evicted from the seen set when it stores "
+            << "fingerprints of them (--hash-compaction ...), so "
+            << "--hash-compaction 56 will be used\n";
+      options.hash_compaction = 56;
+    } else if (options.hash_compaction > 56) {
+      *info << "the top 8 bits of each fingerprint are used to choose which "
+            << "states to evict from the seen set, so --hash-compaction 56 "
+            << "will be used\n";
+      options.hash_compaction = 56;
+    }
+    // leave room within the limit for pending states and expansion
+    if (options.set_capacity > options.memory_limit / 4) {
+      *info << "the initial seen set would take more than a quarter of the "
+            << "memory limit, so --set-capacity " << options.memory_limit / 4
+            << " will be used\n";
+      options.set_capacity = options.memory_limit / 4;
+    }
+  }
+
+  if ((options.hash_compaction > 0 || options.bitstate > 0) &&
+      options.counterexample_trace != CounterexampleTrace::OFF) {
+    *info << "counterexample traces are not available when the seen set does "
+          << "not store states (--bitstate ... or --hash-compaction ...), so "
+          << "they will be disabled\n";
+    options.counterexample_trace = CounterexampleTrace::OFF;
+  }
+
   if (options.smt.simplification == SmtSimplification::ON &&
       options.smt.path == "") {
     *warn << "SMT simplification was enabled but no path was provided to the "
@@ -667,6 +1157,47 @@ int main(int argc, char **argv) {
   if (!has_start_state(*m))
     *warn << "warning: model has no start state\n";
 
+  if ((options.checkpoint != "" || options.resume != "") &&
+      m->liveness_count() > 0) {
+    std::cerr << "liveness properties cannot be checked when checkpointing "
+              << "(--checkpoint ... or --resume ...)\n";
+    return EXIT_FAILURE;
+  }
+
+  if (options.external_memory != "" && m->liveness_count() > 0) {
+    std::cerr << "liveness properties cannot be checked when states are stored "
+              << "on disk (--external-memory ...)\n";
+    return EXIT_FAILURE;
+  }
+
+  if (options.partial_order_reduction && m->liveness_count() > 0) {
+    std::cerr << "liveness properties cannot be checked with partial-order "
+              << "reduction (--partial-order-reduction on)\n";
+    return EXIT_FAILURE;
+  }
+
+  if (options.search == Search::SIMULATE && m->liveness_count() > 0) {
+    std::cerr << "liveness properties cannot be checked by random simulation "
+              << "(--simulate ...)\n";
+    return EXIT_FAILURE;
+  }
+
+  /* Liveness checking revisits every seen state at the end of exploration, so
+   * needs the full states that bitstate mode and hash compaction discard.
+   */
+  if ((options.hash_compaction > 0 || options.bitstate > 0) &&
+      m->liveness_count() > 0) {
+    std::cerr << "liveness properties cannot be checked when the seen set does "
+              << "not store states (--bitstate ... or --hash-compaction ...)\n";
+    return EXIT_FAILURE;
+  }
+
+  if (options.tree_compression && m->liveness_count() > 0) {
+    std::cerr << "liveness properties cannot be checked when states are "
+              << "stored as trees (--tree-compression on)\n";
+    return EXIT_FAILURE;
+  }
+
   // run SMT simplification if the user enabled it
   if (options.smt.simplification == SmtSimplification::ON) {
     *debug << "SMT simplification...\n";
@@ -687,6 +1218,9 @@ int main(int argc, char **argv) {
     optimise_field_ordering(*m);
   }
 
+  // assign state variable offsets under the chosen layout
+  layout_state(*m);
+
   // get value_t to use in the checker
   *debug << "determining value_t type...\n";
   std::pair<ValueType, ValueType> value_types;
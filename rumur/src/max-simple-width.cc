@@ -1,4 +1,5 @@
 #include "max-simple-width.h"
+#include "layout.h"
 #include <cstddef>
 #include <gmpxx.h>
 #include <memory>
@@ -22,7 +23,7 @@ public:
   }
 
   void visit_enum(const Enum &n) final {
-    mpz_class w = n.width();
+    mpz_class w = layout_width(n);
     if (w > max)
       max = w;
   }
@@ -42,7 +43,7 @@ public:
   }
 
   void visit_range(const Range &n) final {
-    mpz_class w = n.width();
+    mpz_class w = layout_width(n);
     if (w > max)
       max = w;
   }
@@ -53,14 +54,14 @@ public:
   }
 
   void visit_scalarset(const Scalarset &n) final {
-    mpz_class w = n.width();
+    mpz_class w = layout_width(n);
     if (w > max)
       max = w;
   }
 
   void visit_typeexprid(const TypeExprID &n) final {
     if (n.is_simple()) {
-      mpz_class w = n.width();
+      mpz_class w = layout_width(n);
       if (w > max)
         max = w;
     }
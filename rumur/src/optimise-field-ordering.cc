@@ -1,4 +1,5 @@
 #include "optimise-field-ordering.h"
+#include "layout.h"
 #include "log.h"
 #include <cstddef>
 #include <gmpxx.h>
@@ -87,8 +88,8 @@ static void notify_changes(const std::vector<std::string> &original,
   }
 }
 
-// a traversal that reorders fields
 namespace {
+// a traversal that reorders fields
 class Reorderer : public Traversal {
 
 public:
@@ -129,11 +130,9 @@ public:
       offset += v->type->width();
     }
 
-    // apply these updated offsets to the original VarDecls
-    for (Ptr<Node> &c : n.children) {
-      if (auto v = dynamic_cast<VarDecl *>(c.get()))
-        v->offset = offsets[v->name];
-    }
+    // apply these updated offsets to the original VarDecls and the copies of
+    // them that references hold
+    set_state_offsets(n, offsets);
   }
 
   void visit_record(Record &n) final {
@@ -44,6 +44,26 @@ enum struct SymmetryReduction {
   OFF,
   HEURISTIC,
   EXHAUSTIVE,
+  REFINEMENT,
+};
+
+enum struct HashFunction {
+  ADDITIVE,
+  CRC32C,
+  MURMUR,
+  XXH,
+};
+
+enum struct Search {
+  BFS,
+  DFS,
+  SIMULATE,
+};
+
+enum struct StateLayout {
+  AUTO,
+  PACKED,
+  ALIGNED,
 };
 
 enum struct SmtSimplification {
@@ -62,6 +82,14 @@ struct Options {
    */
   unsigned set_expand_threshold = 75;
 
+  // size (bytes) beyond which the seen set is not expanded, but instead evicts
+  // states (0 == unlimited)
+  mpz_class memory_limit = 0;
+
+  // number of states the verifier can hold in memory at once, so they can be
+  // referred to by index instead of by pointer (0 == unlimited)
+  mpz_class max_states = 0;
+
   // Whether to use ANSI colour codes in the checker's output.
   Color color = Color::AUTO;
 
@@ -104,6 +132,63 @@ struct Options {
   // number of relevant bits in a pointer on the target platform (0 == auto)
   mpz_class pointer_bits = 0;
 
+  // width of the state fingerprints stored in the seen set (0 == store states)
+  mpz_class hash_compaction = 0;
+
+  // number of hash functions probing the bit array in bitstate mode (0 == off)
+  mpz_class bitstate = 0;
+
+  // whether to store states in the seen set as trees of shared sub-vectors
+  bool tree_compression = false;
+
+  // directory for the on-disk frontier and seen set ("" == explore in memory)
+  std::string external_memory;
+
+  // file to periodically write checkpoints to ("" == no checkpointing)
+  std::string checkpoint;
+
+  // seconds between checkpoints
+  mpz_class checkpoint_interval = 3600;
+
+  // checkpoint to resume exploration from ("" == start from the initial states)
+  std::string resume;
+
+  // whether to back the seen set and state allocations with huge pages
+  bool huge_pages = false;
+
+  // whether to pin threads to CPUs and place memory across NUMA nodes
+  bool numa = false;
+
+  // kernel used to hash states
+  HashFunction hash_function = HashFunction::MURMUR;
+
+  // number of successor states to hash and prefetch before inserting them into
+  // the seen set
+  mpz_class successor_batch = 16;
+
+  // whether to fire only an independent subset of the enabled rules where
+  // possible
+  bool partial_order_reduction = false;
+
+  // how to lay out variables within the state
+  StateLayout state_layout = StateLayout::AUTO;
+
+  // order in which to explore the state space
+  Search search = Search::BFS;
+
+  // parameters of random simulation (--simulate ...)
+  struct {
+
+    // number of random walks to take
+    mpz_class walks = 0;
+
+    // maximum number of rules to fire in each walk
+    mpz_class walk_length = 1000;
+
+    // seed for the pseudo-random choices the walks make
+    mpz_class seed = 0;
+  } simulate;
+
   // options related to SMT solver interaction
   struct {
 
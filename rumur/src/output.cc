@@ -1,19 +1,26 @@
+#include "../../common/escape.h"
 #include "../../common/isa.h"
 #include "ValueType.h"
 #include "assume-statements-count.h"
 #include "generate.h"
+#include "layout.h"
 #include "max-simple-width.h"
 #include "options.h"
+#include "partial-order-reduction.h"
 #include "prints-scalarsets.h"
 #include "resources.h"
 #include "symmetry-reduction.h"
+#include "utils.h"
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <rumur/rumur.h>
+#include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 using namespace rumur;
 
@@ -69,6 +76,10 @@ static std::ostream &operator<<(std::ostream &out, SymmetryReduction s) {
   case SymmetryReduction::EXHAUSTIVE:
     out << "SYMMETRY_REDUCTION_EXHAUSTIVE";
     break;
+
+  case SymmetryReduction::REFINEMENT:
+    out << "SYMMETRY_REDUCTION_REFINEMENT";
+    break;
   }
 
   return out;
@@ -93,6 +104,48 @@ static std::ostream &operator<<(std::ostream &out, CounterexampleTrace c) {
   return out;
 }
 
+static std::ostream &operator<<(std::ostream &out, Search s) {
+  switch (s) {
+
+  case Search::BFS:
+    out << "SEARCH_BFS";
+    break;
+
+  case Search::DFS:
+    out << "SEARCH_DFS";
+    break;
+
+  case Search::SIMULATE:
+    out << "SEARCH_SIMULATE";
+    break;
+  }
+
+  return out;
+}
+
+static std::ostream &operator<<(std::ostream &out, HashFunction h) {
+  switch (h) {
+
+  case HashFunction::ADDITIVE:
+    out << "HASH_ADDITIVE";
+    break;
+
+  case HashFunction::CRC32C:
+    out << "HASH_CRC32C";
+    break;
+
+  case HashFunction::MURMUR:
+    out << "HASH_MURMUR";
+    break;
+
+  case HashFunction::XXH:
+    out << "HASH_XXH";
+    break;
+  }
+
+  return out;
+}
+
 // maximum value state.rule_taken can reach in the generated checker, given the
 // guarding predicate
 static mpz_class rule_taken_max(const Model &model,
@@ -168,6 +221,104 @@ static mpz_class schedule_bits(const Model &model) {
   return bits;
 }
 
+// whether the seen set should store state data inline rather than pointers to
+// states
+static bool use_inline_set(const Model &model) {
+
+  // states need to outlive their insertion into the set for counterexample
+  // traces and liveness checking
+  if (options.counterexample_trace != CounterexampleTrace::OFF)
+    return false;
+  if (model.liveness_count() > 0)
+    return false;
+
+  // these modes replace the set with their own structures
+  if (options.hash_compaction > 0 || options.bitstate > 0 ||
+      options.tree_compression || options.external_memory != "")
+    return false;
+
+  // only bother for states small enough that at least two, each with a status
+  // byte, fit in a 64-byte cache line
+  const mpz_class size_bytes = (state_size_bits(model) + 7) / 8;
+  return size_bytes > 0 && size_bytes * 2 + 2 <= 64;
+}
+
+// whether the seen set stores pointers to states
+static bool use_pointer_set(const Model &model) {
+  return !use_inline_set(model) && options.hash_compaction == 0 &&
+         options.bitstate == 0 && !options.tree_compression &&
+         options.external_memory == "";
+}
+
+// whether the state is large enough for incremental hashing to pay off
+static bool large_state(const Model &model) {
+  // for small states, hashing from scratch is as cheap as comparing against
+  // the parent
+  const mpz_class size_bytes = (state_size_bits(model) + 7) / 8;
+  return size_bytes >= 64;
+}
+
+// whether states should carry their hash, so that of a successor can be
+// derived incrementally
+static bool use_incremental_hash(const Model &model) {
+  // only the seen set that stores pointers to states can make use of it
+  return options.hash_function == HashFunction::ADDITIVE &&
+         use_pointer_set(model) && large_state(model);
+}
+
+// the split points of the state for tree compression
+static void generate_tree_leaves(std::ostream &out, const Model &model) {
+
+  const std::vector<mpz_class> offsets = tree_leaf_offsets(model);
+
+  out << "/* Bit offset of each leaf of the state for tree compression, "
+         "followed by\n"
+      << " * the end of the state.\n"
+      << " */\n"
+      << "enum { TREE_LEAF_BITS = " << TREE_LEAF_BITS << " };\n"
+      << "static const size_t TREE_LEAF_OFFSET[] = {";
+  for (size_t i = 0; i < offsets.size(); i++) {
+    if (i % 8 == 0)
+      out << "\n ";
+    out << " " << offsets[i] << "ul,";
+  }
+  out << "\n};\n\n";
+}
+
+// width of the indices states are referred to by, or 0 to use pointers
+static mpz_class state_id_bits() {
+  if (options.max_states == 0)
+    return 0;
+  // reserve 0 for a null reference and keep clear of the all-ones value, which
+  // the seen set uses to mark migrated slots
+  return bit_width(options.max_states + 2);
+}
+
+// a hash of the code generated for the model, to identify checkpoints
+static uint64_t model_fingerprint(const Model &model) {
+
+  // checkpoints are only useful if they can be resumed from, and do not need an
+  // identifier otherwise
+  if (options.checkpoint == "" && options.resume == "")
+    return 0;
+
+  // leave out the path the model was read from, which only appears in
+  // messages, so the model can be moved between checkpointing and resuming
+  const std::string filename = input_filename;
+  input_filename = "";
+  std::ostringstream model_c;
+  generate_model(model_c, model);
+  input_filename = filename;
+
+  // 64-bit FNV-1a
+  uint64_t h = UINT64_C(0xcbf29ce484222325);
+  for (unsigned char c : model_c.str()) {
+    h ^= c;
+    h *= UINT64_C(0x100000001b3);
+  }
+  return h;
+}
+
 int output_checker(const std::string &path, const Model &model,
                    const std::pair<ValueType, ValueType> &value_types) {
 
@@ -178,6 +329,10 @@ int output_checker(const std::string &path, const Model &model,
   if (options.log_level < LogLevel::DEBUG)
     out << "#define NDEBUG 1\n\n";
 
+  PorPartition por;
+  if (options.partial_order_reduction)
+    por = partition_rules(model);
+
   out
 
       // #includes
@@ -189,6 +344,9 @@ int output_checker(const std::string &path, const Model &model,
       << "enum { SET_CAPACITY = " << options.set_capacity << "ul };\n\n"
       << "enum { SET_EXPAND_THRESHOLD = " << options.set_expand_threshold
       << " };\n\n"
+      << "#define MEMORY_LIMIT " << options.memory_limit << "ull\n\n"
+      << "enum { MAX_STATES = " << options.max_states << "ull };\n"
+      << "#define STATE_ID_BITS " << state_id_bits() << "\n\n"
       << "static const enum { OFF, ON, AUTO } COLOR = " << options.color
       << ";\n\n"
       << "enum trace_category_t {\n"
@@ -210,12 +368,13 @@ int output_checker(const std::string &path, const Model &model,
       << "  SYMMETRY_REDUCTION_OFF = 0,\n"
       << "  SYMMETRY_REDUCTION_HEURISTIC = 1,\n"
       << "  SYMMETRY_REDUCTION_EXHAUSTIVE = 2,\n"
+      << "  SYMMETRY_REDUCTION_REFINEMENT = 3,\n"
       << "};\n"
       << "#define SYMMETRY_REDUCTION " << options.symmetry_reduction << "\n\n"
       << "enum { SANDBOX_ENABLED = " << options.sandbox_enabled << " };\n\n"
       << "enum { MAX_ERRORS = " << options.max_errors << "ul };\n\n"
       << "enum { THREADS = " << options.threads << "ul };\n\n"
-      << "enum { STATE_SIZE_BITS = " << model.size_bits() << "ul };\n\n"
+      << "enum { STATE_SIZE_BITS = " << state_size_bits(model) << "ul };\n\n"
       << "enum { ASSUME_STATEMENTS_COUNT = " << assume_statements_count(model)
       << "ul };\n\n"
       << "#define LIVENESS_COUNT " << model.liveness_count() << "\n\n"
@@ -249,10 +408,56 @@ int output_checker(const std::string &path, const Model &model,
       << (options.scalarset_schedules ? "1" : "0")
       << " && SYMMETRY_REDUCTION != SYMMETRY_REDUCTION_OFF && \\\n"
       << "  (COUNTEREXAMPLE_TRACE != CEX_OFF || PRINTS_SCALARSETS))\n"
-      << "#define POINTER_BITS " << options.pointer_bits << "\n";
+      << "#define POINTER_BITS " << options.pointer_bits << "\n"
+      << "#define HASH_COMPACTION_BITS " << options.hash_compaction << "\n"
+      << "#define BITSTATE_HASHES " << options.bitstate << "\n"
+      << "#define TREE_COMPRESSION " << (options.tree_compression ? 1 : 0)
+      << "\n"
+      << "#define INLINE_SET " << (use_inline_set(model) ? 1 : 0) << "\n"
+      << "#define HASH_ADDITIVE 0\n"
+      << "#define HASH_CRC32C 1\n"
+      << "#define HASH_MURMUR 2\n"
+      << "#define HASH_XXH 3\n"
+      << "#define HASH_FUNCTION " << options.hash_function << "\n"
+      << "#define INCREMENTAL_HASH " << (use_incremental_hash(model) ? 1 : 0)
+      << "\n"
+      << "#define EXTERNAL_MEMORY " << (options.external_memory != "" ? 1 : 0)
+      << "\n"
+      << "static const char EXTERNAL_MEMORY_DIR[] __attribute__((unused)) = \""
+      << escape(options.external_memory) << "\";\n"
+      << "#define CHECKPOINT " << (options.checkpoint != "" ? 1 : 0) << "\n"
+      << "static const char CHECKPOINT_PATH[] __attribute__((unused)) = \""
+      << escape(options.checkpoint) << "\";\n"
+      << "enum { CHECKPOINT_INTERVAL = " << options.checkpoint_interval
+      << "ull };\n"
+      << "#define RESUME " << (options.resume != "" ? 1 : 0) << "\n"
+      << "static const char RESUME_PATH[] __attribute__((unused)) = \""
+      << escape(options.resume) << "\";\n"
+      << "static const uint64_t MODEL_FINGERPRINT __attribute__((unused)) = "
+      << "UINT64_C(" << model_fingerprint(model) << ");\n"
+      << "#define HUGE_PAGES " << (options.huge_pages ? 1 : 0) << "\n"
+      << "#define NUMA " << (options.numa ? 1 : 0) << "\n"
+      << "enum { SUCCESSOR_BATCH = " << options.successor_batch << "ul };\n"
+      << "#define PARTIAL_ORDER_REDUCTION " << (por.component.empty() ? 0 : 1)
+      << "\n"
+      << "#define SEARCH_BFS 0\n"
+      << "#define SEARCH_DFS 1\n"
+      << "#define SEARCH_SIMULATE 2\n"
+      << "#define SEARCH " << options.search << "\n"
+      << "enum { SIMULATE_WALKS = " << options.simulate.walks << "ull };\n"
+      << "enum { WALK_LENGTH = " << options.simulate.walk_length << "ull };\n"
+      << "#define SIMULATE_SEED UINT64_C(" << options.simulate.seed << ")\n"
+      << "enum { RULE_INSTANCES = " << rule_taken_max_rule(model)
+      << "ul };\n\n";
 
   generate_cover_array(out, model);
 
+  if (!por.component.empty())
+    generate_por_table(out, por);
+
+  if (options.tree_compression)
+    generate_tree_leaves(out, model);
+
   // Static boiler plate code
   out << std::string((const char *)resources_header_c, resources_header_c_len)
       << "\n";
@@ -0,0 +1,496 @@
+#include "partial-order-reduction.h"
+#include "../../common/isa.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <gmpxx.h>
+#include <iostream>
+#include <numeric>
+#include <rumur/rumur.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace rumur;
+
+// above this many rule instances, rules are analysed once for all of their
+// instances rather than once per instance
+static const size_t MAX_INSTANCES = 4096;
+
+// above this many rule instances, no reduction is attempted
+static const size_t MAX_TABLE = 65536;
+
+namespace {
+
+// a step from a variable into one of its fields or elements
+struct Selector {
+  enum { FIELD, INDEX, ANY_INDEX } kind;
+  std::string field;
+  mpz_class index;
+};
+
+// a read or write of (part of) a state variable
+struct Access {
+  size_t var;                  // unique_id of the variable
+  std::vector<Selector> path;  // part of the variable accessed
+  bool write;
+};
+
+} // namespace
+
+// could two accesses touch the same state?
+static bool overlap(const Access &a, const Access &b) {
+  if (a.var != b.var)
+    return false;
+  for (size_t i = 0; i < a.path.size() && i < b.path.size(); i++) {
+    const Selector &x = a.path[i];
+    const Selector &y = b.path[i];
+    if (x.kind == Selector::FIELD && y.kind == Selector::FIELD &&
+        x.field != y.field)
+      return false;
+    if (x.kind == Selector::INDEX && y.kind == Selector::INDEX &&
+        x.index != y.index)
+      return false;
+  }
+  return true;
+}
+
+namespace {
+
+// a traversal that collects the state accesses of a rule, property or function
+class AccessCollector : public ConstTraversal {
+
+private:
+  std::vector<Access> *accesses;
+
+  // values of the bound quantifiers, by unique_id of their declarations
+  std::unordered_map<size_t, mpz_class> bindings;
+
+  // are we within a called function, where we only track whole variables?
+  bool in_callee = false;
+
+  // functions we are currently within, to avoid recursing forever
+  std::unordered_set<size_t> active;
+
+public:
+  AccessCollector(std::vector<Access> &accesses_,
+                  const std::unordered_map<size_t, mpz_class> &bindings_)
+      : accesses(&accesses_), bindings(bindings_) {}
+
+  void visit_assignment(const Assignment &n) final {
+    write(*n.lhs);
+    dispatch(*n.rhs);
+  }
+
+  void visit_clear(const Clear &n) final { write(*n.rhs); }
+
+  void visit_element(const Element &n) final { read(n); }
+
+  void visit_exprid(const ExprID &n) final { read(n); }
+
+  void visit_field(const Field &n) final { read(n); }
+
+  void visit_functioncall(const FunctionCall &n) final {
+
+    assert(n.function != nullptr && "unresolved function call");
+
+    // arguments to var parameters may be written by the callee
+    for (size_t i = 0; i < n.arguments.size(); i++) {
+      if (i < n.function->parameters.size() &&
+          !n.function->parameters[i]->readonly)
+        write(*n.arguments[i]);
+      dispatch(*n.arguments[i]);
+    }
+
+    // any state the callee touches directly is treated as read and written
+    if (active.count(n.function->unique_id) > 0)
+      return;
+    active.insert(n.function->unique_id);
+    bool saved = in_callee;
+    in_callee = true;
+    for (const Ptr<Decl> &d : n.function->decls)
+      dispatch(*d);
+    for (const Ptr<Stmt> &s : n.function->body)
+      dispatch(*s);
+    in_callee = saved;
+    active.erase(n.function->unique_id);
+  }
+
+  void visit_undefine(const Undefine &n) final { write(*n.rhs); }
+
+private:
+  void record(Access a) {
+    if (in_callee) {
+      a.path.clear();
+      a.write = true;
+    }
+    accesses->push_back(a);
+  }
+
+  // determine the part of a state variable an expression refers to, if any
+  bool locate(const Expr &e, Access &a) const {
+
+    if (auto i = dynamic_cast<const ExprID *>(&e)) {
+      if (auto v = dynamic_cast<const VarDecl *>(i->value.get())) {
+        if (!v->is_in_state())
+          return false;
+        a.var = v->unique_id;
+        a.path.clear();
+        return true;
+      }
+      if (auto alias = dynamic_cast<const AliasDecl *>(i->value.get()))
+        return locate(*alias->value, a);
+      return false;
+    }
+
+    if (auto f = dynamic_cast<const Field *>(&e)) {
+      if (!locate(*f->record, a))
+        return false;
+      a.path.push_back(Selector{Selector::FIELD, f->field, 0});
+      return true;
+    }
+
+    if (auto l = dynamic_cast<const Element *>(&e)) {
+      if (!locate(*l->array, a))
+        return false;
+      mpz_class index;
+      if (evaluate(*l->index, index)) {
+        a.path.push_back(Selector{Selector::INDEX, "", index});
+      } else {
+        a.path.push_back(Selector{Selector::ANY_INDEX, "", 0});
+      }
+      return true;
+    }
+
+    return false;
+  }
+
+  // try to compute the value of an expression given the bound quantifiers
+  bool evaluate(const Expr &e, mpz_class &v) const {
+
+    if (auto i = dynamic_cast<const ExprID *>(&e)) {
+      auto it = bindings.find(i->value->unique_id);
+      if (it != bindings.end()) {
+        v = it->second;
+        return true;
+      }
+      if (auto alias = dynamic_cast<const AliasDecl *>(i->value.get()))
+        return evaluate(*alias->value, v);
+    }
+
+    if (auto b = dynamic_cast<const ArithmeticBinaryExpr *>(&e)) {
+      mpz_class l, r;
+      if (!evaluate(*b->lhs, l) || !evaluate(*b->rhs, r))
+        return false;
+      if (isa<Add>(b)) {
+        v = l + r;
+        return true;
+      }
+      if (isa<Sub>(b)) {
+        v = l - r;
+        return true;
+      }
+      if (isa<Mul>(b)) {
+        v = l * r;
+        return true;
+      }
+      return false;
+    }
+
+    if (auto n = dynamic_cast<const Negative *>(&e)) {
+      if (!evaluate(*n->rhs, v))
+        return false;
+      v = -v;
+      return true;
+    }
+
+    if (e.constant()) {
+      try {
+        v = e.constant_fold();
+        return true;
+      } catch (Error &) {
+        return false;
+      }
+    }
+
+    return false;
+  }
+
+  // visit the index expressions within a reference to state
+  void dispatch_indices(const Expr &e) {
+    if (auto i = dynamic_cast<const ExprID *>(&e)) {
+      if (auto alias = dynamic_cast<const AliasDecl *>(i->value.get()))
+        dispatch_indices(*alias->value);
+    } else if (auto f = dynamic_cast<const Field *>(&e)) {
+      dispatch_indices(*f->record);
+    } else if (auto l = dynamic_cast<const Element *>(&e)) {
+      dispatch_indices(*l->array);
+      dispatch(*l->index);
+    }
+  }
+
+  void read(const Expr &e) {
+    Access a;
+    if (locate(e, a)) {
+      a.write = false;
+      record(a);
+      dispatch_indices(e);
+      return;
+    }
+
+    // not state, but may contain references to state
+    if (auto i = dynamic_cast<const ExprID *>(&e)) {
+      if (auto alias = dynamic_cast<const AliasDecl *>(i->value.get()))
+        dispatch(*alias->value);
+    } else if (auto f = dynamic_cast<const Field *>(&e)) {
+      dispatch(*f->record);
+    } else if (auto l = dynamic_cast<const Element *>(&e)) {
+      dispatch(*l->array);
+      dispatch(*l->index);
+    }
+  }
+
+  void write(const Expr &e) {
+    Access a;
+    if (locate(e, a)) {
+      a.write = true;
+      record(a);
+    }
+    dispatch_indices(e);
+  }
+};
+
+} // namespace
+
+// the values a quantifier takes, in the order the verifier iterates them
+static std::vector<mpz_class> quantifier_values(const Quantifier &q) {
+
+  std::vector<mpz_class> values;
+
+  if (q.type != nullptr) {
+    mpz_class lb = 0;
+    const Ptr<TypeExpr> t = q.type->resolve();
+    if (auto r = dynamic_cast<const Range *>(t.get()))
+      lb = r->min->constant_fold();
+    for (mpz_class i = 0; i < q.count(); i++)
+      values.push_back(lb + i);
+    return values;
+  }
+
+  mpz_class lb = q.from->constant_fold();
+  mpz_class ub = q.to->constant_fold();
+  mpz_class step = ub >= lb ? 1 : -1;
+  if (q.step != nullptr)
+    step = q.step->constant_fold();
+  for (mpz_class i = lb; step > 0 ? i <= ub : i >= ub; i += step)
+    values.push_back(i);
+  return values;
+}
+
+static size_t instance_count(const Rule &r) {
+  size_t count = 1;
+  for (const Quantifier &q : r.quantifiers)
+    count *= quantifier_values(q).size();
+  return count;
+}
+
+// call `f` with the bindings of each instance of a rule, in the order the
+// verifier iterates them
+static void for_each_instance(
+    const Rule &r,
+    const std::function<void(const std::unordered_map<size_t, mpz_class> &)>
+        &f) {
+
+  std::vector<std::vector<mpz_class>> values;
+  for (const Quantifier &q : r.quantifiers)
+    values.push_back(quantifier_values(q));
+
+  std::unordered_map<size_t, mpz_class> bindings;
+  std::function<void(size_t)> bind = [&](size_t depth) {
+    if (depth == r.quantifiers.size()) {
+      f(bindings);
+      return;
+    }
+    for (const mpz_class &v : values[depth]) {
+      bindings[r.quantifiers[depth].decl->unique_id] = v;
+      bind(depth + 1);
+    }
+  };
+  bind(0);
+}
+
+static std::vector<Access>
+rule_accesses(const SimpleRule &r,
+              const std::unordered_map<size_t, mpz_class> &bindings) {
+  std::vector<Access> accesses;
+  AccessCollector c(accesses, bindings);
+  if (r.guard != nullptr)
+    c.dispatch(*r.guard);
+  for (const Ptr<Decl> &d : r.decls)
+    c.dispatch(*d);
+  for (const Ptr<Stmt> &s : r.body)
+    c.dispatch(*s);
+  return accesses;
+}
+
+namespace {
+// a disjoint-set forest over rule instances
+class Components {
+
+private:
+  std::vector<size_t> parent;
+
+public:
+  explicit Components(size_t count) : parent(count) {
+    std::iota(parent.begin(), parent.end(), 0);
+  }
+
+  size_t find(size_t i) {
+    while (parent[i] != i) {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  }
+
+  void join(size_t a, size_t b) { parent[find(a)] = find(b); }
+};
+} // namespace
+
+PorPartition partition_rules(const Model &m) {
+
+  // flatten all rules, as the verifier does
+  std::vector<Ptr<Rule>> rules;
+  for (const Ptr<Node> &c : m.children) {
+    if (auto r = dynamic_cast<const Rule *>(c.get())) {
+      for (const Ptr<Rule> &f : r->flatten())
+        rules.push_back(f);
+    }
+  }
+
+  size_t instances = 0;
+  for (const Ptr<Rule> &r : rules) {
+    if (isa<SimpleRule>(r))
+      instances += instance_count(*r);
+  }
+
+  // decline to reduce models with no rules or too many to tabulate
+  if (instances == 0 || instances > MAX_TABLE)
+    return PorPartition();
+
+  const bool per_instance = instances <= MAX_INSTANCES;
+
+  // state read by properties, whose writers cannot be expanded alone
+  std::vector<Access> visible;
+  for (const Ptr<Rule> &r : rules) {
+    if (auto p = dynamic_cast<const PropertyRule *>(r.get())) {
+      if (p->property.category == Property::LIVENESS)
+        continue;
+      for_each_instance(*p,
+                        [&](const std::unordered_map<size_t, mpz_class> &b) {
+                          AccessCollector c(visible, b);
+                          c.dispatch(*p->property.expr);
+                        });
+    }
+  }
+
+  // Accesses of each unit of analysis, either a rule instance or a whole rule,
+  // and the unit each rule instance belongs to. With no quantifiers bound,
+  // every index they determine is unknown, so one analysis of a rule covers
+  // all of its instances.
+  std::vector<std::vector<Access>> accesses;
+  std::vector<size_t> unit;
+  for (const Ptr<Rule> &r : rules) {
+    if (auto s = dynamic_cast<const SimpleRule *>(r.get())) {
+      if (per_instance) {
+        for_each_instance(*s,
+                          [&](const std::unordered_map<size_t, mpz_class> &b) {
+                            unit.push_back(accesses.size());
+                            accesses.push_back(rule_accesses(*s, b));
+                          });
+      } else {
+        for (size_t i = 0, n = instance_count(*s); i < n; i++)
+          unit.push_back(accesses.size());
+        accesses.push_back(rule_accesses(*s, {}));
+      }
+    }
+  }
+  assert(unit.size() == instances && "miscounted rule instances");
+
+  // join units whose accesses conflict
+  std::unordered_map<size_t, std::vector<std::pair<size_t, const Access *>>>
+      by_var;
+  for (size_t i = 0; i < accesses.size(); i++) {
+    for (const Access &a : accesses[i])
+      by_var[a.var].emplace_back(i, &a);
+  }
+  Components components(accesses.size());
+  for (const auto &v : by_var) {
+    const auto &as = v.second;
+    for (size_t i = 0; i < as.size(); i++) {
+      for (size_t j = i + 1; j < as.size(); j++) {
+        if (!as[i].second->write && !as[j].second->write)
+          continue;
+        if (components.find(as[i].first) == components.find(as[j].first))
+          continue;
+        if (overlap(*as[i].second, *as[j].second))
+          components.join(as[i].first, as[j].first);
+      }
+    }
+  }
+
+  // number the components
+  PorPartition p;
+  std::vector<size_t> unit_component;
+  std::unordered_map<size_t, size_t> ids;
+  for (size_t i = 0; i < accesses.size(); i++) {
+    size_t root = components.find(i);
+    auto it = ids.find(root);
+    if (it == ids.end()) {
+      it = ids.emplace(root, p.eligible.size()).first;
+      p.eligible.push_back(true);
+    }
+    unit_component.push_back(it->second);
+  }
+  for (size_t u : unit)
+    p.component.push_back(unit_component[u]);
+
+  // rule out components that write anything a property reads
+  for (size_t i = 0; i < accesses.size(); i++) {
+    for (const Access &a : accesses[i]) {
+      if (!a.write)
+        continue;
+      for (const Access &v : visible) {
+        if (overlap(a, v)) {
+          p.eligible[unit_component[i]] = false;
+          break;
+        }
+      }
+    }
+  }
+
+  return p;
+}
+
+void generate_por_table(std::ostream &out, const PorPartition &p) {
+
+  out << "/* Component of each rule instance for partial-order reduction, or "
+         "POR_NONE\n"
+      << " * for those that cannot be expanded without the others.\n"
+      << " */\n"
+      << "enum { POR_INSTANCES = " << p.component.size() << "ul };\n"
+      << "#define POR_NONE UINT32_MAX\n"
+      << "static const uint32_t POR_COMPONENT[] = {";
+  for (size_t i = 0; i < p.component.size(); i++) {
+    if (i % 8 == 0)
+      out << "\n ";
+    if (p.eligible[p.component[i]]) {
+      out << " " << p.component[i] << "u,";
+    } else {
+      out << " POR_NONE,";
+    }
+  }
+  out << "\n};\n\n";
+}
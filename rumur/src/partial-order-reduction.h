@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <rumur/rumur.h>
+#include <vector>
+
+/* Partition of the model's rule instances (rules with their quantifiers bound
+ * to each of their values, in the order the verifier fires them) for partial-
+ * order reduction. Two instances are dependent if one writes a part of the
+ * state the other reads or writes. The partition groups instances into
+ * components, such that no instance depends on any instance outside its own
+ * component. A component is ineligible if it contains an instance that writes
+ * something an invariant, assumption or cover property reads. The partition
+ * is empty if the model is not amenable to reduction.
+ */
+struct PorPartition {
+
+  // component of each rule instance
+  std::vector<size_t> component;
+
+  // whether each component may be expanded without the others
+  std::vector<bool> eligible;
+};
+
+PorPartition partition_rules(const rumur::Model &m);
+
+/* Generate the table the verifier uses to choose which rule instances to fire
+ * under partial-order reduction.
+ */
+void generate_por_table(std::ostream &out, const PorPartition &p);
@@ -1,5 +1,6 @@
 #include "symmetry-reduction.h"
 #include "../../common/isa.h"
+#include "layout.h"
 #include "options.h"
 #include "utils.h"
 #include <cassert>
@@ -8,6 +9,8 @@
 #include <iostream>
 #include <memory>
 #include <rumur/rumur.h>
+#include <sstream>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -70,13 +73,13 @@ static void generate_apply_swap(std::ostream &out, const std::string &offset_a,
 
     out << indent << "if (" << offset_a << " != " << offset_b << ") {\n"
         << indent << "  raw_value_t a = handle_read_raw(s, state_handle(s, "
-        << offset_a << ", " << t->width() << "ull));\n"
+        << offset_a << ", " << layout_width(*t) << "ull));\n"
         << indent << "  raw_value_t b = handle_read_raw(s, state_handle(s, "
-        << offset_b << ", " << t->width() << "ull));\n"
+        << offset_b << ", " << layout_width(*t) << "ull));\n"
         << indent << "  handle_write_raw(s, state_handle(s, " << offset_b
-        << ", " << t->width() << "ull), a);\n"
+        << ", " << layout_width(*t) << "ull), a);\n"
         << indent << "  handle_write_raw(s, state_handle(s, " << offset_a
-        << ", " << t->width() << "ull), b);\n"
+        << ", " << layout_width(*t) << "ull), b);\n"
         << indent << "}\n";
     return;
   }
@@ -86,7 +89,7 @@ static void generate_apply_swap(std::ostream &out, const std::string &offset_a,
     mpz_class ic = a->index_type->count() - 1;
     const std::string len = "((size_t)" + ic.get_str() + "ull)";
     const std::string width =
-        "((size_t)" + a->element_type->width().get_str() + "ull)";
+        "((size_t)" + layout_width(*a->element_type).get_str() + "ull)";
 
     out << indent << "for (size_t " << var << " = 0; " << var << " < " << len
         << "; " << var << "++) {\n";
@@ -107,8 +110,8 @@ static void generate_apply_swap(std::ostream &out, const std::string &offset_a,
     for (const Ptr<VarDecl> &f : r->fields) {
       generate_apply_swap(out, off_a, off_b, *f->type, depth);
 
-      off_a += " + ((size_t)" + f->width().get_str() + "ull)";
-      off_b += " + ((size_t)" + f->width().get_str() + "ull)";
+      off_a += " + ((size_t)" + layout_width(*f).get_str() + "ull)";
+      off_b += " + ((size_t)" + layout_width(*f).get_str() + "ull)";
     }
     return;
   }
@@ -130,7 +133,7 @@ static void generate_swap_chunk(std::ostream &out, const TypeExpr &t,
          * one of the pair we are swapping, we need to change it to the other.
          */
 
-        const std::string w = "((size_t)" + t.width().get_str() + "ull)";
+        const std::string w = "((size_t)" + layout_width(t).get_str() + "ull)";
         const std::string h = "state_handle(s, " + offset + ", " + w + ")";
 
         out << indent << "if (x != y) {\n"
@@ -156,7 +159,7 @@ static void generate_swap_chunk(std::ostream &out, const TypeExpr &t,
   if (auto a = dynamic_cast<const Array *>(type.get())) {
 
     const std::string w =
-        "((size_t)" + a->element_type->width().get_str() + "ull)";
+        "((size_t)" + layout_width(*a->element_type).get_str() + "ull)";
 
     // If this array is indexed by our pivot type, swap the relevant elements
     auto s = dynamic_cast<const TypeExprID *>(a->index_type.get());
@@ -193,7 +196,7 @@ static void generate_swap_chunk(std::ostream &out, const TypeExpr &t,
     for (const Ptr<VarDecl> &f : r->fields) {
       generate_swap_chunk(out, *f->type, off, pivot, depth);
 
-      off += " + ((size_t)" + f->width().get_str() + "ull)";
+      off += " + ((size_t)" + layout_width(*f).get_str() + "ull)";
     }
     return;
   }
@@ -390,12 +393,28 @@ static bool is_pivot(const TypeDecl &pivot, const TypeExpr *t) {
   return pivot.name == s->name;
 }
 
-// Generate application of a comparison of two state components
+// is this a reference to a scalarset other than the pivot?
+static bool is_other_scalarset(const TypeDecl &pivot, const TypeExpr *t) {
+
+  if (t == nullptr)
+    return false;
+
+  auto s = dynamic_cast<const TypeExprID *>(t);
+  if (s == nullptr)
+    return false;
+
+  return pivot.name != s->name && isa<Scalarset>(s->resolve());
+}
+
+/* Generate application of a comparison of two state components. With `refine`,
+ * components whose value or position depends on the numbering of another
+ * scalarset are skipped.
+ */
 static void generate_apply_compare(std::ostream &out, const TypeExpr &type,
                                    const std::string &offset_a,
                                    const std::string &offset_b,
-                                   const TypeDecl &pivot, size_t depth = 0,
-                                   bool used_pivot = false) {
+                                   const TypeDecl &pivot, bool refine,
+                                   size_t depth = 0, bool used_pivot = false) {
 
   const Ptr<TypeExpr> t = type.resolve();
 
@@ -408,13 +427,14 @@ static void generate_apply_compare(std::ostream &out, const TypeExpr &type,
      * scalarset, we don't want to reuse it because this value itself will
      * change if/when the parent (array) component is reshuffled.
      */
-    if (!used_pivot || !is_pivot(pivot, &type)) {
+    if ((!used_pivot || !is_pivot(pivot, &type)) &&
+        !(refine && is_other_scalarset(pivot, &type))) {
 
       out << indent << "if (" << offset_a << " != " << offset_b << ") {\n"
           << indent << "  raw_value_t a = handle_read_raw(s, state_handle(s, "
-          << offset_a << ", " << t->width() << "ull));\n"
+          << offset_a << ", " << layout_width(*t) << "ull));\n"
           << indent << "  raw_value_t b = handle_read_raw(s, state_handle(s, "
-          << offset_b << ", " << t->width() << "ull));\n"
+          << offset_b << ", " << layout_width(*t) << "ull));\n"
           << indent << "  if (a < b) {\n"
           << indent << "    return -1;\n"
           << indent << "  } else if (a > b) {\n"
@@ -428,6 +448,9 @@ static void generate_apply_compare(std::ostream &out, const TypeExpr &type,
 
   if (auto a = dynamic_cast<const Array *>(t.get())) {
 
+    if (refine && is_other_scalarset(pivot, a->index_type.get()))
+      return;
+
     if (!used_pivot || !is_pivot(pivot, a->index_type.get())) {
 
       used_pivot |= is_pivot(pivot, a->index_type.get());
@@ -436,7 +459,7 @@ static void generate_apply_compare(std::ostream &out, const TypeExpr &type,
       mpz_class ic = a->index_type->count() - 1;
       const std::string len = "((size_t)" + ic.get_str() + "ull)";
       const std::string width =
-          "((size_t)" + a->element_type->width().get_str() + "ull)";
+          "((size_t)" + layout_width(*a->element_type).get_str() + "ull)";
 
       out << indent << "for (size_t " << var << " = 0; " << var << " < " << len
           << "; " << var << "++) {\n";
@@ -445,7 +468,7 @@ static void generate_apply_compare(std::ostream &out, const TypeExpr &type,
       const std::string off_b = offset_b + " + " + var + " * " + width;
 
       generate_apply_compare(out, *a->element_type, off_a, off_b, pivot,
-                             depth + 1, used_pivot);
+                             refine, depth + 1, used_pivot);
 
       out << indent << "}\n";
     }
@@ -458,11 +481,11 @@ static void generate_apply_compare(std::ostream &out, const TypeExpr &type,
     std::string off_b = offset_b;
 
     for (const Ptr<VarDecl> &f : r->fields) {
-      generate_apply_compare(out, *f->type, off_a, off_b, pivot, depth,
-                             used_pivot);
+      generate_apply_compare(out, *f->type, off_a, off_b, pivot, refine,
+                             depth, used_pivot);
 
-      off_a += " + ((size_t)" + f->width().get_str() + "ull)";
-      off_b += " + ((size_t)" + f->width().get_str() + "ull)";
+      off_a += " + ((size_t)" + layout_width(*f).get_str() + "ull)";
+      off_b += " + ((size_t)" + layout_width(*f).get_str() + "ull)";
     }
     return;
   }
@@ -473,8 +496,8 @@ static void generate_apply_compare(std::ostream &out, const TypeExpr &type,
 // Generate part of a memcmp-style comparator
 static void generate_compare_chunk(std::ostream &out, const TypeExpr &t,
                                    const std::string offset,
-                                   const TypeDecl &pivot, size_t depth = 0,
-                                   bool used_pivot = false) {
+                                   const TypeDecl &pivot, bool refine,
+                                   size_t depth = 0, bool used_pivot = false) {
 
   const std::string indent((depth + 1) * 2, ' ');
 
@@ -485,7 +508,8 @@ static void generate_compare_chunk(std::ostream &out, const TypeExpr &t,
      */
     if (is_pivot(pivot, &t) && !used_pivot) {
 
-      const std::string width = "((size_t)" + t.width().get_str() + "ull)";
+      const std::string width =
+          "((size_t)" + layout_width(t).get_str() + "ull)";
       out
 
           /* Open a scope so we don't need to think about redeclaring/shadowing
@@ -518,9 +542,16 @@ static void generate_compare_chunk(std::ostream &out, const TypeExpr &t,
 
   if (auto a = dynamic_cast<const Array *>(type.get())) {
 
+    /* The order in which another scalarset's elements are visited depends on
+     * how that scalarset is numbered, so these cannot be used to tell the
+     * pivot's values apart when refining.
+     */
+    if (refine && is_other_scalarset(pivot, a->index_type.get()))
+      return;
+
     // The bit size of each array element as a C code string
     const std::string width =
-        "((size_t)" + a->element_type->width().get_str() + "ull)";
+        "((size_t)" + layout_width(*a->element_type).get_str() + "ull)";
 
     /* If this array is indexed by the pivot type, first compare the relevant
      * elements. Note, we'll only end up descending if the two elements happen
@@ -531,8 +562,8 @@ static void generate_compare_chunk(std::ostream &out, const TypeExpr &t,
       const std::string off_x = offset + " + x * " + width;
       const std::string off_y = offset + " + y * " + width;
 
-      generate_apply_compare(out, *a->element_type, off_x, off_y, pivot, depth,
-                             true);
+      generate_apply_compare(out, *a->element_type, off_x, off_y, pivot, refine,
+                             depth, true);
 
       used_pivot = true;
     }
@@ -550,8 +581,8 @@ static void generate_compare_chunk(std::ostream &out, const TypeExpr &t,
 
     // Generate code to compare each element
     const std::string off = offset + " + " + var + " * " + width;
-    generate_compare_chunk(out, *a->element_type, off, pivot, depth + 1,
-                           used_pivot);
+    generate_compare_chunk(out, *a->element_type, off, pivot, refine,
+                           depth + 1, used_pivot);
 
     // Close the loop
     out << indent << "}\n";
@@ -566,10 +597,12 @@ static void generate_compare_chunk(std::ostream &out, const TypeExpr &t,
     for (const Ptr<VarDecl> &f : r->fields) {
 
       // Generate code to compare this field
-      generate_compare_chunk(out, *f->type, off, pivot, depth, used_pivot);
+      generate_compare_chunk(out, *f->type, off, pivot, refine, depth,
+                             used_pivot);
 
       // Jump over this field to get the offset of the next field
-      const std::string width = "((size_t)" + f->width().get_str() + "ull)";
+      const std::string width =
+          "((size_t)" + layout_width(*f).get_str() + "ull)";
       off += " + " + width;
     }
 
@@ -580,12 +613,15 @@ static void generate_compare_chunk(std::ostream &out, const TypeExpr &t,
 }
 
 /* Generate a memcmp-style comparator for a given scalarset with respect to the
- * state.
+ * state. The comparator generated with `refine` (compare_refine_<name>) gives
+ * the same result however the scalarsets of the state are numbered, so that it
+ * can be used to derive an exact canonical form.
  */
 static void generate_compare(std::ostream &out, const TypeDecl &pivot,
-                             const Model &m) {
+                             const Model &m, bool refine) {
 
-  out << "static int compare_" << pivot.name << "(const struct state *s, "
+  out << "static int compare_" << (refine ? "refine_" : "") << pivot.name
+      << "(const struct state *s, "
       << "size_t x, size_t y) {\n"
       << "\n"
       << "  if (x == y) {\n"
@@ -596,7 +632,7 @@ static void generate_compare(std::ostream &out, const TypeDecl &pivot,
   for (const Ptr<Node> &c : m.children) {
     if (auto v = dynamic_cast<const VarDecl *>(c.get())) {
       const std::string offset = "((size_t)" + v->offset.get_str() + "ull)";
-      generate_compare_chunk(out, *v->type, offset, pivot);
+      generate_compare_chunk(out, *v->type, offset, pivot, refine);
     }
   }
 
@@ -606,11 +642,14 @@ static void generate_compare(std::ostream &out, const TypeDecl &pivot,
       << "}\n";
 }
 
-static void generate_sort(std::ostream &out, const TypeDecl &pivot) {
+static void generate_sort(std::ostream &out, const TypeDecl &pivot,
+                          bool refine) {
 
   assert(isa<Scalarset>(pivot.value->resolve()));
 
-  out << "static void sort_" << pivot.name << "(struct state *s, "
+  const std::string name = (refine ? "refine_" : "") + pivot.name;
+
+  out << "static void sort_" << name << "(struct state *s, "
       << "size_t *schedule, size_t lower, size_t upper) {\n"
       << "\n"
       << "  /* If we have nothing to sort, bail out. */\n"
@@ -629,14 +668,14 @@ static void generate_sort(std::ostream &out, const TypeDecl &pivot) {
       << "    do {\n"
       << "      i++;\n"
       << "      assert(i >= lower && i <= upper && \"out of bounds access in "
-      << "sort_" << pivot.name << "()\");\n"
-      << "    } while (compare_" << pivot.name << "(s, i, pivot) < 0);\n"
+      << "sort_" << name << "()\");\n"
+      << "    } while (compare_" << name << "(s, i, pivot) < 0);\n"
       << "\n"
       << "    do {\n"
       << "      j--;\n"
       << "      assert(j >= lower && j <= upper && \"out of bounds access in "
-      << "sort_" << pivot.name << "()\");\n"
-      << "    } while (compare_" << pivot.name << "(s, j, pivot) > 0);\n"
+      << "sort_" << name << "()\");\n"
+      << "    } while (compare_" << name << "(s, j, pivot) > 0);\n"
       << "\n"
       << "    if (i >= j) {\n"
       << "      break;\n"
@@ -656,8 +695,8 @@ static void generate_sort(std::ostream &out, const TypeDecl &pivot) {
       << "    }\n"
       << "  }\n"
       << "\n"
-      << "  sort_" << pivot.name << "(s, schedule, lower, j);\n"
-      << "  sort_" << pivot.name << "(s, schedule, j + 1, upper);\n"
+      << "  sort_" << name << "(s, schedule, lower, j);\n"
+      << "  sort_" << name << "(s, schedule, j + 1, upper);\n"
       << "}\n";
 }
 
@@ -667,8 +706,8 @@ generate_canonicalise_heuristic(const Model &m,
                                 std::ostream &out) {
 
   for (const TypeDecl *t : scalarsets) {
-    generate_compare(out, *t, m);
-    generate_sort(out, *t);
+    generate_compare(out, *t, m, false);
+    generate_sort(out, *t, false);
   }
 
   out << "static void state_canonicalise_heuristic(struct state *s "
@@ -716,6 +755,460 @@ generate_canonicalise_heuristic(const Model &m,
   out << "}\n\n";
 }
 
+/* Generate reads of the pivot-typed components within an element of an array
+ * indexed by the pivot. Each is recorded in the refinement key as the class of
+ * the value it refers to. `count` is incremented by the number of components.
+ */
+static void generate_key_element(std::ostream &out, const TypeExpr &type,
+                                 const std::string &offset,
+                                 const TypeDecl &pivot, size_t depth,
+                                 const mpz_class &multiplier,
+                                 mpz_class &count) {
+
+  const Ptr<TypeExpr> t = type.resolve();
+
+  const std::string indent((depth + 1) * 2, ' ');
+
+  if (t->is_simple()) {
+    if (is_pivot(pivot, &type)) {
+      out << indent << "{\n"
+          << indent << "  raw_value_t v = handle_read_raw(s, state_handle(s, "
+          << offset << ", " << layout_width(*t) << "ull));\n"
+          << indent << "  key[k] = v == 0 ? 0 : cls[v - 1] + 1;\n"
+          << indent << "  k++;\n"
+          << indent << "}\n";
+      count += multiplier;
+    }
+    return;
+  }
+
+  if (auto a = dynamic_cast<const Array *>(t.get())) {
+
+    // positions within arrays indexed by a scalarset are not fixed
+    if (isa<Scalarset>(a->index_type->resolve()))
+      return;
+
+    const std::string var = "i" + std::to_string(depth);
+    mpz_class ic = a->index_type->count() - 1;
+    const std::string width =
+        "((size_t)" + layout_width(*a->element_type).get_str() + "ull)";
+
+    out << indent << "for (size_t " << var << " = 0; " << var << " < ((size_t)"
+        << ic.get_str() << "ull); " << var << "++) {\n";
+    generate_key_element(out, *a->element_type,
+                         offset + " + " + var + " * " + width, pivot,
+                         depth + 1, multiplier * ic, count);
+    out << indent << "}\n";
+    return;
+  }
+
+  if (auto r = dynamic_cast<const Record *>(t.get())) {
+    std::string off = offset;
+    for (const Ptr<VarDecl> &f : r->fields) {
+      generate_key_element(out, *f->type, off, pivot, depth, multiplier, count);
+      off += " + ((size_t)" + layout_width(*f).get_str() + "ull)";
+    }
+    return;
+  }
+
+  assert(!"missed case in generate_key_element");
+}
+
+// Find the arrays indexed by the pivot and generate reads of their elements
+static void generate_key_chunk(std::ostream &out, const TypeExpr &type,
+                               const std::string &offset,
+                               const TypeDecl &pivot, size_t depth,
+                               const mpz_class &multiplier, mpz_class &count) {
+
+  const Ptr<TypeExpr> t = type.resolve();
+
+  const std::string indent((depth + 1) * 2, ' ');
+
+  if (t->is_simple())
+    return;
+
+  if (auto a = dynamic_cast<const Array *>(t.get())) {
+
+    const std::string width =
+        "((size_t)" + layout_width(*a->element_type).get_str() + "ull)";
+
+    if (is_pivot(pivot, a->index_type.get())) {
+      generate_key_element(out, *a->element_type,
+                           offset + " + x * " + width, pivot, depth,
+                           multiplier, count);
+      return;
+    }
+
+    if (isa<Scalarset>(a->index_type->resolve()))
+      return;
+
+    const std::string var = "i" + std::to_string(depth);
+    mpz_class ic = a->index_type->count() - 1;
+
+    out << indent << "for (size_t " << var << " = 0; " << var << " < ((size_t)"
+        << ic.get_str() << "ull); " << var << "++) {\n";
+    generate_key_chunk(out, *a->element_type,
+                       offset + " + " + var + " * " + width, pivot, depth + 1,
+                       multiplier * ic, count);
+    out << indent << "}\n";
+    return;
+  }
+
+  if (auto r = dynamic_cast<const Record *>(t.get())) {
+    std::string off = offset;
+    for (const Ptr<VarDecl> &f : r->fields) {
+      generate_key_chunk(out, *f->type, off, pivot, depth, multiplier, count);
+      off += " + ((size_t)" + layout_width(*f).get_str() + "ull)";
+    }
+    return;
+  }
+
+  assert(!"missed case in generate_key_chunk");
+}
+
+/* Generate a function that splits ties of the given scalarset by the classes of
+ * the values each value refers to, until no further split is possible. That
+ * is, two values that compare equal may still be told apart if one is linked
+ * (via an array indexed by the scalarset) to a value in a different class than
+ * the other. Returns false if the state contains no such links, in which case
+ * no function is generated.
+ */
+static bool generate_refine_split(std::ostream &out, const TypeDecl &pivot,
+                                  size_t index, const std::string &offset,
+                                  const std::string &bound, const Model &m) {
+
+  std::ostringstream reads;
+  mpz_class count = 0;
+  for (const Ptr<Node> &c : m.children) {
+    if (auto v = dynamic_cast<const VarDecl *>(c.get())) {
+      const std::string off = "((size_t)" + v->offset.get_str() + "ull)";
+      generate_key_chunk(reads, *v->type, off, pivot, 0, 1, count);
+    }
+  }
+
+  if (count == 0)
+    return false;
+
+  const std::string key_size = "((size_t)" + count.get_str() + "ull)";
+
+  out << "static void refine_key_" << pivot.name
+      << "(const struct state *NONNULL s, size_t x,\n"
+      << "    const size_t *NONNULL cls, size_t *NONNULL key) {\n"
+      << "  size_t k = 0;\n"
+      << reads.str()
+      << "  assert(k == " << key_size << " && \"incorrect key length\");\n"
+      << "}\n\n";
+
+  out << "static size_t refine_split_" << pivot.name
+      << "(struct state *NONNULL s,\n"
+      << "    size_t *NONNULL schedule, struct refine_tie *NONNULL ties, "
+         "size_t first,\n"
+      << "    size_t count) {\n"
+      << "\n"
+      << "  for (;;) {\n"
+      << "\n"
+      << "    /* the class of each value is the first position of its run */\n"
+      << "    size_t cls[" << bound << "];\n"
+      << "    for (size_t i = 0; i < " << bound << "; i++) {\n"
+      << "      cls[i] = i;\n"
+      << "    }\n"
+      << "    for (size_t i = first; i < count; i++) {\n"
+      << "      for (size_t j = 0; j < ties[i].size; j++) {\n"
+      << "        cls[ties[i].lower + j] = ties[i].lower;\n"
+      << "      }\n"
+      << "    }\n"
+      << "\n"
+      << "    size_t keys[" << bound << "][" << key_size << "];\n"
+      << "    for (size_t i = first; i < count; i++) {\n"
+      << "      for (size_t j = 0; j < ties[i].size; j++) {\n"
+      << "        refine_key_" << pivot.name
+      << "(s, ties[i].lower + j, cls, keys[ties[i].lower + j]);\n"
+      << "      }\n"
+      << "    }\n"
+      << "\n"
+      << "    struct refine_tie split[" << bound << "];\n"
+      << "    size_t split_count = 0;\n"
+      << "    bool changed = false;\n"
+      << "    for (size_t i = first; i < count; i++) {\n"
+      << "      size_t lower = ties[i].lower;\n"
+      << "      size_t upper = lower + ties[i].size;\n"
+      << "\n"
+      << "      /* sort the run by key, with insertion sort as runs are short "
+         "*/\n"
+      << "      for (size_t a = lower + 1; a < upper; a++) {\n"
+      << "        for (size_t b = a; b > lower &&\n"
+      << "             memcmp(keys[b - 1], keys[b], sizeof(keys[b])) > 0; "
+         "b--) {\n"
+      << "          swap_" << pivot.name << "(s, b - 1, b);\n"
+      << "          size_t tmp[" << key_size << "];\n"
+      << "          memcpy(tmp, keys[b - 1], sizeof(tmp));\n"
+      << "          memcpy(keys[b - 1], keys[b], sizeof(tmp));\n"
+      << "          memcpy(keys[b], tmp, sizeof(tmp));\n"
+      << "          size_t t = schedule[b - 1];\n"
+      << "          schedule[b - 1] = schedule[b];\n"
+      << "          schedule[b] = t;\n"
+      << "        }\n"
+      << "      }\n"
+      << "\n"
+      << "      /* split it where the keys differ */\n"
+      << "      size_t start = lower;\n"
+      << "      for (size_t a = lower + 1; a <= upper; a++) {\n"
+      << "        if (a == upper ||\n"
+      << "            memcmp(keys[a - 1], keys[a], sizeof(keys[a])) != 0) {\n"
+      << "          if (a - start != upper - lower) {\n"
+      << "            changed = true;\n"
+      << "          }\n"
+      << "          if (a - start > 1) {\n"
+      << "            split[split_count] = (struct refine_tie){\n"
+      << "                .scalarset = " << index << ",\n"
+      << "                .offset = " << offset << ",\n"
+      << "                .lower = start,\n"
+      << "                .size = a - start};\n"
+      << "            split_count++;\n"
+      << "          }\n"
+      << "          start = a;\n"
+      << "        }\n"
+      << "      }\n"
+      << "    }\n"
+      << "\n"
+      << "    memcpy(&ties[first], split, sizeof(split[0]) * split_count);\n"
+      << "    count = first + split_count;\n"
+      << "    if (!changed) {\n"
+      << "      return count;\n"
+      << "    }\n"
+      << "  }\n"
+      << "}\n\n";
+
+  return true;
+}
+
+static void generate_canonicalise_refinement(
+    const Model &m, const std::vector<const TypeDecl *> &scalarsets,
+    std::ostream &out) {
+
+  if (scalarsets.empty()) {
+    out << "static void state_canonicalise_refinement(struct state *s "
+           "__attribute__((unused))) {\n"
+        << "  assert(s != NULL && \"attempt to canonicalise NULL state\");\n"
+        << "}\n\n";
+    return;
+  }
+
+  for (const TypeDecl *t : scalarsets) {
+    generate_compare(out, *t, m, true);
+    generate_sort(out, *t, true);
+  }
+
+  /* The schedules of all scalarsets are kept in one array, so the best seen so
+   * far can be saved with a single copy. Find where each one starts.
+   */
+  std::vector<std::string> bounds;
+  std::vector<std::string> offsets;
+  mpz_class max_bound = 0;
+  mpz_class total = 0;
+  for (const TypeDecl *t : scalarsets) {
+    const Ptr<TypeExpr> type = t->value->resolve();
+    auto s = dynamic_cast<const Scalarset *>(type.get());
+    assert(s != nullptr);
+    mpz_class bound = s->count() - 1;
+    bounds.push_back("((size_t)" + bound.get_str() + "ull)");
+    offsets.push_back("((size_t)" + total.get_str() + "ull)");
+    if (bound > max_bound)
+      max_bound = bound;
+    total += bound;
+  }
+  const std::string schedule_size = "((size_t)" + total.get_str() + "ull)";
+
+  out << "/* A run of values of one scalarset that refinement could not tell "
+         "apart. */\n"
+      << "struct refine_tie {\n"
+      << "  size_t scalarset;\n"
+      << "  size_t offset; /* where this scalarset starts in the schedule */\n"
+      << "  size_t lower;\n"
+      << "  size_t size;\n"
+      << "};\n\n";
+
+  std::vector<bool> splits;
+  for (size_t i = 0; i < scalarsets.size(); i++)
+    splits.push_back(generate_refine_split(out, *scalarsets[i], i, offsets[i],
+                                           bounds[i], m));
+
+  out << "static void refine_swap(size_t scalarset, struct state *NONNULL s, "
+         "size_t x,\n"
+      << "                        size_t y) {\n"
+      << "  switch (scalarset) {\n";
+  for (size_t i = 0; i < scalarsets.size(); i++)
+    out << "  case " << i << ":\n"
+        << "    swap_" << scalarsets[i]->name << "(s, x, y);\n"
+        << "    break;\n";
+  out << "  }\n"
+      << "}\n\n";
+
+  out << "/* Try every permutation of the values within each of the given "
+         "ties, keeping\n"
+      << " * the least candidate state in `s` and its schedule in `best`.\n"
+      << " */\n"
+      << "static void refine_permute(struct state *NONNULL s,\n"
+      << "                           struct state *NONNULL candidate,\n"
+      << "                           const struct refine_tie *NONNULL ties, "
+         "size_t count,\n"
+      << "                           size_t *NONNULL schedule, size_t *NONNULL "
+         "best) {\n"
+      << "\n"
+      << "  if (count == 0) {\n"
+      << "    if (state_cmp(candidate, s) < 0) {\n"
+      << "      /* Found a more canonical representation. */\n"
+      << "      memcpy(s, candidate, sizeof(*s));\n"
+      << "      memcpy(best, schedule, sizeof(schedule[0]) * " << schedule_size
+      << ");\n"
+      << "    }\n"
+      << "    return;\n"
+      << "  }\n"
+      << "\n"
+      << "  /* Heap's algorithm over the first tie, recursing into the rest "
+         "for each\n"
+      << "   * permutation\n"
+      << "   */\n"
+      << "  const struct refine_tie *t = &ties[0];\n"
+      << "  size_t stack[(size_t)" << max_bound.get_str() << "ull] = { 0 };\n"
+      << "  refine_permute(s, candidate, ties + 1, count - 1, schedule, "
+         "best);\n"
+      << "  for (size_t i = 1; i < t->size;) {\n"
+      << "    if (stack[i] < i) {\n"
+      << "      size_t x = t->lower + (i % 2 == 0 ? 0 : stack[i]);\n"
+      << "      size_t y = t->lower + i;\n"
+      << "      refine_swap(t->scalarset, candidate, x, y);\n"
+      << "      size_t tmp = schedule[t->offset + x];\n"
+      << "      schedule[t->offset + x] = schedule[t->offset + y];\n"
+      << "      schedule[t->offset + y] = tmp;\n"
+      << "      refine_permute(s, candidate, ties + 1, count - 1, schedule, "
+         "best);\n"
+      << "      stack[i]++;\n"
+      << "      i = 1;\n"
+      << "    } else {\n"
+      << "      stack[i] = 0;\n"
+      << "      i++;\n"
+      << "    }\n"
+      << "  }\n"
+      << "}\n\n";
+
+  out << "static void state_canonicalise_refinement(struct state *s "
+         "__attribute__((unused))) {\n"
+      << "\n"
+      << "  assert(s != NULL && \"attempt to canonicalise NULL state\");\n"
+      << "\n"
+      << "  size_t schedule[" << schedule_size << "];\n"
+      << "\n"
+      << "  /* Order the values of each scalarset by what the state says about "
+         "them. This\n"
+      << "   * ordering does not depend on how the values happen to be "
+         "numbered.\n"
+      << "   */\n";
+  for (size_t i = 0; i < scalarsets.size(); i++) {
+    const std::string sch = "&schedule[" + offsets[i] + "]";
+    out << "  for (size_t i = 0; i < " << bounds[i] << "; ++i) {\n"
+        << "    schedule[" << offsets[i] << " + i] = i;\n"
+        << "  }\n"
+        << "  if (USE_SCALARSET_SCHEDULES) {\n"
+        << "    size_t index = schedule_read_" << scalarsets[i]->name
+        << "(s);\n"
+        << "    size_t stack[" << bounds[i] << "];\n"
+        << "    index_to_permutation(index, " << sch << ", stack, " << bounds[i]
+        << ");\n"
+        << "  }\n"
+        << "  sort_refine_" << scalarsets[i]->name << "(s, " << sch << ", 0, "
+        << bounds[i] << " - 1);\n";
+  }
+
+  out << "\n"
+      << "  /* Find the runs of values that are still indistinguishable. Only "
+         "permutations\n"
+      << "   * within these runs can yield a different least state.\n"
+      << "   */\n"
+      << "  struct refine_tie ties[" << schedule_size << "];\n"
+      << "  size_t tie_count = 0;\n";
+  for (size_t i = 0; i < scalarsets.size(); i++) {
+    out << "  {\n";
+    if (splits[i])
+      out << "    size_t first = tie_count;\n";
+    out << "    size_t lower = 0;\n"
+        << "    for (size_t i = 1; i <= " << bounds[i] << "; i++) {\n"
+        << "      if (i == " << bounds[i] << " ||\n"
+        << "          compare_refine_" << scalarsets[i]->name
+        << "(s, i - 1, i) != 0) {\n"
+        << "        if (i - lower > 1) {\n"
+        << "          ties[tie_count] = (struct refine_tie){\n"
+        << "              .scalarset = " << i << ",\n"
+        << "              .offset = " << offsets[i] << ",\n"
+        << "              .lower = lower,\n"
+        << "              .size = i - lower};\n"
+        << "          tie_count++;\n"
+        << "        }\n"
+        << "        lower = i;\n"
+        << "      }\n"
+        << "    }\n";
+    if (splits[i])
+      out << "    tie_count = refine_split_" << scalarsets[i]->name << "(s, "
+          << "&schedule[" << offsets[i] << "], ties, first, tie_count);\n";
+    out << "  }\n";
+  }
+
+  out << "\n"
+      << "  if (tie_count > 0) {\n"
+      << "\n"
+      << "    /* A state to store the current permutation we are considering. "
+         "*/\n"
+      << "    static _Thread_local struct state candidate;\n"
+      << "    memcpy(&candidate, s, sizeof(candidate));\n"
+      << "\n"
+      << "    /* Drop any run whose neighbouring values can be exchanged "
+         "without changing\n"
+      << "     * the state. Such exchanges generate every permutation of the "
+         "run, so none\n"
+      << "     * of them can yield a lesser state.\n"
+      << "     */\n"
+      << "    size_t kept = 0;\n"
+      << "    for (size_t i = 0; i < tie_count; i++) {\n"
+      << "      const struct refine_tie *t = &ties[i];\n"
+      << "      bool interchangeable = true;\n"
+      << "      for (size_t j = t->lower; j + 1 < t->lower + t->size; j++) {\n"
+      << "        refine_swap(t->scalarset, &candidate, j, j + 1);\n"
+      << "        interchangeable = state_cmp(&candidate, s) == 0;\n"
+      << "        refine_swap(t->scalarset, &candidate, j, j + 1);\n"
+      << "        if (!interchangeable) {\n"
+      << "          break;\n"
+      << "        }\n"
+      << "      }\n"
+      << "      if (!interchangeable) {\n"
+      << "        ties[kept] = *t;\n"
+      << "        kept++;\n"
+      << "      }\n"
+      << "    }\n"
+      << "\n"
+      << "    if (kept > 0) {\n"
+      << "      size_t best[" << schedule_size << "];\n"
+      << "      memcpy(best, schedule, sizeof(best));\n"
+      << "      refine_permute(s, &candidate, ties, kept, schedule, best);\n"
+      << "      memcpy(schedule, best, sizeof(schedule));\n"
+      << "    }\n"
+      << "  }\n"
+      << "\n"
+      << "  /* save selected schedule to map this back for later more\n"
+      << "   * comprehensible counterexample traces\n"
+      << "   */\n"
+      << "  if (USE_SCALARSET_SCHEDULES) {\n";
+  for (size_t i = 0; i < scalarsets.size(); i++)
+    out << "    {\n"
+        << "      size_t stack[" << bounds[i] << "];\n"
+        << "      size_t working[" << bounds[i] << "];\n"
+        << "      size_t index = permutation_to_index(&schedule[" << offsets[i]
+        << "], stack, working, " << bounds[i] << ");\n"
+        << "      schedule_write_" << scalarsets[i]->name << "(s, index);\n"
+        << "    }\n";
+  out << "  }\n"
+      << "}\n\n";
+}
+
 void generate_canonicalise(const Model &m, std::ostream &out) {
 
   // Find types eligible for use in canonicalisation
@@ -740,4 +1233,6 @@ void generate_canonicalise(const Model &m, std::ostream &out) {
   generate_canonicalise_exhaustive(scalarsets, out);
 
   generate_canonicalise_heuristic(m, scalarsets, out);
+
+  generate_canonicalise_refinement(m, scalarsets, out);
 }
@@ -0,0 +1,24 @@
+-- rumur_flags: ['--bitstate', '3', '--set-capacity', '64']
+-- checker_output: re.compile(r'\bbitstate_fill_ratio="0\.[5-9]\d*".*\bbitstate_coverage="0\.\d+"') if xml else re.compile(r'^\s*\d{1,3} states, .*^\s*\* The bitstate array is ([5-9]\d|100)\.\d\d% full, giving an estimated coverage of \d{1,2}\.\d\d% of the state space\.$', re.MULTILINE | re.DOTALL)
+
+-- A bit array of only 512 bits cannot distinguish this model's 16384 states.
+-- Every new state sets at least one more bit, so at most 512 states are
+-- explored. The array should end up mostly full, and the reported coverage
+-- should reflect that part of the state space was missed.
+
+var
+  a: 0 .. 127;
+  b: 0 .. 127;
+
+startstate begin
+  a := 0;
+  b := 0;
+end;
+
+rule begin
+  a := (a + 3) % 128;
+end;
+
+rule begin
+  b := (b + 5) % 128;
+end;
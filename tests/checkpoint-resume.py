@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+
+'''
+Test that a verifier interrupted part way through a run can be resumed from its
+checkpoint, and that it then reaches the same result as an uninterrupted run.
+Also test that checkpoints that are corrupt or belong to a different model or
+seen set configuration are rejected.
+'''
+
+import os
+from pathlib import Path
+import re
+import signal
+import subprocess as sp
+import sys
+import tempfile
+import time
+
+# a model whose states are each slow to check, so a run lasts long enough to be
+# interrupted after its first checkpoint
+MODEL = '''
+var
+  x: 0 .. 299;
+  y: 0 .. 299;
+
+function spin(): boolean;
+  var t: 0 .. 9999;
+begin
+  t := x;
+  for i: 1 .. 3000 do
+    t := (t * 7 + i + y) % 10000;
+  end;
+  return t >= 0;
+end;
+
+startstate begin
+  x := 0;
+  y := 0;
+end;
+
+rule begin
+  x := (x + 1) % 300;
+end;
+
+rule begin
+  y := (y + 1) % 300;
+end;
+
+invariant "spin" spin();
+'''
+
+# a different model with the same state size
+OTHER_MODEL = MODEL.replace('(x + 1) % 300', '(x + 2) % 300')
+
+CONFIG = Path(__file__).parent / 'config'
+
+def build(tmp, name, model, args):
+  '''
+  generate and compile a verifier
+  '''
+  model_m = Path(tmp) / '{}.m'.format(name)
+  model_c = Path(tmp) / '{}.c'.format(name)
+  model_bin = Path(tmp) / name
+  with open(str(model_m), 'wt', encoding='utf-8') as f:
+    f.write(model)
+
+  sp.check_call(['rumur', '--output', str(model_c), str(model_m)] + args)
+
+  cc = os.environ.get('CC', 'cc')
+  argv = [cc, '-std=c11', '-O3', '-o', str(model_bin), str(model_c),
+    '-lpthread']
+  if eval(sp.check_output([str(CONFIG / 'HAS_MCX16')])):
+    argv += ['-mcx16']
+  if eval(sp.check_output([str(CONFIG / 'NEEDS_LIBATOMIC')])):
+    argv += ['-latomic']
+  sp.check_call(argv)
+
+  return str(model_bin)
+
+def interrupt(verifier, checkpoint):
+  '''
+  start a verifier and kill it once it has written its first checkpoint
+  '''
+  p = sp.Popen([verifier], stdout=sp.DEVNULL)
+  while not os.path.exists(checkpoint):
+    assert p.poll() is None, 'run finished before taking a checkpoint'
+    time.sleep(0.1)
+  p.send_signal(signal.SIGKILL)
+  p.wait()
+
+def run(verifier):
+  p = sp.run([verifier], stdout=sp.PIPE, stderr=sp.STDOUT,
+    universal_newlines=True)
+  print(p.stdout)
+  return p.returncode, p.stdout
+
+def states(output):
+  m = re.search(r'^\s*(\d+) states, ', output, re.MULTILINE)
+  assert m is not None, 'no state count in output'
+  return int(m.group(1))
+
+def main():
+
+  with tempfile.TemporaryDirectory() as tmp:
+
+    checkpoint = os.path.join(tmp, 'checkpoint')
+
+    # a run for reference, without checkpointing
+    reference = build(tmp, 'reference', MODEL, [])
+    print('+ reference run')
+    ref_ret, ref_output = run(reference)
+
+    # a run that takes checkpoints as it goes, with two threads that have to
+    # meet for each one, should still reach the same result
+    uninterrupted = build(tmp, 'uninterrupted', MODEL, ['--threads', '2',
+      '--checkpoint', os.path.join(tmp, 'uninterrupted.ckpt'),
+      '--checkpoint-interval', '1'])
+    print('+ uninterrupted run taking checkpoints')
+    ret, output = run(uninterrupted)
+    assert ret == ref_ret, 'checkpointing run exited with {}, not {}' \
+      .format(ret, ref_ret)
+    assert states(output) == states(ref_output), \
+      'checkpointing run found {} states, not {}' \
+      .format(states(output), states(ref_output))
+
+    # start a run that takes a checkpoint every second, and kill it once the
+    # first checkpoint has been written
+    first = build(tmp, 'first', MODEL, ['--checkpoint', checkpoint,
+      '--checkpoint-interval', '1'])
+    print('+ interrupted run')
+    interrupt(first, checkpoint)
+
+    # resuming should reach the same result as the reference run
+    resumed = build(tmp, 'resumed', MODEL, ['--resume', checkpoint])
+    print('+ resumed run')
+    ret, output = run(resumed)
+    assert re.search(r'^Resuming from ', output, re.MULTILINE) is not None, \
+      'resumed run did not report resuming'
+    assert ret == ref_ret, 'resumed run exited with {}, not {}' \
+      .format(ret, ref_ret)
+    assert states(output) == states(ref_output), \
+      'resumed run found {} states, not {}' \
+      .format(states(output), states(ref_output))
+
+    # a verifier for a different model should refuse the checkpoint
+    other = build(tmp, 'other', OTHER_MODEL, ['--resume', checkpoint])
+    print('+ resuming a different model')
+    ret, output = run(other)
+    assert ret != 0, 'checkpoint of a different model was accepted'
+    assert 'is not a checkpoint of a verifier for this model' in output
+
+    # interrupt a run storing fingerprints of states instead
+    compacted = os.path.join(tmp, 'compacted')
+    first_compacted = build(tmp, 'first_compacted', MODEL,
+      ['--hash-compaction', '40', '--checkpoint', compacted,
+       '--checkpoint-interval', '1'])
+    print('+ interrupted run with hash compaction')
+    interrupt(first_compacted, compacted)
+
+    # resuming with a different fingerprint width should be refused, as the
+    # slots in the checkpoint would be misread
+    wider = build(tmp, 'wider', MODEL,
+      ['--hash-compaction', '48', '--resume', compacted])
+    print('+ resuming with a different fingerprint width')
+    ret, output = run(wider)
+    assert ret != 0, 'checkpoint with different fingerprints was accepted'
+    assert 'is not a checkpoint of a verifier for this model' in output
+
+    # so should resuming with the full states stored
+    full = build(tmp, 'full', MODEL, ['--resume', compacted])
+    print('+ resuming without hash compaction')
+    ret, output = run(full)
+    assert ret != 0, 'checkpoint of fingerprints was accepted for full states'
+    assert 'is not a checkpoint of a verifier for this model' in output
+
+    # while resuming with the same width should reach the reference result
+    same = build(tmp, 'same', MODEL,
+      ['--hash-compaction', '40', '--resume', compacted])
+    print('+ resuming with the same fingerprint width')
+    ret, output = run(same)
+    assert ret == ref_ret, 'resumed run exited with {}, not {}' \
+      .format(ret, ref_ret)
+    assert states(output) == states(ref_output), \
+      'resumed run found {} states, not {}' \
+      .format(states(output), states(ref_output))
+
+    with open(checkpoint, 'rb') as f:
+      data = f.read()
+
+    # a checkpoint with a byte changed should be rejected
+    corrupt = bytearray(data)
+    corrupt[len(corrupt) // 2] ^= 0x1
+    with open(checkpoint, 'wb') as f:
+      f.write(corrupt)
+    print('+ resuming from a corrupt checkpoint')
+    ret, output = run(resumed)
+    assert ret != 0, 'corrupt checkpoint was accepted'
+    assert 'is corrupt' in output
+
+    # so should a truncated one
+    with open(checkpoint, 'wb') as f:
+      f.write(data[:len(data) // 2])
+    print('+ resuming from a truncated checkpoint')
+    ret, output = run(resumed)
+    assert ret != 0, 'truncated checkpoint was accepted'
+    assert 'unexpected end of file' in output
+
+  return 0
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,25 @@
+-- rumur_flags: ['--external-memory', tempfile.gettempdir(), '--set-capacity', '128']
+-- checker_output: re.compile(r'\bstates="10000".*\bexternal_batches="[3-9]\d\d"') if xml else re.compile(r'^\s*10000 states, .*^\s*\* Successors were merged into the seen states on disk in [3-9]\d\d batches\.$', re.MULTILINE | re.DOTALL)
+
+-- With a batch table of only 42 entries, merged once three quarters full, the
+-- wider of this model's 199 breadth-first layers need several batches each. A
+-- state is often reached from two predecessors whose successors land in
+-- different batches. So merging has to discard states written to disk by an
+-- earlier batch of the same layer as well as by earlier layers.
+
+var
+  x: 0 .. 99;
+  y: 0 .. 99;
+
+startstate begin
+  x := 0;
+  y := 0;
+end;
+
+rule begin
+  x := (x + 1) % 100;
+end;
+
+rule begin
+  y := (y + 1) % 100;
+end;
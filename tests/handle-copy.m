@@ -0,0 +1,58 @@
+-- rumur_flags: ['--deadlock-detection', 'off']
+
+-- Exercise assignment and comparison of complex values at a mix of bit
+-- offsets. Some of these are byte-aligned, and are copied and compared
+-- directly, while the rest go through handle_copy and handle_eq.
+
+type
+  byte_t: 0 .. 200;
+  pair_t: record
+    a: byte_t;
+    b: byte_t;
+  end;
+  odd_t: record
+    a: boolean;
+    b: 0 .. 5;
+  end;
+
+var
+  x: pair_t;
+  y: pair_t;
+  p: odd_t;
+  q: array[0 .. 3] of odd_t;
+  z: pair_t;
+  w: array[0 .. 9] of pair_t;
+  n: 0 .. 9;
+
+startstate begin
+  x.a := 1;
+  x.b := 2;
+  y := x;
+  p.a := true;
+  p.b := 3;
+  for i: 0 .. 3 do
+    q[i] := p;
+  end;
+  z := y;
+  for i: 0 .. 9 do
+    w[i] := z;
+  end;
+  n := 0;
+end;
+
+rule n < 9 ==> begin
+  x.a := n;
+  x.b := 200 - n;
+  y := x;
+  z := y;
+  w[n + 1] := z;
+  p.b := n % 6;
+  q[n % 4] := p;
+  n := n + 1;
+end;
+
+invariant x = y & !(x != y);
+invariant z = x;
+invariant w[n] = z & (n = 0 | w[n] != w[0]);
+invariant q[(n + 3) % 4] = p;
+invariant forall i: 0 .. 9 do i > n | w[i].b = 200 - w[i].a | i = 0 end;
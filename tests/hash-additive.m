@@ -0,0 +1,37 @@
+-- rumur_flags: ['--hash', 'additive']
+-- checker_exit_code: 1
+-- checker_output: None if xml else re.compile(r'^Startstate 1 fired\.\n(pad\[\d+\]:\d+\n){20}x:0\n-+\n\nRule "step" fired\.\npad\[1\]:101\nx:1\n-+\n\nRule "step" fired\.\npad\[2\]:102\nx:2\n-+\n\nRule "step" fired\.\npad\[3\]:103\nx:3\n-+\n\nRule "step" fired\.\npad\[4\]:104\nx:4\n-+\n\nRule "step" fired\.\npad\[5\]:105\nx:5\n-+\n\nEnd of the error trace\.', re.MULTILINE)
+
+-- hashing states with the additive hash function should find the invariant
+-- violation and print its counterexample trace. The state size is not a
+-- multiple of 8 bytes, and the "reset" rule revisits the start state, so states
+-- must be looked up by hash and found again. Each state has only one
+-- predecessor apart from the start state, so the trace is the same with any
+-- number of threads.
+
+var
+  pad: array [0 .. 19] of 0 .. 200;
+  x: 0 .. 10;
+
+procedure reset();
+begin
+  for i: 0 .. 19 do
+    pad[i] := i;
+  end;
+  x := 0;
+end;
+
+startstate begin
+  reset();
+end;
+
+rule "step" x < 10 ==> begin
+  x := x + 1;
+  pad[x] := pad[x] + 100;
+end;
+
+rule "reset" x > 0 ==> begin
+  reset();
+end;
+
+invariant "x below 5" x < 5;
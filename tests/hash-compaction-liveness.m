@@ -0,0 +1,18 @@
+-- rumur_flags: ['--hash-compaction', '64']
+-- rumur_exit_code: 1
+
+-- liveness properties need the full states that hash compaction discards, so
+-- this combination should be rejected
+
+var
+  x: boolean;
+
+startstate begin
+  x := false;
+end;
+
+rule begin
+  x := !x;
+end;
+
+liveness x;
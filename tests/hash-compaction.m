@@ -0,0 +1,24 @@
+-- rumur_flags: ['--hash-compaction', '8']
+-- checker_output: re.compile(r'\bomission_probability="1"') if xml else re.compile(r'^\s*\d{1,3} states, .*^\s*\* Probability of having omitted states due to hash compaction is at most 1\.$', re.MULTILINE | re.DOTALL)
+
+-- With fingerprints of only 8 bits, at most 256 distinct states can be stored,
+-- so most of this model's 10000 states collide with an earlier one and are
+-- wrongly considered seen. The verifier should stop well short of the full
+-- state space and report that states have certainly been omitted.
+
+var
+  x: 0 .. 99;
+  y: 0 .. 99;
+
+startstate begin
+  x := 0;
+  y := 0;
+end;
+
+rule begin
+  x := (x + 1) % 100;
+end;
+
+rule begin
+  y := (y + 1) % 100;
+end;
@@ -0,0 +1,27 @@
+-- rumur_flags: ['--huge-pages', 'on', '--set-capacity', '1048576']
+-- checker_output: re.compile(r'\bstates="250000"') if xml else re.compile(r'\bhuge pages\b.*^\s*250000 states, ', re.MULTILINE | re.DOTALL)
+
+-- backing the seen set and state arenas with huge pages should not affect the
+-- explored state space. Each 260 byte state takes tens of thousands of states
+-- to fill an arena, so this allocates several arenas, and the seen set starts
+-- small and is expanded many times, the last few times to sizes that can be
+-- backed by huge pages.
+
+var
+  x: 0 .. 499;
+  y: 0 .. 499;
+  -- padding, never assigned, to make each state large
+  pad: array [0 .. 255] of 0 .. 200;
+
+startstate begin
+  x := 0;
+  y := 0;
+end;
+
+rule begin
+  x := (x + 1) % 500;
+end;
+
+rule begin
+  y := (y + 1) % 500;
+end;
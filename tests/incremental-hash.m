@@ -0,0 +1,27 @@
+-- rumur_flags: ['--hash', 'additive', '--symmetry-reduction', 'heuristic', '--deadlock-detection', 'off']
+-- checker_output: None if xml else re.compile(r'^\s*70 states, ', re.MULTILINE)
+
+-- a state large enough for successors to be hashed incrementally from their
+-- predecessor, including after symmetry reduction has moved components around
+
+type
+  proc: scalarset(4);
+
+var
+  pad: array [0 .. 63] of 0 .. 200;
+  count: array [proc] of 0 .. 4;
+
+startstate begin
+  for i: 0 .. 63 do
+    pad[i] := i;
+  end;
+  for p: proc do
+    count[p] := 0;
+  end;
+end
+
+ruleset p: proc do
+  rule count[p] < 4 ==> begin
+    count[p] := count[p] + 1;
+  end
+end
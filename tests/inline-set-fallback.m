@@ -0,0 +1,23 @@
+-- rumur_flags: ['--counterexample-trace', 'off']
+-- checker_output: None if xml else re.compile(r'\A(?!.*\bstored inline\b).*^\s*10000 states, ', re.MULTILINE | re.DOTALL)
+
+-- At 40 bytes, this model's state is too wide to fit two to a cache line, so
+-- even with counterexample traces off the seen set should fall back to storing
+-- pointers to states.
+
+var
+  a: array [0 .. 39] of 0 .. 200;
+
+startstate begin
+  for i: 0 .. 39 do
+    a[i] := i;
+  end;
+end;
+
+rule begin
+  a[0] := (a[0] + 1) % 100;
+end;
+
+rule begin
+  a[39] := (a[39] + 1) % 100;
+end;
@@ -0,0 +1,25 @@
+-- rumur_flags: ['--counterexample-trace', 'off', '--set-capacity', '4096']
+-- checker_output: None if xml else re.compile(r'\bStates are stored inline in the hash table\b.*^\s*16384 states, ', re.MULTILINE | re.DOTALL)
+
+-- With counterexample traces off, this model's 2-byte state should be stored
+-- inline in the seen set. Starting from a small set, it has to expand several
+-- times, moving states between cache lines. With 16384 states and fewer than
+-- 256 distinct status byte tags, many states in a line share a tag and must be
+-- told apart by their data.
+
+var
+  a: 0 .. 127;
+  b: 0 .. 127;
+
+startstate begin
+  a := 0;
+  b := 0;
+end;
+
+rule begin
+  a := (a + 1) % 128;
+end;
+
+rule begin
+  b := (b + 1) % 128;
+end;
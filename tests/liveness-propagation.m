@@ -0,0 +1,22 @@
+-- rumur_flags: ['--threads', '4']
+
+-- Starting in the middle, the states above are only known to be able to reach
+-- 0 once their neighbour below has learnt it, one step at a time. The final
+-- liveness check should pass this back through all of them.
+
+var
+  x: 0 .. 2000;
+
+startstate begin
+  x := 1000;
+end
+
+rule x < 2000 ==> begin
+  x := x + 1;
+end
+
+rule x > 0 ==> begin
+  x := x - 1;
+end
+
+liveness "x can be 0" x = 0
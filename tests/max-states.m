@@ -0,0 +1,26 @@
+-- rumur_flags: ['--max-states', '1000']
+-- checker_exit_code: 1
+-- checker_output: None if xml else re.compile(r'^Startstate 1 fired\.\nx:0\ny:0\n-+\n\n(Rule "step [xy]" fired\.\n[xy]:[1-5]\n-+\n\n){5,}', re.MULTILINE)
+
+-- With states referred to by index rather than by pointer, the predecessor
+-- links should still give a complete counterexample trace.
+
+var
+  x: 0 .. 100;
+  y: 0 .. 100;
+
+startstate begin
+  x := 0;
+  y := 0;
+end;
+
+rule "step x" x < 100 ==> begin
+  x := x + 1;
+end;
+
+rule "step y" y < 100 ==> begin
+  y := y + 1;
+end;
+
+invariant "small"
+  x + y < 5;
@@ -0,0 +1,31 @@
+-- rumur_flags: ['--memory-limit', '65536']
+-- checker_exit_code: 1
+-- checker_output: re.compile(r'<summary states="(1[7-9]\d{3}|[2-9]\d{4}|\d{6,})" [^>]*state_caching="true"') if xml else re.compile(r'invariant "not the corner" failed.*^\s*(1[7-9]\d{3}|[2-9]\d{4}|\d{6,}) states, .*^\s*\* State caching was engaged .* counted above, more than once\.$', re.MULTILINE | re.DOTALL)
+
+-- A model with 16384 states, more than fit in the seen set at the given limit,
+-- in which "reset" leads back to states reached long before and so likely to
+-- have been evicted. These are explored again, so more states than exist are
+-- counted, but the violation in the far corner must still be found.
+
+var
+  x: 0 .. 63;
+  y: 0 .. 255;
+
+startstate begin
+  x := 0;
+  y := 0;
+end;
+
+rule "right" x < 63 ==> begin
+  x := x + 1;
+end;
+
+rule "down" y < 255 ==> begin
+  y := y + 1;
+end;
+
+rule "reset" x = 63 ==> begin
+  x := 0;
+end;
+
+invariant "not the corner" !(x = 63 & y = 255);
@@ -0,0 +1,25 @@
+-- rumur_flags: ['--memory-limit', '65536']
+-- checker_exit_code: 1
+-- skip_reason: 'N/A in XML mode' if xml else None
+
+-- A cyclic model whose states are all revisited from states that have
+-- themselves been evicted, so a seen set bounded by the given limit can never
+-- hold enough of it for the search to finish. The verifier should give up
+-- rather than running forever.
+
+var
+  x: 0 .. 255;
+  y: 0 .. 255;
+
+startstate begin
+  x := 0;
+  y := 0;
+end;
+
+rule "step x" begin
+  x := (x + 1) % 256;
+end;
+
+rule "step y" begin
+  y := (y + 1) % 256;
+end;
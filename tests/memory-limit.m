@@ -0,0 +1,34 @@
+-- rumur_flags: ['--memory-limit', '65536', '--deadlock-detection', 'off']
+-- checker_output: re.compile(r'<summary states="32768" rules_fired="65024" errors="0" [^>]*state_caching="true" evictions="\d+" eviction_rounds="[1-9]\d*"') if xml else re.compile(r'^\s*32768 states, 65024 rules fired.*^\s*\* State caching was engaged when the seen set reached the memory limit\. \d+ states were evicted from the seen set in [1-9]\d* rounds', re.MULTILINE | re.DOTALL)
+
+-- A cyclic model with more states than fit in the seen set at the given limit,
+-- to check that the verifier evicts states rather than growing the set, and
+-- still terminates. Each hub state (l = 0) is reached from all its leaves while
+-- it is still pending, and each leaf is reached only from its hub, so choosing
+-- which states to evict by how often they are revisited re-explores nothing
+-- and the count is exact.
+
+var
+  h: 0 .. 255;
+  l: 0 .. 127;
+
+startstate begin
+  h := 0;
+  l := 0;
+end;
+
+ruleset k: 1 .. 127 do
+  rule "leave" l = 0 ==> begin
+    l := k;
+  end;
+end;
+
+rule "return" l != 0 & h < 255 ==> begin
+  h := h + 1;
+  l := 0;
+end;
+
+rule "wrap" l != 0 & h = 255 ==> begin
+  h := 1;
+  l := 0;
+end;
@@ -0,0 +1,15 @@
+-- rumur_flags: ['--numa', 'on', '--threads', '2']
+-- checker_output: re.compile(r'<numa_placement\b[^>]*>\s*<thread id="0"[^>]*/>\s*<thread id="1"[^>]*/>\s*</numa_placement>') if xml else re.compile(r'^\s*\* NUMA placement\b.*:\n\s*- thread 0 \b.*\n\s*- thread 1 \b', re.MULTILINE)
+
+-- the placement of each verifier thread should be reported
+
+var
+  x: boolean;
+
+startstate begin
+  x := false;
+end;
+
+rule begin
+  x := !x;
+end;
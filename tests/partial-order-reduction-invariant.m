@@ -0,0 +1,34 @@
+-- rumur_flags: ['--partial-order-reduction', 'on']
+-- checker_exit_code: 1
+-- checker_output: None if xml else re.compile(r'invariant "bounded" failed' + ('' if multithreaded else r'.*^\s*20 states, '), re.MULTILINE | re.DOTALL)
+
+-- The invariant reads the count of only the first process. Partial-order
+-- reduction can defer the steps of the first process in favour of the others,
+-- but must not defer them past a state that violates the invariant. Deferring
+-- them means the violation is found after 20 states rather than the 10 of an
+-- unreduced search. With several threads, how many states are found before
+-- the search stops varies.
+
+const N: 3;
+
+type pid: 1 .. N;
+
+var count: array [pid] of 0 .. 3;
+
+startstate begin
+  for i: pid do
+    count[i] := 0;
+  end;
+end;
+
+ruleset i: pid do
+  rule "up" count[i] < 3 ==> begin
+    count[i] := count[i] + 1;
+  end;
+
+  rule "down" count[i] > 0 ==> begin
+    count[i] := count[i] - 1;
+  end;
+end;
+
+invariant "bounded" count[1] < 3;
@@ -0,0 +1,33 @@
+-- rumur_flags: ['--partial-order-reduction', 'on']
+-- checker_exit_code: 1
+-- checker_output: re.compile(r'<summary states="14" ') if xml else re.compile(r'\bdeadlock\b.*^\s*14 states, ', re.MULTILINE | re.DOTALL)
+
+-- Each process counts up independently of the others, so partial-order
+-- reduction only needs to explore one interleaving of their steps: 14 states
+-- in a single path, rather than all 512. The state where every process has
+-- finished has no successors, and must still be found as a deadlock.
+
+const N: 4;
+
+type pid: 1 .. N;
+
+var
+  count: array [pid] of 0 .. 3;
+  done: boolean;
+
+startstate begin
+  for i: pid do
+    count[i] := 0;
+  end;
+  done := false;
+end;
+
+ruleset i: pid do
+  rule "step" count[i] < 3 ==> begin
+    count[i] := count[i] + 1;
+  end;
+end;
+
+rule "finish" !done ==> begin
+  done := true;
+end;
@@ -193,10 +193,24 @@ class murphi2uclid(unittest.TestCase):
       'smt-div.m',
 
       # contains '%'
+      'bitstate.m',
+      'external-memory.m',
+      'handle-copy.m',
+      'hash-compaction.m',
+      'huge-pages.m',
+      'inline-set-fallback.m',
+      'inline-set.m',
+      'memory-limit-too-small.m',
       'put-string-injection.m',
+      'set-expansion.m',
+      'slot-tag-collisions.m',
       'smt-bv-mod.m',
       'smt-bv-mod2.m',
       'smt-mod.m',
+      'state-layout-aligned.m',
+      'successor-batch.m',
+      'symmetry-reduction-refinement.m',
+      'tree-compression.m',
 
       # contains alias statements
       'alias-and-field.m',
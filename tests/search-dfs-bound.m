@@ -0,0 +1,24 @@
+-- rumur_flags: ['--search', 'dfs', '--bound', '3']
+-- rumur_exit_code: 1
+
+-- A depth-first search does not reach each state first by its shortest path,
+-- so it cannot honour a bound. Here, the search could reach x = 4 in four
+-- steps, beyond the bound, and then skip it when reaching it again in two
+-- steps, missing the violation at x = 5 that a breadth-first search finds.
+
+var
+  x: 0 .. 20;
+
+startstate begin
+  x := 0;
+end;
+
+rule "one" x < 19 ==> begin
+  x := x + 1;
+end;
+
+rule "two" x < 19 ==> begin
+  x := x + 2;
+end;
+
+invariant "not five" x != 5;
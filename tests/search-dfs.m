@@ -0,0 +1,46 @@
+-- rumur_flags: ['--search', 'dfs', '--deadlock-detection', 'off']
+-- checker_output: None if xml else re.compile(r'^\s*462 states, ' if multithreaded else r'^\s*462 states, 2889 rules fired', re.MULTILINE)
+
+-- Depth-first search should find the same states as breadth-first search, and
+-- when single threaded fire the same number of rules. The rulesets here have
+-- several quantifiers of different types, to check that each rule instance is
+-- decoded to the right parameters.
+
+type
+  colour: enum { red, green };
+
+var
+  x: 0 .. 20;
+  y: -10 .. 10;
+  c: colour;
+
+startstate begin
+  x := 0;
+  y := -10;
+  c := red;
+end;
+
+ruleset i: 1 .. 3 do
+  rule "step x" x + i <= 20 ==> begin
+    x := x + i;
+  end;
+end;
+
+ruleset j: -1 .. 1; d: boolean do
+  rule "step y" d & y + 4 * j <= 10 & y + 4 * j >= -10 ==> begin
+    y := y + 4 * j;
+  end;
+end;
+
+rule "step y by one" y < 10 ==> begin
+  y := y + 1;
+end;
+
+ruleset k: colour do
+  rule "paint" c != k & x = 20 ==> begin
+    c := k;
+  end;
+end;
+
+invariant "in range"
+  x <= 20 & y <= 10;
@@ -0,0 +1,28 @@
+-- rumur_flags: ['--set-capacity', '4096']
+-- checker_output: None if xml else re.compile(r'^\s*9261 states, ', re.MULTILINE)
+
+-- starting from a tiny seen set, it should be expanded several times while
+-- states continue to be inserted, without losing or duplicating any
+
+var
+  x: 0 .. 20;
+  y: 0 .. 20;
+  z: 0 .. 20;
+
+startstate begin
+  x := 0;
+  y := 0;
+  z := 0;
+end;
+
+rule begin
+  x := (x + 1) % 21;
+end;
+
+rule begin
+  y := (y + 1) % 21;
+end;
+
+rule begin
+  z := (z + 1) % 21;
+end;
@@ -0,0 +1,32 @@
+-- rumur_flags: ['--simulate', '100', '--walk-length', '200']
+-- checker_exit_code: 1
+-- checker_output: None if xml else re.compile(r'invariant "below limit" failed.*^\s*\d+ walks, \d+ rules fired', re.MULTILINE | re.DOTALL)
+
+-- A random walk should find the invariant violation, which takes at least ten
+-- steps of a walk to reach, and report it along with the walks taken.
+
+var
+  x: 0 .. 10;
+  flip: boolean;
+
+startstate begin
+  x := 0;
+  flip := false;
+end;
+
+rule "increment" x < 10 ==> begin
+  x := x + 1;
+end;
+
+rule "flip" begin
+  flip := !flip;
+end;
+
+ruleset i: 0 .. 2 do
+  rule "reset" x > 0 & i = 0 & flip ==> begin
+    x := 0;
+  end;
+end;
+
+invariant "below limit"
+  x < 10;
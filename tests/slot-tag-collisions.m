@@ -0,0 +1,30 @@
+-- rumur_flags: ['--pointer-bits', '63']
+-- checker_output: None if xml else re.compile(r'^\s*10000 states, ', re.MULTILINE)
+
+-- Claiming pointers need 63 bits leaves a single bit of each seen set slot for
+-- the hash tag, so about half of all pairs of states have colliding tags. A
+-- matching tag must then be followed by a comparison of the states themselves,
+-- both on insertion and in the lookups done during final liveness checking.
+-- Treating a matching tag as a match would lose states.
+
+var
+  x: 0 .. 99;
+  y: 0 .. 99;
+
+startstate begin
+  x := 0;
+  y := 0;
+end;
+
+rule begin
+  x := (x + 7) % 100;
+end;
+
+rule begin
+  y := (y + 1) % 100;
+  if y = 0 then
+    x := (x + 1) % 100;
+  end;
+end;
+
+liveness "y returns to zero" y = 0;
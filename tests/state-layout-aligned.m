@@ -0,0 +1,68 @@
+-- rumur_flags: ['--state-layout', 'aligned', '--deadlock-detection', 'off']
+-- checker_output: None if xml else re.compile(r'^\s*21 states, ', re.MULTILINE)
+
+-- Exercise the aligned state layout with values of various widths, nested
+-- inside records and arrays, including negative ranges, undefined values and
+-- whole record assignment and comparison. The state count matches that of the
+-- packed layout.
+
+type
+  colour: enum { red, green, blue };
+  pid: scalarset(2);
+  big: 0 .. 70000;
+  entry: record
+    flag: boolean;
+    offset: -5 .. 5;
+    c: colour;
+    wide: big;
+  end;
+
+var
+  entries: array[pid] of entry;
+  last: entry;
+  n: 0 .. 3;
+
+startstate begin
+  for p: pid do
+    entries[p].flag := false;
+    entries[p].offset := -5;
+    entries[p].c := red;
+    entries[p].wide := 0;
+  end;
+  undefine last;
+  n := 0;
+end;
+
+ruleset p: pid do
+
+  rule "bump" n < 3 ==> begin
+    entries[p].flag := !entries[p].flag;
+    if entries[p].offset < 5 then
+      entries[p].offset := entries[p].offset + 5;
+      entries[p].wide := entries[p].wide + 35000;
+    else
+      entries[p].offset := -5;
+      entries[p].wide := 0;
+    end;
+    if entries[p].c = red then
+      entries[p].c := blue;
+    end;
+    n := n + 1;
+  end;
+
+  rule "save" !isundefined(entries[p].wide) ==> begin
+    last := entries[p];
+  end;
+
+end;
+
+invariant "saved copy is consistent"
+  isundefined(last.flag) | last.wide = 0 | last.wide = 35000
+    | last.wide = 70000;
+
+invariant "copies compare equal"
+  forall p: pid do
+    forall q: pid do
+      entries[p] = entries[q] -> entries[p].wide = entries[q].wide
+    end
+  end;
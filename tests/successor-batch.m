@@ -0,0 +1,24 @@
+-- rumur_flags: ['--successor-batch', '4']
+-- checker_output: None if xml else re.compile(r'^\s*1024 states, 16384 rules fired\b', re.MULTILINE)
+
+-- every state has 16 successors, so with a batch size of 4 each state's
+-- successors are inserted over several batches. Most successors are duplicates,
+-- of another successor in the same batch, of one in an earlier batch of the
+-- same state, or of the state itself. All of these should be discarded while
+-- still exploring the full state space.
+
+var
+  x: 0 .. 31;
+  y: 0 .. 31;
+
+startstate begin
+  x := 0;
+  y := 0;
+end;
+
+ruleset i: 0 .. 15 do
+  rule begin
+    x := (x + i % 2) % 32;
+    y := (y + i / 8) % 32;
+  end;
+end;
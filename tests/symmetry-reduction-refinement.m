@@ -0,0 +1,45 @@
+-- rumur_flags: ['--symmetry-reduction', 'refinement', '--deadlock-detection', 'off']
+-- checker_output: None if xml else re.compile(r'^\s*68 states, ', re.MULTILINE)
+
+-- Refinement should find the same canonical representatives as exhaustive
+-- symmetry reduction. The two scalarsets here are linked through arrays indexed
+-- by one and holding the other, which the heuristic canonicaliser cannot
+-- resolve (it finds 86 states).
+
+const
+  N: 3;
+  M: 3;
+
+type
+  pid: scalarset(N);
+  res: scalarset(M);
+
+var
+  holder: array[res] of pid;
+  count: array[pid] of 0 .. 3;
+  link: array[pid] of res;
+
+startstate begin
+  for r: res do
+    undefine holder[r];
+  end;
+  for i: pid do
+    count[i] := 0;
+    undefine link[i];
+  end;
+end;
+
+ruleset i: pid; r: res do
+
+  rule "take" isundefined(holder[r]) & count[i] < 2 ==> begin
+    holder[r] := i;
+    count[i] := count[i] + 1;
+    link[i] := r;
+  end;
+
+  rule "give" !isundefined(holder[r]) & holder[r] = i ==> begin
+    undefine holder[r];
+    count[i] := count[i] - 1;
+  end;
+
+end;
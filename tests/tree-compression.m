@@ -0,0 +1,56 @@
+-- rumur_flags: ['--tree-compression', 'on']
+-- checker_output: None if xml else re.compile(r'^\s*12288 states, ', re.MULTILINE)
+
+-- storing states as trees of shared nodes should still explore the full state
+-- space. The array of records here is split into several leaves.
+
+const N: 3;
+type
+  node: 1 .. N;
+  phase: enum { idle, trying, critical, exiting };
+  entry: record
+    p: phase;
+    ticket: 0 .. 3;
+    seen: boolean;
+    data: array [1 .. 2] of 0 .. 100;
+  end;
+
+var
+  nodes: array [node] of entry;
+  turn: node;
+
+startstate begin
+  for i: node do
+    nodes[i].p := idle;
+    nodes[i].ticket := 0;
+    nodes[i].seen := false;
+    nodes[i].data[1] := 0;
+    nodes[i].data[2] := 0;
+  end;
+  turn := 1;
+end;
+
+ruleset i: node do
+  rule "try" nodes[i].p = idle ==> begin
+    nodes[i].p := trying;
+    nodes[i].ticket := (nodes[i].ticket + 1) % 4;
+  end;
+
+  rule "enter" nodes[i].p = trying & turn = i ==> begin
+    nodes[i].p := critical;
+    nodes[i].seen := !nodes[i].seen;
+  end;
+
+  rule "exit" nodes[i].p = critical ==> begin
+    nodes[i].p := exiting;
+  end;
+
+  rule "done" nodes[i].p = exiting ==> begin
+    nodes[i].p := idle;
+    turn := turn % N + 1;
+  end;
+
+  rule "pass" nodes[i].p != critical & turn = i ==> begin
+    turn := turn % N + 1;
+  end;
+end;